@@ -0,0 +1,115 @@
+package android.hardware;
+
+import android.os.SharedMemory;
+import android.system.ErrnoException;
+
+import java.lang.invoke.MethodHandles;
+import java.lang.invoke.VarHandle;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+/**
+ * Read-only view of the capture ring shared by the IR HAL.
+ * <p>
+ * The HAL writes each capture once into a slot of an ashmem region; this
+ * class maps that region and copies a capture out on demand, so long
+ * captures do not travel through binder. The layout is described in
+ * {@code hal/CaptureRing.h}.
+ * </p>
+ */
+public final class ConsumerIrCaptureRing implements AutoCloseable {
+    private static final int MAGIC = 0x49524352; // 'IRCR'
+    private static final int VERSION = 1;
+    private static final int HEADER_BYTES = 64;
+    private static final int SLOT_HEADER_BYTES = 16;
+    private static final int LATEST_SEQ_OFFSET = 16;
+    private static final int MAX_READ_RETRIES = 4;
+
+    // Acesso com semântica acquire às palavras escritas pela HAL (seqlock)
+    private static final VarHandle INT_VIEW =
+            MethodHandles.byteBufferViewVarHandle(int[].class, ByteOrder.nativeOrder());
+
+    private final SharedMemory mMemory;
+    private final ByteBuffer mBuffer;
+    private final int mSlotCount;
+    private final int mSlotSlices;
+    private final int mSlotBytes;
+
+    ConsumerIrCaptureRing(SharedMemory memory) throws ErrnoException {
+        mMemory = memory;
+        mBuffer = memory.mapReadOnly().order(ByteOrder.nativeOrder());
+
+        if (mBuffer.getInt(0) != MAGIC || mBuffer.getInt(4) != VERSION) {
+            SharedMemory.unmap(mBuffer);
+            throw new IllegalStateException("Unexpected capture ring layout");
+        }
+        mSlotCount = mBuffer.getInt(8);
+        mSlotSlices = mBuffer.getInt(12);
+        mSlotBytes = SLOT_HEADER_BYTES + 4 * mSlotSlices;
+    }
+
+    /**
+     * Maximum number of slices a single capture can hold.
+     */
+    public int getSlotSlices() {
+        return mSlotSlices;
+    }
+
+    /**
+     * Sequence number of the most recent complete capture, or 0 if none.
+     */
+    public long getLatestSequence() {
+        return Integer.toUnsignedLong((int) INT_VIEW.getAcquire(mBuffer, LATEST_SEQ_OFFSET));
+    }
+
+    /**
+     * Copy a capture out of the ring.
+     * <p>
+     * Uses the same layout as {@link ConsumerIrManager#lastReceive()}:
+     * {@code dst[0]} receives the carrier frequency in Hertz and
+     * {@code dst[1..n]} the on/off pattern in microseconds. Passing the
+     * same array on every call avoids any allocation.
+     * </p>
+     *
+     * @param sequence The sequence number returned by
+     *     {@link ConsumerIrManager#captureToRing()}.
+     * @param dst Destination array, at least {@code getSlotSlices() + 1} long.
+     * @return the number of ints written into {@code dst}, or -1 if the
+     *     capture is no longer in the ring.
+     */
+    public int read(long sequence, int[] dst) {
+        if (sequence <= 0 || dst.length < mSlotSlices + 1) {
+            throw new IllegalArgumentException("Invalid sequence or destination too small");
+        }
+        final int seq = (int) sequence;
+        final int base = HEADER_BYTES + Integer.remainderUnsigned(seq, mSlotCount) * mSlotBytes;
+
+        for (int attempt = 0; attempt < MAX_READ_RETRIES; attempt++) {
+            int before = (int) INT_VIEW.getAcquire(mBuffer, base);
+            if ((before & 1) != 0) {
+                continue; // HAL escrevendo neste slot
+            }
+            if (mBuffer.getInt(base + 4) != seq) {
+                return -1; // sobrescrito por uma captura mais nova
+            }
+
+            int count = Math.min(mBuffer.getInt(base + 12), mSlotSlices);
+            dst[0] = mBuffer.getInt(base + 8);
+            for (int i = 0; i < count; i++) {
+                dst[i + 1] = mBuffer.getInt(base + SLOT_HEADER_BYTES + 4 * i);
+            }
+
+            VarHandle.acquireFence();
+            if ((int) INT_VIEW.get(mBuffer, base) == before) {
+                return count + 1;
+            }
+        }
+        return -1;
+    }
+
+    @Override
+    public void close() {
+        SharedMemory.unmap(mBuffer);
+        mMemory.close();
+    }
+}
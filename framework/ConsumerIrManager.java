@@ -16,15 +16,29 @@
 
 package android.hardware;
 
+import android.annotation.IntDef;
 import android.annotation.RequiresFeature;
 import android.annotation.SystemService;
 import android.content.Context;
 import android.content.pm.PackageManager;
+import android.hardware.ir.ConsumerIrMacroStatus;
+import android.hardware.ir.ConsumerIrMacroStep;
+import android.os.ParcelFileDescriptor;
 import android.os.RemoteException;
 import android.os.ServiceManager;
 import android.os.ServiceManager.ServiceNotFoundException;
+import android.os.Process;
+import android.os.SharedMemory;
+import android.os.Trace;
+import android.system.ErrnoException;
 import android.util.Log;
 
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.atomic.AtomicInteger;
+
 /**
  * Class that operates consumer infrared on the device.
  */
@@ -33,9 +47,40 @@ import android.util.Log;
 public final class ConsumerIrManager {
     private static final String TAG = "ConsumerIr";
 
+    private static final AtomicInteger sNextCorrelationId = new AtomicInteger();
+
+    /**
+     * Priority of transmits that can wait: bulk sends, scheduled scenes.
+     * A background pattern on channel 0 is cut at its next frame boundary
+     * when an interactive transmit arrives, and is sent again afterwards.
+     *
+     * @see #transmitWithPriority(int, int, int, int[])
+     */
+    public static final int PRIORITY_BACKGROUND = 0;
+
+    /**
+     * Priority of transmits that answer a user action, such as a key
+     * press. This is the priority of {@link #transmit(int, int[])} and
+     * {@link #transmit(int, int, int[])}.
+     *
+     * @see #transmitWithPriority(int, int, int, int[])
+     */
+    public static final int PRIORITY_INTERACTIVE = 1;
+
+    /** @hide */
+    @IntDef(prefix = { "PRIORITY_" }, value = {
+            PRIORITY_BACKGROUND,
+            PRIORITY_INTERACTIVE,
+    })
+    @Retention(RetentionPolicy.SOURCE)
+    public @interface Priority {}
+
     private final String mPackageName;
     private final IConsumerIrService mService;
 
+    // As faixas de portadora não mudam: evita um binder por consulta
+    private volatile CarrierFrequencyRange[] mCarrierFrequencies;
+
     /**
      * @hide to prevent subclassing from outside of the framework
      */
@@ -70,6 +115,9 @@ public final class ConsumerIrManager {
      * been transmitted. Only patterns shorter than 2 seconds will
      * be transmitted.
      * </p>
+     * <p>
+     * The pattern is sent with {@link #PRIORITY_INTERACTIVE}.
+     * </p>
      *
      * @param carrierFrequency The IR carrier frequency in Hertz.
      * @param pattern The alternating on/off pattern in microseconds to transmit.
@@ -80,12 +128,171 @@ public final class ConsumerIrManager {
             return;
         }
 
+        final long id = newCorrelationId();
+        final boolean traced = beginTrace(id);
+        try {
+            mService.transmit(mPackageName, id, carrierFrequency, pattern);
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        } finally {
+            if (traced) {
+                Trace.endSection();
+            }
+        }
+    }
+
+    /**
+     * Transmit an infrared pattern on a specific emitter channel.
+     * <p>
+     * Devices with several emitters (zones) expose them as channels
+     * {@code 0 .. getChannelCount() - 1}; channel 0 is the emitter used by
+     * {@link #transmit(int, int[])}. On other channels this call returns
+     * as soon as the pattern starts, so patterns sent to different
+     * channels are transmitted concurrently.
+     * </p>
+     * <p>
+     * The pattern is sent with {@link #PRIORITY_INTERACTIVE}.
+     * </p>
+     *
+     * @param channel The emitter channel.
+     * @param carrierFrequency The IR carrier frequency in Hertz.
+     * @param pattern The alternating on/off pattern in microseconds to transmit.
+     */
+    public void transmit(int channel, int carrierFrequency, int[] pattern) {
+        if (mService == null) {
+            Log.w(TAG, "failed to transmit; no consumer ir service.");
+            return;
+        }
+
+        final long id = newCorrelationId();
+        final boolean traced = beginTrace(id);
+        try {
+            mService.transmitOnChannel(mPackageName, id, channel, carrierFrequency, pattern);
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        } finally {
+            if (traced) {
+                Trace.endSection();
+            }
+        }
+    }
+
+    /**
+     * Transmit an infrared pattern with an explicit priority.
+     * <p>
+     * Interactive transmits skip the queue of background ones. On
+     * channel 0, a background pattern that is being sent is cut at its
+     * next frame boundary (a space of at least 5 ms) so the interactive
+     * pattern goes out right away; the cut pattern is then sent again
+     * from the start. A running macro is stopped by an interactive
+     * transmit on channel 0 and reports {@code "preempt"} in
+     * {@link MacroStatus#getLastResult()}.
+     * </p>
+     * <p>
+     * Otherwise this behaves like {@link #transmit(int, int, int[])}.
+     * </p>
+     *
+     * @param priority {@link #PRIORITY_INTERACTIVE} or {@link #PRIORITY_BACKGROUND}.
+     * @param channel The emitter channel.
+     * @param carrierFrequency The IR carrier frequency in Hertz.
+     * @param pattern The alternating on/off pattern in microseconds to transmit.
+     */
+    public void transmitWithPriority(@Priority int priority, int channel, int carrierFrequency,
+            int[] pattern) {
+        if (mService == null) {
+            Log.w(TAG, "failed to transmit; no consumer ir service.");
+            return;
+        }
+
+        final long id = newCorrelationId();
+        final boolean traced = beginTrace(id);
+        try {
+            mService.transmitWithPriority(mPackageName, id, channel, priority, carrierFrequency,
+                    pattern);
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        } finally {
+            if (traced) {
+                Trace.endSection();
+            }
+        }
+    }
+
+    /**
+     * Schedule an infrared pattern to be sent at a given instant.
+     * <p>
+     * The device fires the pattern from a hardware timer, at the given
+     * instant converted to its own clock, so blasters driven from the same
+     * host can fire together. The call returns once the pattern is armed,
+     * without waiting for it to be sent.
+     * </p>
+     *
+     * @param uptimeNanos The instant to send at, in the time base of
+     * {@link android.os.SystemClock#uptimeNanos()}; at most 10 seconds ahead.
+     * @param channel The emitter channel.
+     * @param carrierFrequency The IR carrier frequency in Hertz.
+     * @param pattern The alternating on/off pattern in microseconds to transmit.
+     *
+     * @throws IllegalArgumentException if the instant is in the past or too
+     * far ahead.
+     * @throws android.os.ServiceSpecificException with {@code -ETIME} if the
+     * instant had passed when the pattern reached the device, or with
+     * {@code -EOPNOTSUPP} if the device cannot schedule transmits.
+     */
+    public void transmitAt(long uptimeNanos, int channel, int carrierFrequency, int[] pattern) {
+        if (mService == null) {
+            Log.w(TAG, "failed to transmit; no consumer ir service.");
+            return;
+        }
+
+        final long id = newCorrelationId();
+        final boolean traced = beginTrace(id);
         try {
-            mService.transmit(mPackageName, carrierFrequency, pattern);
+            mService.transmitAt(mPackageName, id, uptimeNanos, channel, carrierFrequency,
+                    pattern);
         } catch (RemoteException e) {
             throw e.rethrowFromSystemServer();
+        } finally {
+            if (traced) {
+                Trace.endSection();
+            }
+        }
+    }
+
+    // Id de ponta a ponta: segue pelo service, HAL, driver e firmware, que o
+    // devolve no [OK]. O pid nos 32 bits altos evita colisão entre processos.
+    private static long newCorrelationId() {
+        return ((long) Process.myPid() << 32)
+                | (sNextCorrelationId.incrementAndGet() & 0xffffffffL);
+    }
+
+    // Só monta o nome da seção com o atrace ligado
+    private static boolean beginTrace(long id) {
+        if (!Trace.isEnabled()) {
+            return false;
         }
+        Trace.beginSection("IrTransmit id=" + Long.toHexString(id));
+        return true;
     }
+
+    /**
+     * Query how many independent emitter channels the device has.
+     *
+     * @return the channel count (at least 1), or 0 if there is no service.
+     */
+    public int getChannelCount() {
+        if (mService == null) {
+            Log.w(TAG, "no consumer ir service.");
+            return 0;
+        }
+
+        try {
+            return mService.getChannelCount();
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
     // ******************************************//
     // ********* Receiver Ading Code ************//
     // ******************************************//
@@ -102,7 +309,364 @@ public final class ConsumerIrManager {
 
     }
     // ******************************************//
-    
+
+    /**
+     * Map the shared capture ring written by the IR HAL.
+     * <p>
+     * The returned ring is read-only and can be kept open for the lifetime
+     * of the caller; use {@link #captureToRing()} to fetch new captures into
+     * it and {@link ConsumerIrCaptureRing#read(long, int[])} to read them
+     * without another copy through the system service.
+     * </p>
+     *
+     * @return the mapped ring, or null if the device does not provide one.
+     */
+    public ConsumerIrCaptureRing openCaptureRing() {
+        if (mService == null) {
+            Log.w(TAG, "no consumer ir service.");
+            return null;
+        }
+
+        try {
+            SharedMemory memory = mService.getCaptureRing();
+            if (memory == null) {
+                return null;
+            }
+            return new ConsumerIrCaptureRing(memory);
+        } catch (ErrnoException e) {
+            Log.w(TAG, "failed to map capture ring.", e);
+            return null;
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
+    /**
+     * Fetch the last received signal into the shared capture ring.
+     *
+     * @return the sequence number of the written capture, or 0 on error.
+     */
+    public long captureToRing() {
+        if (mService == null) {
+            Log.w(TAG, "no consumer ir service.");
+            return 0;
+        }
+
+        try {
+            return mService.captureToRing();
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
+
+    /**
+     * Start a continuous capture session on the infrared receiver.
+     * <p>
+     * Instead of single snapshots, the receiver streams every mark and
+     * space it sees until {@link #stopCaptureSession()} is called. The
+     * returned descriptor yields native-endian 32-bit ints: positive values
+     * are marks and negative values are spaces, both in microseconds. The
+     * stream reaches end-of-file when the session stops. Transmit and
+     * {@link #lastReceive()} fail while a session is active.
+     * </p>
+     *
+     * @return the read end of the session stream, or null on error.
+     */
+    public ParcelFileDescriptor startCaptureSession() {
+        if (mService == null) {
+            Log.w(TAG, "no consumer ir service.");
+            return null;
+        }
+
+        try {
+            return mService.startCaptureSession();
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
+    /**
+     * Stop the continuous capture session started by
+     * {@link #startCaptureSession()}.
+     */
+    public void stopCaptureSession() {
+        if (mService == null) {
+            Log.w(TAG, "no consumer ir service.");
+            return;
+        }
+
+        try {
+            mService.stopCaptureSession();
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
+    /**
+     * Store a macro on the infrared device, replacing any macro with the
+     * same name.
+     * <p>
+     * A macro is a sequence of patterns, NEC frames and delays that the
+     * device plays back on its own clock, so the gaps between steps do not
+     * depend on binder or USB latency. Macros are kept in device memory
+     * and are lost when the device is disconnected.
+     * </p>
+     *
+     * @param name 1 to 15 characters from {@code [A-Za-z0-9_-]}.
+     * @param macro the steps, built with {@link Macro.Builder}.
+     * @throws IllegalArgumentException if the name or a step is invalid.
+     * @throws IllegalStateException if a macro is running.
+     */
+    public void defineMacro(String name, Macro macro) {
+        if (mService == null) {
+            Log.w(TAG, "failed to define macro; no consumer ir service.");
+            return;
+        }
+
+        try {
+            mService.defineMacro(mPackageName, name, macro.mSteps);
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
+    /**
+     * Start a macro stored with {@link #defineMacro(String, Macro)}.
+     * <p>
+     * This method returns as soon as the device starts the macro; use
+     * {@link #getMacroStatus()} to follow it. Background transmits on
+     * channel 0 fail until the macro finishes or is cancelled; an
+     * interactive one stops the macro and is sent right away.
+     * </p>
+     *
+     * @param name the macro name.
+     */
+    public void runMacro(String name) {
+        if (mService == null) {
+            Log.w(TAG, "failed to run macro; no consumer ir service.");
+            return;
+        }
+
+        try {
+            mService.runMacro(mPackageName, name);
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
+    /**
+     * Stop the running macro, if any, before its next step.
+     */
+    public void cancelMacro() {
+        if (mService == null) {
+            Log.w(TAG, "no consumer ir service.");
+            return;
+        }
+
+        try {
+            mService.cancelMacro();
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
+    /**
+     * Remove a macro from the infrared device.
+     *
+     * @param name the macro name.
+     */
+    public void deleteMacro(String name) {
+        if (mService == null) {
+            Log.w(TAG, "no consumer ir service.");
+            return;
+        }
+
+        try {
+            mService.deleteMacro(name);
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
+    /**
+     * Query the progress of the running macro and the outcome of the last
+     * one.
+     *
+     * @return the status, or null if there was an error communicating with
+     * the Consumer IR Service.
+     */
+    public MacroStatus getMacroStatus() {
+        if (mService == null) {
+            Log.w(TAG, "no consumer ir service.");
+            return null;
+        }
+
+        try {
+            ConsumerIrMacroStatus status = mService.getMacroStatus();
+            return status != null ? new MacroStatus(status) : null;
+        } catch (RemoteException e) {
+            throw e.rethrowFromSystemServer();
+        }
+    }
+
+    /**
+     * An immutable sequence of infrared steps to store on the device with
+     * {@link ConsumerIrManager#defineMacro(String, Macro)}.
+     */
+    public static final class Macro {
+        private final ConsumerIrMacroStep[] mSteps;
+
+        private Macro(ConsumerIrMacroStep[] steps) {
+            mSteps = steps;
+        }
+
+        /**
+         * Get the number of steps in this macro.
+         */
+        public int getStepCount() {
+            return mSteps.length;
+        }
+
+        /**
+         * Builds a {@link Macro}. Steps on channel 0 and delays run one
+         * after the other; a pattern on another channel starts together
+         * with the step that follows it.
+         */
+        public static final class Builder {
+            private final List<ConsumerIrMacroStep> mSteps = new ArrayList<>();
+
+            /**
+             * Add a pattern on channel 0.
+             *
+             * @param carrierFrequency The IR carrier frequency in Hertz.
+             * @param pattern The alternating on/off pattern in microseconds.
+             */
+            public Builder transmit(int carrierFrequency, int[] pattern) {
+                return transmit(0, carrierFrequency, pattern);
+            }
+
+            /**
+             * Add a pattern on the given emitter channel.
+             *
+             * @param channel The emitter channel.
+             * @param carrierFrequency The IR carrier frequency in Hertz.
+             * @param pattern The alternating on/off pattern in microseconds.
+             */
+            public Builder transmit(int channel, int carrierFrequency, int[] pattern) {
+                ConsumerIrMacroStep step = new ConsumerIrMacroStep();
+                step.type = ConsumerIrMacroStep.TYPE_PATTERN;
+                step.channel = channel;
+                step.carrierFreqHz = carrierFrequency;
+                step.pattern = pattern.clone();
+                mSteps.add(step);
+                return this;
+            }
+
+            /**
+             * Add a 32-bit NEC frame on channel 0, most significant bit first.
+             *
+             * @param code The NEC code, e.g. {@code 0x20DF10EF}.
+             */
+            public Builder nec(int code) {
+                ConsumerIrMacroStep step = new ConsumerIrMacroStep();
+                step.type = ConsumerIrMacroStep.TYPE_NEC;
+                step.necCode = code;
+                mSteps.add(step);
+                return this;
+            }
+
+            /**
+             * Add a pause before the next step.
+             *
+             * @param delayMicros The pause in microseconds.
+             */
+            public Builder delay(int delayMicros) {
+                ConsumerIrMacroStep step = new ConsumerIrMacroStep();
+                step.type = ConsumerIrMacroStep.TYPE_DELAY;
+                step.delayUs = delayMicros;
+                mSteps.add(step);
+                return this;
+            }
+
+            /**
+             * Create the macro with the steps added so far.
+             */
+            public Macro build() {
+                return new Macro(mSteps.toArray(new ConsumerIrMacroStep[0]));
+            }
+        }
+    }
+
+    /**
+     * Snapshot of the device macro engine, from {@link #getMacroStatus()}.
+     */
+    public static final class MacroStatus {
+        private final ConsumerIrMacroStatus mStatus;
+
+        private MacroStatus(ConsumerIrMacroStatus status) {
+            mStatus = status;
+        }
+
+        /**
+         * Whether a macro is running.
+         */
+        public boolean isRunning() {
+            return mStatus.running;
+        }
+
+        /**
+         * Name of the running macro, or null.
+         */
+        public String getRunningMacro() {
+            return mStatus.name;
+        }
+
+        /**
+         * Steps of the running macro already executed.
+         */
+        public int getStep() {
+            return mStatus.step;
+        }
+
+        /**
+         * Total steps of the running macro.
+         */
+        public int getStepCount() {
+            return mStatus.stepCount;
+        }
+
+        /**
+         * Name of the last macro that finished, or null.
+         */
+        public String getLastMacro() {
+            return mStatus.lastMacro;
+        }
+
+        /**
+         * How the last macro finished: {@code "done"}, {@code "cancel"},
+         * {@code "preempt"} (stopped by an interactive transmit) or
+         * {@code "error"}, or null if none has finished yet.
+         */
+        public String getLastResult() {
+            return mStatus.lastResult;
+        }
+
+        /**
+         * Duration of the last macro in microseconds.
+         */
+        public long getLastDurationMicros() {
+            return mStatus.lastDurationUs;
+        }
+
+        /**
+         * Largest delay of a step of the last macro relative to its
+         * scheduled time, in microseconds.
+         */
+        public int getLastMaxLatenessMicros() {
+            return mStatus.lastMaxLatenessUs;
+        }
+    }
 
     /**
      * Represents a range of carrier frequencies (inclusive) on which the
@@ -152,6 +716,11 @@ public final class ConsumerIrManager {
             return null;
         }
 
+        CarrierFrequencyRange[] cached = mCarrierFrequencies;
+        if (cached != null) {
+            return cached.clone();
+        }
+
         try {
             int[] freqs = mService.getCarrierFrequencies();
             if (freqs.length % 2 != 0) {
@@ -163,6 +732,10 @@ public final class ConsumerIrManager {
             for (int i = 0; i < freqs.length; i += 2) {
                 range[i / 2] = new CarrierFrequencyRange(freqs[i], freqs[i+1]);
             }
+            if (range.length > 0) {
+                mCarrierFrequencies = range;
+                return range.clone();
+            }
             return range;
         } catch (RemoteException e) {
             throw e.rethrowFromSystemServer();
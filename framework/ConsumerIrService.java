@@ -23,19 +23,49 @@ import android.annotation.RequiresNoPermission;
 import android.content.Context;
 import android.content.pm.PackageManager;
 import android.hardware.IConsumerIrService;
+import android.hardware.ir.ConsumerIrCapabilities;
 import android.hardware.ir.ConsumerIrFreqRange;
 import android.hardware.ir.ConsumerIrCapture;
+import android.hardware.ir.ConsumerIrCaptureMemory;
+import android.hardware.ir.ConsumerIrMacroStatus;
+import android.hardware.ir.ConsumerIrMacroStep;
 import android.hardware.ir.IConsumerIr;
+import android.os.ParcelFileDescriptor;
 import android.os.PowerManager;
 import android.os.RemoteException;
 import android.os.ServiceManager;
+import android.os.ServiceSpecificException;
+import android.os.SharedMemory;
+import android.os.SystemClock;
+import android.os.Trace;
+import android.system.OsConstants;
 import android.util.Slog;
 
+import com.android.internal.util.DumpUtils;
+
+import java.io.FileDescriptor;
+import java.io.PrintWriter;
+import java.util.Arrays;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.regex.Pattern;
+
 public class ConsumerIrService extends IConsumerIrService.Stub {
     private static final String TAG = "ConsumerIrService";
 
     private static final int MAX_XMIT_TIME = 2000000; /* in microseconds */
 
+    // Vezes que um transmit de fundo cortado é repetido antes de desistir
+    private static final int MAX_PREEMPT_RETRIES = 2;
+
+    // Antecedência máxima do transmitAt (IR_TX_AT_MAX_LEAD_US do firmware)
+    private static final long MAX_SCHEDULE_AHEAD_NS = 10_000_000_000L;
+
+    // Amostras de latência interativa guardadas para o dump
+    private static final int LATENCY_SAMPLES = 256;
+
+    // Mesmo formato de nome aceito pelo firmware (MACRO_NAME_BYTES - 1)
+    private static final Pattern MACRO_NAME = Pattern.compile("[A-Za-z0-9_-]{1,15}");
+
     private static native boolean getHidlHalService();
     private static native int halTransmit(int carrierFrequency, int[] pattern);
     private static native int[] halGetCarrierFrequencies();
@@ -45,6 +75,21 @@ public class ConsumerIrService extends IConsumerIrService.Stub {
     private final boolean mHasNativeHal;
     private final Object mHalLock = new Object();
     private IConsumerIr mAidlService = null;
+    private SharedMemory mCaptureRing = null;
+
+    // Prioridade do transmit: os interativos têm a própria fila
+    // (mInteractiveLock) e os de fundo esperam mInteractivePending zerar
+    private final Object mInteractiveLock = new Object();
+    private final Object mLaneLock = new Object();
+    private int mInteractivePending = 0;
+    private final LatencyLog mInteractiveLatency = new LatencyLog();
+    private final AtomicLong mPreempted = new AtomicLong();
+    private final AtomicLong mPreemptDropped = new AtomicLong();
+
+    // Capacidades do firmware e faixas de portadora não mudam enquanto o
+    // dispositivo está conectado: lidas uma vez e depois servidas sem mHalLock.
+    private volatile ConsumerIrCapabilities mCapabilities = null;
+    private volatile int[] mCarrierFrequencies = null;
 
     ConsumerIrService(Context context) {
         mContext = context;
@@ -90,11 +135,24 @@ public class ConsumerIrService extends IConsumerIrService.Stub {
     }
 
 
-    @Override
-    @EnforcePermission(TRANSMIT_IR)
-    public void transmit(String packageName, int carrierFrequency, int[] pattern) {
-        super.transmit_enforcePermission();
+    private ConsumerIrCapabilities getCachedCapabilities() {
+        ConsumerIrCapabilities caps = mCapabilities;
+        if (caps != null || mAidlService == null) {
+            return caps;
+        }
+
+        try {
+            // Sem mHalLock: a HAL responde do próprio cache. Uma corrida aqui
+            // só faz duas leituras iguais.
+            caps = mAidlService.getCapabilities();
+            mCapabilities = caps;
+            return caps;
+        } catch (RemoteException | ServiceSpecificException e) {
+            return null;
+        }
+    }
 
+    private void validatePattern(int carrierFrequency, int[] pattern) {
         long totalXmitTime = 0;
 
         for (int slice : pattern) {
@@ -108,26 +166,238 @@ public class ConsumerIrService extends IConsumerIrService.Stub {
             throw new IllegalArgumentException("IR pattern too long");
         }
 
+        // Rejeita antes de pegar mHalLock o que o firmware recusaria
+        ConsumerIrCapabilities caps = getCachedCapabilities();
+        if (caps == null) {
+            return;
+        }
+        if (carrierFrequency < caps.minCarrierHz || carrierFrequency > caps.maxCarrierHz) {
+            throw new IllegalArgumentException("Unsupported IR carrier frequency");
+        }
+        if (pattern.length > caps.maxSlices || totalXmitTime > caps.maxDurationUs) {
+            throw new IllegalArgumentException("IR pattern exceeds device limits");
+        }
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public void transmit(String packageName, long correlationId, int carrierFrequency,
+            int[] pattern) {
+        super.transmit_enforcePermission();
+
+        transmitInternal(correlationId, 0, IConsumerIr.PRIORITY_INTERACTIVE, carrierFrequency,
+                pattern);
+    }
+
+    // Seção do atrace com o id de correlação do ConsumerIrManager
+    private static boolean beginTrace(long correlationId) {
+        if (!Trace.isTagEnabled(Trace.TRACE_TAG_SYSTEM_SERVER)) {
+            return false;
+        }
+        Trace.traceBegin(Trace.TRACE_TAG_SYSTEM_SERVER,
+                "ConsumerIrService.transmit id=" + Long.toHexString(correlationId));
+        return true;
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public void transmitOnChannel(String packageName, long correlationId, int channel,
+            int carrierFrequency, int[] pattern) {
+        super.transmitOnChannel_enforcePermission();
+
+        transmitInternal(correlationId, channel, IConsumerIr.PRIORITY_INTERACTIVE,
+                carrierFrequency, pattern);
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public void transmitWithPriority(String packageName, long correlationId, int channel,
+            int priority, int carrierFrequency, int[] pattern) {
+        super.transmitWithPriority_enforcePermission();
+
+        if (priority != IConsumerIr.PRIORITY_BACKGROUND
+                && priority != IConsumerIr.PRIORITY_INTERACTIVE) {
+            throw new IllegalArgumentException("Unknown IR priority " + priority);
+        }
+        transmitInternal(correlationId, channel, priority, carrierFrequency, pattern);
+    }
+
+    private void transmitInternal(long correlationId, int channel, int priority,
+            int carrierFrequency, int[] pattern) {
+        validatePattern(carrierFrequency, pattern);
+
         throwIfNoIrEmitter();
 
-        // Right now there is no mechanism to ensure fair queing of IR requests
-        synchronized (mHalLock) {
-            if (mAidlService != null) {
-                try {
-                    mAidlService.transmit(carrierFrequency, pattern);
-                } catch (RemoteException ignore) {
-                    Slog.e(TAG, "Error transmitting frequency: " + carrierFrequency);
-                }
+        if (channel != 0 && mAidlService == null) {
+            throw new UnsupportedOperationException("IR channels need the AIDL HAL");
+        }
+
+        final boolean traced = beginTrace(correlationId);
+        try {
+            // Só a HAL AIDL corta um transmit em curso; na HIDL as duas classes
+            // dividem a fila de mHalLock como antes
+            if (priority == IConsumerIr.PRIORITY_INTERACTIVE && mAidlService != null) {
+                transmitInteractive(correlationId, channel, carrierFrequency, pattern);
             } else {
-                int err = halTransmit(carrierFrequency, pattern);
+                transmitBackground(correlationId, channel, priority, carrierFrequency, pattern);
+            }
+        } finally {
+            if (traced) {
+                Trace.traceEnd(Trace.TRACE_TAG_SYSTEM_SERVER);
+            }
+        }
+    }
 
-                if (err < 0) {
-                    Slog.e(TAG, "Error transmitting: " + err);
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public void transmitAt(String packageName, long correlationId, long uptimeNanos, int channel,
+            int carrierFrequency, int[] pattern) {
+        super.transmitAt_enforcePermission();
+
+        validatePattern(carrierFrequency, pattern);
+
+        throwIfNoIrEmitter();
+
+        if (mAidlService == null) {
+            throw new UnsupportedOperationException("Scheduled IR transmit needs the AIDL HAL");
+        }
+        final long leadNs = uptimeNanos - SystemClock.uptimeNanos();
+        if (leadNs <= 0 || leadNs > MAX_SCHEDULE_AHEAD_NS) {
+            throw new IllegalArgumentException("IR transmit instant out of range");
+        }
+
+        // Pela fila interativa: esperar um transmit de fundo perderia o
+        // instante. A HAL volta assim que o firmware arma o padrão.
+        final boolean traced = beginTrace(correlationId);
+        synchronized (mLaneLock) {
+            mInteractivePending++;
+        }
+        try {
+            synchronized (mInteractiveLock) {
+                mAidlService.transmitAt(correlationId, uptimeNanos, channel, carrierFrequency,
+                        pattern);
+            }
+        } catch (RemoteException ignore) {
+            Slog.e(TAG, "Error scheduling transmit on channel " + channel + " id="
+                    + Long.toHexString(correlationId));
+        } finally {
+            synchronized (mLaneLock) {
+                if (--mInteractivePending == 0) {
+                    mLaneLock.notifyAll();
                 }
             }
+            if (traced) {
+                Trace.traceEnd(Trace.TRACE_TAG_SYSTEM_SERVER);
+            }
         }
     }
 
+    // Fura a fila de mHalLock: um transmit de fundo em curso é cortado pelo
+    // firmware na próxima fronteira de quadro e o interativo sai em seguida
+    private void transmitInteractive(long correlationId, int channel, int carrierFrequency,
+            int[] pattern) {
+        final long startNs = SystemClock.elapsedRealtimeNanos();
+        long waitNs = 0;
+
+        synchronized (mLaneLock) {
+            mInteractivePending++;
+        }
+        try {
+            synchronized (mInteractiveLock) {
+                waitNs = SystemClock.elapsedRealtimeNanos() - startNs;
+                halTransmitWithPriority(correlationId, channel,
+                        IConsumerIr.PRIORITY_INTERACTIVE, carrierFrequency, pattern);
+            }
+        } finally {
+            synchronized (mLaneLock) {
+                if (--mInteractivePending == 0) {
+                    mLaneLock.notifyAll();
+                }
+            }
+            mInteractiveLatency.add(waitNs / 1000,
+                    (SystemClock.elapsedRealtimeNanos() - startNs) / 1000);
+        }
+    }
+
+    // Um quadro cortado por um interativo é repetido inteiro depois dele
+    private void transmitBackground(long correlationId, int channel, int priority,
+            int carrierFrequency, int[] pattern) {
+        for (int attempt = 0; ; attempt++) {
+            synchronized (mHalLock) {
+                if (priority == IConsumerIr.PRIORITY_BACKGROUND) {
+                    awaitInteractiveIdle();
+                }
+                if (halTransmitWithPriority(correlationId, channel, priority, carrierFrequency,
+                        pattern)) {
+                    return;
+                }
+            }
+            mPreempted.incrementAndGet();
+            if (attempt >= MAX_PREEMPT_RETRIES) {
+                mPreemptDropped.incrementAndGet();
+                Slog.w(TAG, "Background transmit preempted " + (attempt + 1) + " times, dropped"
+                        + " id=" + Long.toHexString(correlationId));
+                return;
+            }
+        }
+    }
+
+    // Chamar com mHalLock: o de fundo só começa sem interativo na fila
+    private void awaitInteractiveIdle() {
+        boolean interrupted = false;
+        synchronized (mLaneLock) {
+            while (mInteractivePending > 0) {
+                try {
+                    mLaneLock.wait();
+                } catch (InterruptedException e) {
+                    interrupted = true;
+                }
+            }
+        }
+        if (interrupted) {
+            Thread.currentThread().interrupt();
+        }
+    }
+
+    // false se um transmit interativo cortou este (ECANCELED da HAL)
+    private boolean halTransmitWithPriority(long correlationId, int channel, int priority,
+            int carrierFrequency, int[] pattern) {
+        if (mAidlService == null) {
+            int err = halTransmit(carrierFrequency, pattern);
+
+            if (err < 0) {
+                Slog.e(TAG, "Error transmitting: " + err);
+            }
+            return true;
+        }
+
+        try {
+            // Canais != 0 retornam assim que o padrão começa: zonas transmitem em paralelo
+            mAidlService.transmitWithPriority(correlationId, channel, priority,
+                    carrierFrequency, pattern);
+        } catch (RemoteException ignore) {
+            Slog.e(TAG, "Error transmitting on channel " + channel + " frequency: "
+                    + carrierFrequency + " id=" + Long.toHexString(correlationId));
+        } catch (ServiceSpecificException e) {
+            if (e.errorCode != -OsConstants.ECANCELED) {
+                throw e;
+            }
+            return false;
+        }
+        return true;
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public int getChannelCount() {
+        super.getChannelCount_enforcePermission();
+
+        throwIfNoIrEmitter();
+
+        ConsumerIrCapabilities caps = getCachedCapabilities();
+        return caps != null ? caps.channelCount : 1;
+    }
+
     @Override
     @EnforcePermission(TRANSMIT_IR)
     public int[] getCarrierFrequencies() {
@@ -135,25 +405,36 @@ public class ConsumerIrService extends IConsumerIrService.Stub {
 
         throwIfNoIrEmitter();
 
+        int[] cached = mCarrierFrequencies;
+        if (cached != null) {
+            return cached.clone();
+        }
+
         synchronized(mHalLock) {
+            int[] result;
             if (mAidlService != null) {
                 try {
                     ConsumerIrFreqRange[] output = mAidlService.getCarrierFreqs();
                     if (output.length <= 0) {
                         Slog.e(TAG, "Error getting carrier frequencies.");
                     }
-                    int[] result = new int[output.length * 2];
+                    result = new int[output.length * 2];
                     for (int i = 0; i < output.length; i++) {
                         result[i * 2] = output[i].minHz;
                         result[i * 2 + 1] = output[i].maxHz;
                     }
-                    return result;
                 } catch (RemoteException ignore) {
                     return null;
                 }
             } else {
-                return halGetCarrierFrequencies();
+                result = halGetCarrierFrequencies();
+            }
+
+            if (result != null && result.length > 0) {
+                mCarrierFrequencies = result;
+                return result.clone();
             }
+            return result;
         }
     }
 
@@ -198,4 +479,279 @@ public class ConsumerIrService extends IConsumerIrService.Stub {
         }
     }
 
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public SharedMemory getCaptureRing() {
+        super.getCaptureRing_enforcePermission();
+
+        throwIfNoIrEmitter();
+
+        synchronized (mHalLock) {
+            if (mCaptureRing != null) {
+                return mCaptureRing;
+            }
+            if (mAidlService == null) {
+                return null;
+            }
+
+            try {
+                // A HAL entrega a região já selada como somente leitura;
+                // guardamos uma única referência e a repassamos aos apps.
+                ConsumerIrCaptureMemory output = mAidlService.getCaptureMemory();
+                if (output == null || output.memory == null) {
+                    Slog.e(TAG, "Error getting capture ring.");
+                    return null;
+                }
+                mCaptureRing = SharedMemory.fromFileDescriptor(output.memory);
+                return mCaptureRing;
+            } catch (RemoteException e) {
+                Slog.e(TAG, "RemoteException while getting capture ring", e);
+                return null;
+            }
+        }
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public long captureToRing() {
+        super.captureToRing_enforcePermission();
+
+        throwIfNoIrEmitter();
+
+        synchronized (mHalLock) {
+            if (mAidlService == null) {
+                return 0;
+            }
+
+            try {
+                // Só a sequência do slot atravessa o binder; o padrão fica no anel
+                return mAidlService.captureToRing();
+            } catch (RemoteException e) {
+                Slog.e(TAG, "RemoteException while capturing to ring", e);
+                return 0;
+            }
+        }
+    }
+
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public ParcelFileDescriptor startCaptureSession() {
+        super.startCaptureSession_enforcePermission();
+
+        throwIfNoIrEmitter();
+
+        synchronized (mHalLock) {
+            if (mAidlService == null) {
+                return null;
+            }
+
+            try {
+                // O fd do stream é repassado sem cópia: o app lê direto do driver
+                return mAidlService.startCaptureSession();
+            } catch (RemoteException e) {
+                Slog.e(TAG, "RemoteException while starting capture session", e);
+                return null;
+            }
+        }
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public void stopCaptureSession() {
+        super.stopCaptureSession_enforcePermission();
+
+        throwIfNoIrEmitter();
+
+        synchronized (mHalLock) {
+            if (mAidlService == null) {
+                return;
+            }
+
+            try {
+                mAidlService.stopCaptureSession();
+            } catch (RemoteException e) {
+                Slog.e(TAG, "RemoteException while stopping capture session", e);
+            }
+        }
+    }
+
+    private static void validateMacroName(String name) {
+        if (name == null || !MACRO_NAME.matcher(name).matches()) {
+            throw new IllegalArgumentException("Invalid IR macro name");
+        }
+    }
+
+    private IConsumerIr requireAidlForMacros() {
+        if (mAidlService == null) {
+            throw new UnsupportedOperationException("IR macros need the AIDL HAL");
+        }
+        return mAidlService;
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public void defineMacro(String packageName, String name, ConsumerIrMacroStep[] steps) {
+        super.defineMacro_enforcePermission();
+
+        validateMacroName(name);
+        if (steps == null || steps.length == 0) {
+            throw new IllegalArgumentException("Empty IR macro");
+        }
+
+        // Mesmas regras do transmit para cada padrão, antes de pegar mHalLock
+        ConsumerIrCapabilities caps = getCachedCapabilities();
+        if (caps != null && caps.maxMacroSteps > 0 && steps.length > caps.maxMacroSteps) {
+            throw new IllegalArgumentException("IR macro has too many steps");
+        }
+        for (ConsumerIrMacroStep step : steps) {
+            if (step == null) {
+                throw new IllegalArgumentException("Null IR macro step");
+            }
+            switch (step.type) {
+                case ConsumerIrMacroStep.TYPE_PATTERN:
+                    if (step.channel < 0 || (caps != null && step.channel >= caps.channelCount)) {
+                        throw new IllegalArgumentException("Invalid IR channel");
+                    }
+                    if (step.pattern == null || step.pattern.length == 0) {
+                        throw new IllegalArgumentException("Empty IR pattern");
+                    }
+                    validatePattern(step.carrierFreqHz, step.pattern);
+                    break;
+                case ConsumerIrMacroStep.TYPE_NEC:
+                    break;
+                case ConsumerIrMacroStep.TYPE_DELAY:
+                    if (step.delayUs < 0) {
+                        throw new IllegalArgumentException("Negative IR macro delay");
+                    }
+                    break;
+                default:
+                    throw new IllegalArgumentException("Unknown IR macro step");
+            }
+        }
+
+        throwIfNoIrEmitter();
+
+        synchronized (mHalLock) {
+            try {
+                requireAidlForMacros().defineMacro(name, steps);
+            } catch (RemoteException e) {
+                Slog.e(TAG, "RemoteException while defining macro " + name, e);
+            }
+        }
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public void runMacro(String packageName, String name) {
+        super.runMacro_enforcePermission();
+
+        validateMacroName(name);
+        throwIfNoIrEmitter();
+
+        synchronized (mHalLock) {
+            try {
+                // Retorna no [OK] do firmware: os passos rodam no dispositivo
+                requireAidlForMacros().runMacro(name);
+            } catch (RemoteException e) {
+                Slog.e(TAG, "RemoteException while running macro " + name, e);
+            }
+        }
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public void cancelMacro() {
+        super.cancelMacro_enforcePermission();
+
+        throwIfNoIrEmitter();
+
+        synchronized (mHalLock) {
+            try {
+                requireAidlForMacros().cancelMacro();
+            } catch (RemoteException e) {
+                Slog.e(TAG, "RemoteException while cancelling macro", e);
+            }
+        }
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public void deleteMacro(String name) {
+        super.deleteMacro_enforcePermission();
+
+        validateMacroName(name);
+        throwIfNoIrEmitter();
+
+        synchronized (mHalLock) {
+            try {
+                requireAidlForMacros().deleteMacro(name);
+            } catch (RemoteException e) {
+                Slog.e(TAG, "RemoteException while deleting macro " + name, e);
+            }
+        }
+    }
+
+    @Override
+    @EnforcePermission(TRANSMIT_IR)
+    public ConsumerIrMacroStatus getMacroStatus() {
+        super.getMacroStatus_enforcePermission();
+
+        throwIfNoIrEmitter();
+
+        synchronized (mHalLock) {
+            try {
+                return requireAidlForMacros().getMacroStatus();
+            } catch (RemoteException e) {
+                Slog.e(TAG, "RemoteException while reading macro status", e);
+                return null;
+            }
+        }
+    }
+
+    @Override
+    protected void dump(FileDescriptor fd, PrintWriter pw, String[] args) {
+        if (!DumpUtils.checkDumpPermission(mContext, TAG, pw)) {
+            return;
+        }
+
+        pw.println("CONSUMER IR SERVICE (dumpsys consumer_ir)");
+        pw.println("  hal=" + (mAidlService != null ? "aidl" : mHasNativeHal ? "hidl" : "none"));
+        mInteractiveLatency.dump(pw, "  interactive");
+        pw.println("  background preempted=" + mPreempted.get()
+                + " dropped=" + mPreemptDropped.get());
+    }
+
+    // Últimas LATENCY_SAMPLES latências dos transmits interativos: espera na
+    // fila e total (entrada no service até a volta da HAL), em µs
+    private static final class LatencyLog {
+        private final long[] mWaitUs = new long[LATENCY_SAMPLES];
+        private final long[] mTotalUs = new long[LATENCY_SAMPLES];
+        private long mCount = 0;
+        private long mMaxUs = 0;
+
+        synchronized void add(long waitUs, long totalUs) {
+            int slot = (int) (mCount++ % LATENCY_SAMPLES);
+            mWaitUs[slot] = waitUs;
+            mTotalUs[slot] = totalUs;
+            mMaxUs = Math.max(mMaxUs, totalUs);
+        }
+
+        synchronized void dump(PrintWriter pw, String prefix) {
+            int n = (int) Math.min(mCount, LATENCY_SAMPLES);
+            pw.println(prefix + " count=" + mCount + " max_us=" + mMaxUs);
+            if (n == 0) {
+                return;
+            }
+            pw.println(prefix + " wait_us " + percentiles(mWaitUs, n));
+            pw.println(prefix + " total_us " + percentiles(mTotalUs, n));
+        }
+
+        private static String percentiles(long[] samples, int n) {
+            long[] sorted = Arrays.copyOf(samples, n);
+            Arrays.sort(sorted);
+            return "p50=" + sorted[n / 2] + " p90=" + sorted[n * 9 / 10]
+                    + " p99=" + sorted[n * 99 / 100];
+        }
+    }
 }
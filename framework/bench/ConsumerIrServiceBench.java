@@ -0,0 +1,276 @@
+// Benchmark do ConsumerIrService no host (JVM), no estilo do JMH.
+//
+// O service é compilado sem mudanças contra os stubs de stubs/ e fala com
+// a FakeConsumerIr pelo ServiceManager falso, sem binder: o que se mede é
+// o custo do próprio service (validação, mHalLock e filas de prioridade,
+// cópia do lastReceive, achatamento das faixas de portadora) mais a
+// latência configurada da HAL.
+//
+// Para cada operação, tamanho de padrão e número de threads: aquecimento
+// (para o JIT) e depois a medição, com cada chamada cronometrada. Imprime
+// chamadas/s, p50/p90/p99/p99.9/máx em µs e logs do Slog por chamada.
+//
+// Uso: make run ARGS="[--ops transmit,background,lastReceive,getCarrierFrequencies]
+//          [--threads 1,2,4,...,64] [--sizes 4,64,512,4096] [--hal-us 0]
+//          [--warmup-ms 500] [--measure-ms 2000]"
+package com.android.server;
+
+import android.content.Context;
+import android.content.pm.PackageManager;
+import android.hardware.ir.IConsumerIr;
+import android.os.PowerManager;
+import android.os.ServiceManager;
+import android.util.Slog;
+
+import java.util.List;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.atomic.AtomicInteger;
+
+public final class ConsumerIrServiceBench {
+    private static final String PACKAGE = "com.android.bench";
+    private static final int CARRIER_HZ = 38000;
+
+    private static final int PHASE_WARMUP = 0;
+    private static final int PHASE_MEASURE = 1;
+    private static final int PHASE_STOP = 2;
+
+    // Mantém os resultados vivos para o JIT não descartar as chamadas
+    static volatile long sSink;
+
+    private interface Call {
+        void run(long id);
+    }
+
+    private static final class Options {
+        List<String> ops = List.of("transmit", "background", "lastReceive",
+                "getCarrierFrequencies");
+        int[] threads = {1, 2, 4, 8, 16, 32, 64};
+        int[] sizes = {4, 64, 512, 4096};
+        long halUs = 0;
+        long warmupMs = 500;
+        long measureMs = 2000;
+        int freqRanges = 6;
+    }
+
+    private static int[] parseInts(String s) {
+        String[] parts = s.split(",");
+        int[] out = new int[parts.length];
+        for (int i = 0; i < parts.length; i++) {
+            out[i] = Integer.parseInt(parts[i].trim());
+        }
+        return out;
+    }
+
+    private static Options parse(String[] args) {
+        Options o = new Options();
+        for (int i = 0; i < args.length; i++) {
+            String value = i + 1 < args.length ? args[i + 1] : null;
+            switch (args[i]) {
+                case "--ops": o.ops = List.of(value.split(",")); i++; break;
+                case "--threads": o.threads = parseInts(value); i++; break;
+                case "--sizes": o.sizes = parseInts(value); i++; break;
+                case "--hal-us": o.halUs = Long.parseLong(value); i++; break;
+                case "--warmup-ms": o.warmupMs = Long.parseLong(value); i++; break;
+                case "--measure-ms": o.measureMs = Long.parseLong(value); i++; break;
+                case "--freq-ranges": o.freqRanges = Integer.parseInt(value); i++; break;
+                default:
+                    throw new IllegalArgumentException("Opção desconhecida: " + args[i]);
+            }
+        }
+        return o;
+    }
+
+    // Contexto mínimo: o construtor do service só pede o PowerManager e a feature
+    private static final class BenchContext extends Context {
+        @Override
+        public Object getSystemService(String name) {
+            return POWER_SERVICE.equals(name) ? new PowerManager() : null;
+        }
+
+        @Override
+        public PackageManager getPackageManager() {
+            return new PackageManager() {
+                @Override
+                public boolean hasSystemFeature(String feature) {
+                    return FEATURE_CONSUMER_IR.equals(feature);
+                }
+            };
+        }
+    }
+
+    // Histograma log-linear (16 faixas por potência de 2, erro < 6,25%):
+    // tamanho fixo, então gravar não aloca nem disputa entre threads
+    private static final class Histogram {
+        private static final int SUB_BITS = 4;
+        private static final int SUB = 1 << SUB_BITS;
+        private final long[] mCounts = new long[64 * SUB];
+        private long mTotal;
+        private long mMax;
+
+        private static int index(long v) {
+            if (v < SUB) {
+                return (int) v;
+            }
+            int msb = 63 - Long.numberOfLeadingZeros(v);
+            int sub = (int) (v >>> (msb - SUB_BITS)) & (SUB - 1);
+            return (msb - SUB_BITS + 1) * SUB + sub;
+        }
+
+        private static long lowerBound(int index) {
+            if (index < SUB) {
+                return index;
+            }
+            int msb = index / SUB + SUB_BITS - 1;
+            return (long) (SUB + index % SUB) << (msb - SUB_BITS);
+        }
+
+        void record(long ns) {
+            mCounts[index(ns)]++;
+            mTotal++;
+            mMax = Math.max(mMax, ns);
+        }
+
+        void merge(Histogram other) {
+            for (int i = 0; i < mCounts.length; i++) {
+                mCounts[i] += other.mCounts[i];
+            }
+            mTotal += other.mTotal;
+            mMax = Math.max(mMax, other.mMax);
+        }
+
+        long total() {
+            return mTotal;
+        }
+
+        long max() {
+            return mMax;
+        }
+
+        long percentile(double p) {
+            long rank = (long) Math.ceil(mTotal * p / 100.0);
+            long seen = 0;
+            for (int i = 0; i < mCounts.length; i++) {
+                seen += mCounts[i];
+                if (seen >= rank && seen > 0) {
+                    return Math.min(lowerBound(i), mMax);
+                }
+            }
+            return mMax;
+        }
+    }
+
+    private static int[] pattern(int slices) {
+        // 300 µs por fatia: 4096 fatias ainda cabem no MAX_XMIT_TIME de 2 s
+        int[] p = new int[slices];
+        for (int i = 0; i < slices; i++) {
+            p[i] = (i & 1) == 0 ? 280 : 320;
+        }
+        return p;
+    }
+
+    private static Call call(ConsumerIrService service, String op, int slices) {
+        final int[] p = pattern(slices);
+        switch (op) {
+            case "transmit":
+                // Sem prioridade: interativo (fila mInteractiveLock)
+                return id -> service.transmit(PACKAGE, id, CARRIER_HZ, p);
+            case "background":
+                return id -> service.transmitWithPriority(PACKAGE, id, 0,
+                        IConsumerIr.PRIORITY_BACKGROUND, CARRIER_HZ, p);
+            case "lastReceive":
+                return id -> sSink += service.lastReceive().length;
+            case "getCarrierFrequencies":
+                return id -> sSink += service.getCarrierFrequencies().length;
+            default:
+                throw new IllegalArgumentException("Operação desconhecida: " + op);
+        }
+    }
+
+    private static void run(Options o, ConsumerIrService service, FakeConsumerIr hal,
+            String op, int slices, int threads) throws InterruptedException {
+        hal.setCaptureSlices(slices);
+        final Call call = call(service, op, slices);
+        final Histogram[] histograms = new Histogram[threads];
+        final long[] errors = new long[threads];
+        final CountDownLatch ready = new CountDownLatch(threads);
+        final CountDownLatch done = new CountDownLatch(threads);
+        // Só conta a chamada que começou e terminou dentro da medição
+        final AtomicInteger current = new AtomicInteger(PHASE_WARMUP);
+
+        for (int t = 0; t < threads; t++) {
+            final int index = t;
+            histograms[t] = new Histogram();
+            Thread worker = new Thread(() -> {
+                Histogram h = histograms[index];
+                long id = (long) (index + 1) << 32;
+                ready.countDown();
+                for (;;) {
+                    int before = current.get();
+                    if (before == PHASE_STOP) {
+                        break;
+                    }
+                    long t0 = System.nanoTime();
+                    try {
+                        call.run(++id);
+                    } catch (RuntimeException e) {
+                        errors[index]++;
+                    }
+                    long t1 = System.nanoTime();
+                    if (before == PHASE_MEASURE && current.get() == PHASE_MEASURE) {
+                        h.record(t1 - t0);
+                    }
+                }
+                done.countDown();
+            }, "bench-" + t);
+            worker.start();
+        }
+
+        ready.await();
+        Thread.sleep(o.warmupMs);
+        long logs0 = Slog.count();
+        long start = System.nanoTime();
+        current.set(PHASE_MEASURE);
+        Thread.sleep(o.measureMs);
+        current.set(PHASE_STOP);
+        long secsNs = System.nanoTime() - start;
+        long logs = Slog.count() - logs0;
+        done.await();
+
+        Histogram all = new Histogram();
+        long errorCount = 0;
+        for (int t = 0; t < threads; t++) {
+            all.merge(histograms[t]);
+            errorCount += errors[t];
+        }
+        double secs = secsNs / 1e9;
+        long n = Math.max(all.total(), 1);
+        System.out.printf("%-22s %6d %4d %12.0f %9.1f %9.1f %9.1f %9.1f %9.1f %7.2f %s%n",
+                op, slices, threads, all.total() / secs,
+                all.percentile(50) / 1e3, all.percentile(90) / 1e3, all.percentile(99) / 1e3,
+                all.percentile(99.9) / 1e3, all.max() / 1e3, (double) logs / n,
+                errorCount > 0 ? "erros=" + errorCount : "");
+    }
+
+    public static void main(String[] args) throws InterruptedException {
+        Options o = parse(args);
+
+        FakeConsumerIr hal = new FakeConsumerIr(o.halUs * 1000, o.freqRanges);
+        ServiceManager.addService(IConsumerIr.DESCRIPTOR + "/default", hal);
+        ConsumerIrService service = new ConsumerIrService(new BenchContext());
+
+        System.out.printf("HAL falsa: %d us por chamada; aquecimento %d ms, medição %d ms%n",
+                o.halUs, o.warmupMs, o.measureMs);
+        System.out.printf("%-22s %6s %4s %12s %9s %9s %9s %9s %9s %7s%n", "operacao", "fatias",
+                "thr", "chamadas/s", "p50_us", "p90_us", "p99_us", "p99.9_us", "max_us",
+                "logs");
+        for (String op : o.ops) {
+            // As faixas de portadora não dependem do tamanho do padrão
+            int[] sizes = op.equals("getCarrierFrequencies") ? new int[] {0} : o.sizes;
+            for (int slices : sizes) {
+                for (int threads : o.threads) {
+                    run(o, service, hal, op, slices, threads);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,167 @@
+// HAL AIDL falsa, no mesmo processo do ConsumerIrService, para o benchmark
+// no host. Cada transmit gasta halUs (dorme e termina em busy-wait, para a
+// latência valer mesmo abaixo da granularidade do parkNanos); lastReceive()
+// devolve uma captura nova do tamanho pedido, como o parcelable que chega
+// pelo binder.
+package com.android.server;
+
+import android.hardware.ir.ConsumerIrCapabilities;
+import android.hardware.ir.ConsumerIrCapture;
+import android.hardware.ir.ConsumerIrCaptureMemory;
+import android.hardware.ir.ConsumerIrFreqRange;
+import android.hardware.ir.ConsumerIrMacroStatus;
+import android.hardware.ir.ConsumerIrMacroStep;
+import android.hardware.ir.IConsumerIr;
+import android.os.ParcelFileDescriptor;
+
+import java.util.concurrent.locks.LockSupport;
+
+final class FakeConsumerIr extends IConsumerIr.Stub {
+    // Abaixo disso o parkNanos erra mais do que a própria espera
+    private static final long PARK_MIN_NS = 100_000;
+    private static final long PARK_SLACK_NS = 60_000;
+
+    private final long mHalNs;
+    private final int mFreqRanges;
+    private volatile int mCaptureSlices = 64;
+
+    FakeConsumerIr(long halNs, int freqRanges) {
+        mHalNs = halNs;
+        mFreqRanges = freqRanges;
+    }
+
+    void setCaptureSlices(int slices) {
+        mCaptureSlices = slices;
+    }
+
+    private static void spend(long ns) {
+        if (ns <= 0) {
+            return;
+        }
+        final long end = System.nanoTime() + ns;
+        if (ns >= PARK_MIN_NS) {
+            LockSupport.parkNanos(ns - PARK_SLACK_NS);
+        }
+        while (System.nanoTime() < end) {
+            Thread.onSpinWait();
+        }
+    }
+
+    @Override
+    public ConsumerIrFreqRange[] getCarrierFreqs() {
+        spend(mHalNs);
+        ConsumerIrFreqRange[] ranges = new ConsumerIrFreqRange[mFreqRanges];
+        for (int i = 0; i < ranges.length; i++) {
+            ranges[i] = new ConsumerIrFreqRange();
+            ranges[i].minHz = 30000 + i * 2000;
+            ranges[i].maxHz = ranges[i].minHz + 1000;
+        }
+        return ranges;
+    }
+
+    // Os limites do firmware, com espaço para o maior padrão do benchmark
+    @Override
+    public ConsumerIrCapabilities getCapabilities() {
+        ConsumerIrCapabilities caps = new ConsumerIrCapabilities();
+        caps.minCarrierHz = 1000;
+        caps.maxCarrierHz = 500000;
+        caps.maxSlices = 4096;
+        caps.maxDurationUs = 2000000;
+        caps.channelCount = 4;
+        caps.protocols = new String[] {"NEC", "TX", "TXC", "RAW", "RAW@", "ABORT", "TX_AT", "UPLOAD"};
+        caps.lineBytes = 65536;
+        caps.captureBytes = 65536;
+        caps.maxMacros = 8;
+        caps.maxMacroSteps = 32;
+        return caps;
+    }
+
+    @Override
+    public void transmit(int carrierFreqHz, int[] pattern) {
+        spend(mHalNs);
+    }
+
+    @Override
+    public int getChannelCount() {
+        return 4;
+    }
+
+    @Override
+    public void transmitOnChannel(int channel, int carrierFreqHz, int[] pattern) {
+        spend(mHalNs);
+    }
+
+    @Override
+    public void transmitWithId(long correlationId, int channel, int carrierFreqHz,
+            int[] pattern) {
+        spend(mHalNs);
+    }
+
+    @Override
+    public void transmitWithPriority(long correlationId, int channel, int priority,
+            int carrierFreqHz, int[] pattern) {
+        spend(mHalNs);
+    }
+
+    @Override
+    public void transmitAt(long correlationId, long uptimeNanos, int channel, int carrierFreqHz,
+            int[] pattern) {
+        spend(mHalNs);
+    }
+
+    @Override
+    public ConsumerIrCapture lastReceive() {
+        spend(mHalNs);
+        // Nova a cada chamada: no aparelho o parcelable vem desserializado
+        ConsumerIrCapture capture = new ConsumerIrCapture();
+        capture.frequencyHz = 38000;
+        capture.patternMicros = new int[mCaptureSlices];
+        for (int i = 0; i < capture.patternMicros.length; i++) {
+            capture.patternMicros[i] = (i & 1) == 0 ? 560 : 1690;
+        }
+        return capture;
+    }
+
+    @Override
+    public ConsumerIrCaptureMemory getCaptureMemory() {
+        return new ConsumerIrCaptureMemory();
+    }
+
+    @Override
+    public long captureToRing() {
+        spend(mHalNs);
+        return 1;
+    }
+
+    @Override
+    public ParcelFileDescriptor startCaptureSession() {
+        return new ParcelFileDescriptor();
+    }
+
+    @Override
+    public void stopCaptureSession() {
+    }
+
+    @Override
+    public void defineMacro(String name, ConsumerIrMacroStep[] steps) {
+        spend(mHalNs);
+    }
+
+    @Override
+    public void runMacro(String name) {
+        spend(mHalNs);
+    }
+
+    @Override
+    public void cancelMacro() {
+    }
+
+    @Override
+    public void deleteMacro(String name) {
+    }
+
+    @Override
+    public ConsumerIrMacroStatus getMacroStatus() {
+        return new ConsumerIrMacroStatus();
+    }
+}
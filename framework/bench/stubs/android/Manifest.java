@@ -0,0 +1,8 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android;
+
+public final class Manifest {
+    public static final class permission {
+        public static final String TRANSMIT_IR = "android.permission.TRANSMIT_IR";
+    }
+}
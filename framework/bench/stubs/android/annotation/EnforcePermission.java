@@ -0,0 +1,6 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.annotation;
+
+public @interface EnforcePermission {
+    String value() default "";
+}
@@ -0,0 +1,12 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.content;
+
+import android.content.pm.PackageManager;
+
+public abstract class Context {
+    public static final String POWER_SERVICE = "power";
+
+    public abstract Object getSystemService(String name);
+
+    public abstract PackageManager getPackageManager();
+}
@@ -0,0 +1,8 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.content.pm;
+
+public abstract class PackageManager {
+    public static final String FEATURE_CONSUMER_IR = "android.hardware.consumerir";
+
+    public abstract boolean hasSystemFeature(String name);
+}
@@ -0,0 +1,115 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.hardware;
+
+import android.hardware.ir.ConsumerIrMacroStatus;
+import android.hardware.ir.ConsumerIrMacroStep;
+import android.os.Binder;
+import android.os.IBinder;
+import android.os.ParcelFileDescriptor;
+import android.os.RemoteException;
+import android.os.SharedMemory;
+
+// Espelha framework/IConsumerIrService.aidl como o gerador do AIDL faria.
+// O benchmark roda com a permissão concedida: os *_enforcePermission() não
+// checam nada.
+public interface IConsumerIrService extends android.os.IInterface {
+    boolean hasIrEmitter() throws RemoteException;
+
+    void transmit(String packageName, long correlationId, int carrierFrequency, int[] pattern)
+            throws RemoteException;
+
+    void transmitOnChannel(String packageName, long correlationId, int channel,
+            int carrierFrequency, int[] pattern) throws RemoteException;
+
+    void transmitWithPriority(String packageName, long correlationId, int channel, int priority,
+            int carrierFrequency, int[] pattern) throws RemoteException;
+
+    void transmitAt(String packageName, long correlationId, long uptimeNanos, int channel,
+            int carrierFrequency, int[] pattern) throws RemoteException;
+
+    int getChannelCount() throws RemoteException;
+
+    int[] lastReceive() throws RemoteException;
+
+    int[] getCarrierFrequencies() throws RemoteException;
+
+    SharedMemory getCaptureRing() throws RemoteException;
+
+    long captureToRing() throws RemoteException;
+
+    ParcelFileDescriptor startCaptureSession() throws RemoteException;
+
+    void stopCaptureSession() throws RemoteException;
+
+    void defineMacro(String packageName, String name, ConsumerIrMacroStep[] steps)
+            throws RemoteException;
+
+    void runMacro(String packageName, String name) throws RemoteException;
+
+    void cancelMacro() throws RemoteException;
+
+    void deleteMacro(String name) throws RemoteException;
+
+    ConsumerIrMacroStatus getMacroStatus() throws RemoteException;
+
+    abstract class Stub extends Binder implements IConsumerIrService {
+        private static final String DESCRIPTOR = "android.hardware.IConsumerIrService";
+
+        public Stub() {
+            attachInterface(this, DESCRIPTOR);
+        }
+
+        @Override
+        public IBinder asBinder() {
+            return this;
+        }
+
+        protected void transmit_enforcePermission() {
+        }
+
+        protected void transmitOnChannel_enforcePermission() {
+        }
+
+        protected void transmitWithPriority_enforcePermission() {
+        }
+
+        protected void transmitAt_enforcePermission() {
+        }
+
+        protected void getChannelCount_enforcePermission() {
+        }
+
+        protected void lastReceive_enforcePermission() {
+        }
+
+        protected void getCarrierFrequencies_enforcePermission() {
+        }
+
+        protected void getCaptureRing_enforcePermission() {
+        }
+
+        protected void captureToRing_enforcePermission() {
+        }
+
+        protected void startCaptureSession_enforcePermission() {
+        }
+
+        protected void stopCaptureSession_enforcePermission() {
+        }
+
+        protected void defineMacro_enforcePermission() {
+        }
+
+        protected void runMacro_enforcePermission() {
+        }
+
+        protected void cancelMacro_enforcePermission() {
+        }
+
+        protected void deleteMacro_enforcePermission() {
+        }
+
+        protected void getMacroStatus_enforcePermission() {
+        }
+    }
+}
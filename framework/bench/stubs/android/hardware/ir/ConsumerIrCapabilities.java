@@ -0,0 +1,15 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.hardware.ir;
+
+public class ConsumerIrCapabilities {
+    public int minCarrierHz;
+    public int maxCarrierHz;
+    public int maxSlices;
+    public int maxDurationUs;
+    public int channelCount;
+    public String[] protocols;
+    public int lineBytes;
+    public int captureBytes;
+    public int maxMacros;
+    public int maxMacroSteps;
+}
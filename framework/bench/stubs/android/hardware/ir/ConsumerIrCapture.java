@@ -0,0 +1,7 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.hardware.ir;
+
+public class ConsumerIrCapture {
+    public int frequencyHz;
+    public int[] patternMicros;
+}
@@ -0,0 +1,10 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.hardware.ir;
+
+import android.os.ParcelFileDescriptor;
+
+public class ConsumerIrCaptureMemory {
+    public ParcelFileDescriptor memory;
+    public int slotCount;
+    public int slotSlices;
+}
@@ -0,0 +1,13 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.hardware.ir;
+
+public class ConsumerIrMacroStatus {
+    public boolean running;
+    public String name;
+    public int step;
+    public int stepCount;
+    public String lastMacro;
+    public String lastResult;
+    public long lastDurationUs;
+    public int lastMaxLatenessUs;
+}
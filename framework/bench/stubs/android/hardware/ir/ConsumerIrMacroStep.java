@@ -0,0 +1,15 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.hardware.ir;
+
+public class ConsumerIrMacroStep {
+    public static final int TYPE_PATTERN = 0;
+    public static final int TYPE_NEC = 1;
+    public static final int TYPE_DELAY = 2;
+
+    public int type;
+    public int channel;
+    public int carrierFreqHz;
+    public int[] pattern;
+    public int necCode;
+    public int delayUs;
+}
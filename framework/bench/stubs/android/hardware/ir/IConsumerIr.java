@@ -0,0 +1,75 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.hardware.ir;
+
+import android.os.Binder;
+import android.os.IBinder;
+import android.os.IInterface;
+import android.os.ParcelFileDescriptor;
+import android.os.RemoteException;
+
+// Espelha framework/IConsumerIr.aidl como o gerador do AIDL faria
+public interface IConsumerIr extends IInterface {
+    String DESCRIPTOR = "android.hardware.ir.IConsumerIr";
+
+    int PRIORITY_BACKGROUND = 0;
+    int PRIORITY_INTERACTIVE = 1;
+
+    ConsumerIrFreqRange[] getCarrierFreqs() throws RemoteException;
+
+    ConsumerIrCapabilities getCapabilities() throws RemoteException;
+
+    void transmit(int carrierFreqHz, int[] pattern) throws RemoteException;
+
+    int getChannelCount() throws RemoteException;
+
+    void transmitOnChannel(int channel, int carrierFreqHz, int[] pattern)
+            throws RemoteException;
+
+    void transmitWithId(long correlationId, int channel, int carrierFreqHz, int[] pattern)
+            throws RemoteException;
+
+    void transmitWithPriority(long correlationId, int channel, int priority, int carrierFreqHz,
+            int[] pattern) throws RemoteException;
+
+    void transmitAt(long correlationId, long uptimeNanos, int channel, int carrierFreqHz,
+            int[] pattern) throws RemoteException;
+
+    ConsumerIrCapture lastReceive() throws RemoteException;
+
+    ConsumerIrCaptureMemory getCaptureMemory() throws RemoteException;
+
+    long captureToRing() throws RemoteException;
+
+    ParcelFileDescriptor startCaptureSession() throws RemoteException;
+
+    void stopCaptureSession() throws RemoteException;
+
+    void defineMacro(String name, ConsumerIrMacroStep[] steps) throws RemoteException;
+
+    void runMacro(String name) throws RemoteException;
+
+    void cancelMacro() throws RemoteException;
+
+    void deleteMacro(String name) throws RemoteException;
+
+    ConsumerIrMacroStatus getMacroStatus() throws RemoteException;
+
+    abstract class Stub extends Binder implements IConsumerIr {
+        public Stub() {
+            attachInterface(this, DESCRIPTOR);
+        }
+
+        public static IConsumerIr asInterface(IBinder obj) {
+            if (obj == null) {
+                return null;
+            }
+            IInterface iin = obj.queryLocalInterface(DESCRIPTOR);
+            return (iin instanceof IConsumerIr) ? (IConsumerIr) iin : null;
+        }
+
+        @Override
+        public IBinder asBinder() {
+            return this;
+        }
+    }
+}
@@ -0,0 +1,24 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.os;
+
+import java.io.FileDescriptor;
+import java.io.PrintWriter;
+
+// Sem transação: as chamadas são diretas, como num binder local
+public class Binder implements IBinder {
+    private IInterface mOwner;
+    private String mDescriptor;
+
+    public void attachInterface(IInterface owner, String descriptor) {
+        mOwner = owner;
+        mDescriptor = descriptor;
+    }
+
+    @Override
+    public IInterface queryLocalInterface(String descriptor) {
+        return descriptor.equals(mDescriptor) ? mOwner : null;
+    }
+
+    protected void dump(FileDescriptor fd, PrintWriter fout, String[] args) {
+    }
+}
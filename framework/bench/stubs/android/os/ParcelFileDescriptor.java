@@ -0,0 +1,5 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.os;
+
+public class ParcelFileDescriptor {
+}
@@ -0,0 +1,21 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.os;
+
+public final class PowerManager {
+    public static final int PARTIAL_WAKE_LOCK = 0x00000001;
+
+    public WakeLock newWakeLock(int levelAndFlags, String tag) {
+        return new WakeLock();
+    }
+
+    public static final class WakeLock {
+        public void setReferenceCounted(boolean value) {
+        }
+
+        public void acquire() {
+        }
+
+        public void release() {
+        }
+    }
+}
@@ -0,0 +1,11 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.os;
+
+public class RemoteException extends Exception {
+    public RemoteException() {
+    }
+
+    public RemoteException(String message) {
+        super(message);
+    }
+}
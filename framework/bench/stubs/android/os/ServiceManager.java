@@ -0,0 +1,16 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.os;
+
+import java.util.concurrent.ConcurrentHashMap;
+
+public final class ServiceManager {
+    private static final ConcurrentHashMap<String, IBinder> sServices = new ConcurrentHashMap<>();
+
+    public static void addService(String name, IBinder service) {
+        sServices.put(name, service);
+    }
+
+    public static IBinder waitForDeclaredService(String name) {
+        return sServices.get(name);
+    }
+}
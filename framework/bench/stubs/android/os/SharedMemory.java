@@ -0,0 +1,8 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.os;
+
+public final class SharedMemory {
+    public static SharedMemory fromFileDescriptor(ParcelFileDescriptor fd) {
+        return new SharedMemory();
+    }
+}
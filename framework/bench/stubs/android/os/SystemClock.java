@@ -0,0 +1,13 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.os;
+
+// CLOCK_MONOTONIC nos dois: no host não há suspensão a descontar
+public final class SystemClock {
+    public static long elapsedRealtimeNanos() {
+        return System.nanoTime();
+    }
+
+    public static long uptimeNanos() {
+        return System.nanoTime();
+    }
+}
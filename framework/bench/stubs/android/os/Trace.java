@@ -0,0 +1,19 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.os;
+
+// -Dbench.trace=true mede o custo de montar os nomes das seções
+public final class Trace {
+    public static final long TRACE_TAG_SYSTEM_SERVER = 1L << 19;
+
+    private static final boolean ENABLED = Boolean.getBoolean("bench.trace");
+
+    public static boolean isTagEnabled(long traceTag) {
+        return ENABLED;
+    }
+
+    public static void traceBegin(long traceTag, String methodName) {
+    }
+
+    public static void traceEnd(long traceTag) {
+    }
+}
@@ -0,0 +1,8 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.system;
+
+public final class OsConstants {
+    public static final int ECANCELED = 125;
+    public static final int ETIME = 62;
+    public static final int ETIMEDOUT = 110;
+}
@@ -0,0 +1,38 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package android.util;
+
+import java.util.concurrent.atomic.LongAdder;
+
+// Descarta as mensagens e só conta: o benchmark reporta logs por chamada
+public final class Slog {
+    private static final LongAdder sCount = new LongAdder();
+
+    public static long count() {
+        return sCount.sum();
+    }
+
+    public static int e(String tag, String msg) {
+        sCount.increment();
+        return 0;
+    }
+
+    public static int e(String tag, String msg, Throwable tr) {
+        sCount.increment();
+        return 0;
+    }
+
+    public static int w(String tag, String msg) {
+        sCount.increment();
+        return 0;
+    }
+
+    public static int i(String tag, String msg) {
+        sCount.increment();
+        return 0;
+    }
+
+    public static int d(String tag, String msg) {
+        sCount.increment();
+        return 0;
+    }
+}
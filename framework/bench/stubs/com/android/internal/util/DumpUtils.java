@@ -0,0 +1,12 @@
+// Stub do host para o benchmark (framework/bench): só o que o ConsumerIrService usa.
+package com.android.internal.util;
+
+import android.content.Context;
+
+import java.io.PrintWriter;
+
+public final class DumpUtils {
+    public static boolean checkDumpPermission(Context context, String tag, PrintWriter pw) {
+        return true;
+    }
+}
@@ -0,0 +1,124 @@
+#define LOG_TAG "ConsumerIrHal"
+
+#include "CaptureRing.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cutils/ashmem.h>
+#include <log/log.h>
+
+namespace aidl::android::hardware::ir {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "atomic precisa caber em 32 bits");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "seqlock exige atomic lock-free");
+
+CaptureRing::~CaptureRing() {
+    if (mBase != nullptr) munmap(mBase, mSize);
+    if (mFd >= 0) close(mFd);
+}
+
+bool CaptureRing::init(uint32_t slotCount, uint32_t slotSlices) {
+    static_assert(sizeof(Header) <= kHeaderBytes);
+    static_assert(sizeof(SlotHeader) == kSlotHeaderBytes);
+
+    mSlotCount = slotCount;
+    mSlotSlices = slotSlices;
+    mSize = kHeaderBytes + (size_t)slotCount * (kSlotHeaderBytes + 4 * (size_t)slotSlices);
+
+    mFd = ashmem_create_region("consumerir-capture-ring", mSize);
+    if (mFd < 0) {
+        ALOGE("ashmem_create_region falhou (%zu bytes)", mSize);
+        return false;
+    }
+
+    void* base = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("mmap do anel de capturas falhou");
+        close(mFd);
+        mFd = -1;
+        return false;
+    }
+    mBase = static_cast<uint8_t*>(base);
+    memset(mBase, 0, mSize);
+
+    Header* h = reinterpret_cast<Header*>(mBase);
+    h->magic = kMagic;
+    h->version = kVersion;
+    h->slotCount = slotCount;
+    h->slotSlices = slotSlices;
+    h->latestSeq.store(0, std::memory_order_release);
+
+    // Nosso mapeamento continua RW; qualquer mmap futuro (service/apps) só lê.
+    if (ashmem_set_prot_region(mFd, PROT_READ) < 0) {
+        ALOGE("ashmem_set_prot_region(PROT_READ) falhou");
+        return false;
+    }
+    return true;
+}
+
+CaptureRing::SlotHeader* CaptureRing::slot(uint32_t index) const {
+    size_t off = kHeaderBytes + (size_t)index * (kSlotHeaderBytes + 4 * (size_t)mSlotSlices);
+    return reinterpret_cast<SlotHeader*>(mBase + off);
+}
+
+int32_t* CaptureRing::slotPattern(SlotHeader* s) const {
+    return reinterpret_cast<int32_t*>(reinterpret_cast<uint8_t*>(s) + kSlotHeaderBytes);
+}
+
+int32_t* CaptureRing::beginWrite() {
+    if (mBase == nullptr || mWriting != nullptr) return nullptr;
+
+    mWriting = slot(mNextSeq % mSlotCount);
+    // lock ímpar: leitores que pegarem o slot agora descartam a cópia
+    mWriting->lock.fetch_add(1, std::memory_order_acq_rel);
+    return slotPattern(mWriting);
+}
+
+uint32_t CaptureRing::commit(int32_t frequencyHz, uint32_t count) {
+    if (mWriting == nullptr) return 0;
+
+    uint32_t seq = mNextSeq++;
+    if (mNextSeq == 0) mNextSeq = 1;  // 0 é reservado para "nenhuma captura"
+
+    mWriting->seq = seq;
+    mWriting->frequencyHz = frequencyHz;
+    mWriting->count = count < mSlotSlices ? count : mSlotSlices;
+    mWriting->lock.fetch_add(1, std::memory_order_release);
+    mWriting = nullptr;
+
+    reinterpret_cast<Header*>(mBase)->latestSeq.store(seq, std::memory_order_release);
+    return seq;
+}
+
+void CaptureRing::abort() {
+    if (mWriting == nullptr) return;
+    // Slot fica com o conteúdo parcial, mas com seq inválida para qualquer leitor
+    mWriting->seq = 0;
+    mWriting->lock.fetch_add(1, std::memory_order_release);
+    mWriting = nullptr;
+}
+
+uint32_t CaptureRing::latestSeq() const {
+    if (mBase == nullptr) return 0;
+    return reinterpret_cast<const Header*>(mBase)->latestSeq.load(std::memory_order_acquire);
+}
+
+bool CaptureRing::read(uint32_t seq, int32_t* frequencyHz, int32_t* pattern, uint32_t* count) const {
+    if (mBase == nullptr || seq == 0) return false;
+
+    SlotHeader* s = slot(seq % mSlotCount);
+    uint32_t before = s->lock.load(std::memory_order_acquire);
+    if ((before & 1) || s->seq != seq) return false;
+
+    uint32_t n = s->count;
+    *frequencyHz = s->frequencyHz;
+    memcpy(pattern, slotPattern(s), (size_t)n * sizeof(int32_t));
+    *count = n;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return s->lock.load(std::memory_order_relaxed) == before;
+}
+
+}  // namespace aidl::android::hardware::ir
@@ -0,0 +1,94 @@
+/*
+ * Anel de capturas IR em memória compartilhada (ashmem).
+ *
+ * A HAL escreve cada captura uma única vez, direto no slot do anel, e
+ * entrega o fd da região (somente leitura) para o ConsumerIrService, que
+ * o repassa aos apps como SharedMemory. Nenhum dado de padrão atravessa
+ * o binder nesse caminho.
+ *
+ * Layout (palavras de 32 bits, ordem nativa). Espelhado em
+ * framework/ConsumerIrCaptureRing.java — mantenha os dois em sincronia.
+ *
+ *   cabeçalho (64 bytes):
+ *     [0] magic       'IRCR'
+ *     [1] version     1
+ *     [2] slotCount
+ *     [3] slotSlices  capacidade de cada slot, em fatias
+ *     [4] latestSeq   sequência da última captura completa (0 = nenhuma)
+ *
+ *   slot i, em 64 + i * (16 + 4 * slotSlices):
+ *     [0] lock        contador seqlock (ímpar = escrita em andamento)
+ *     [1] seq         sequência da captura guardada no slot
+ *     [2] frequencyHz
+ *     [3] count       número de fatias válidas
+ *     [4..] pattern   fatias em µs (on/off alternados)
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace aidl::android::hardware::ir {
+
+class CaptureRing {
+  public:
+    static constexpr uint32_t kMagic = 0x49524352;  // 'IRCR'
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kHeaderBytes = 64;
+    static constexpr size_t kSlotHeaderBytes = 16;
+
+    CaptureRing() = default;
+    ~CaptureRing();
+
+    CaptureRing(const CaptureRing&) = delete;
+    CaptureRing& operator=(const CaptureRing&) = delete;
+
+    // Cria a região ashmem e a sela como somente leitura para novos mapeamentos.
+    bool init(uint32_t slotCount, uint32_t slotSlices);
+
+    int fd() const { return mFd; }
+    uint32_t slotCount() const { return mSlotCount; }
+    uint32_t slotSlices() const { return mSlotSlices; }
+
+    // Reserva o próximo slot e devolve o buffer de padrão onde o chamador
+    // escreve as fatias. Deve ser seguido de commit() ou abort().
+    int32_t* beginWrite();
+    uint32_t commit(int32_t frequencyHz, uint32_t count);
+    void abort();
+
+    // Copia a captura `seq` (se ainda estiver no anel). Usado pelo lastReceive().
+    bool read(uint32_t seq, int32_t* frequencyHz, int32_t* pattern, uint32_t* count) const;
+    uint32_t latestSeq() const;
+
+  private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t slotSlices;
+        std::atomic<uint32_t> latestSeq;
+    };
+
+    struct SlotHeader {
+        std::atomic<uint32_t> lock;
+        uint32_t seq;
+        int32_t frequencyHz;
+        uint32_t count;
+    };
+
+    SlotHeader* slot(uint32_t index) const;
+    int32_t* slotPattern(SlotHeader* s) const;
+
+    int mFd = -1;
+    uint8_t* mBase = nullptr;
+    size_t mSize = 0;
+    uint32_t mSlotCount = 0;
+    uint32_t mSlotSlices = 0;
+    uint32_t mNextSeq = 1;
+    SlotHeader* mWriting = nullptr;
+};
+
+}  // namespace aidl::android::hardware::ir
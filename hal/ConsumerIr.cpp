@@ -0,0 +1,652 @@
+#define LOG_TAG "ConsumerIrHal"
+#define ATRACE_TAG ATRACE_TAG_HAL
+
+#include "ConsumerIr.h"
+#include "PatternCanon.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <cutils/trace.h>
+#include <log/log.h>
+
+namespace aidl::android::hardware::ir {
+
+static const char kTransmitPath[] = "/sys/kernel/infrared/transmit";
+static const char kReceivePath[] = "/sys/kernel/infrared/receive";
+static const char kCapturePath[] = "/sys/kernel/infrared/capture";
+static const char kCaptureDevPath[] = "/dev/ir_capture";
+// O mesmo transmit sem o limite de uma página do sysfs (padrões em partes)
+static const char kTransmitDevPath[] = "/dev/ir_transmit";
+static const char kCapsPath[] = "/sys/kernel/infrared/caps";
+static const char kMacroPath[] = "/sys/kernel/infrared/macro";
+
+// Mesmo limite do firmware (MACRO_NAME_BYTES - 1)
+static constexpr size_t kMacroNameMax = 15;
+
+// Prazos de fila das lanes (IoLoop). À frente de um interativo há no
+// máximo um transmit no fio: até 2 s de padrão (com o espaço final) mais o
+// upload na UART (~1,8 s para 4096 fatias). Depois de 5 s a tecla já não serve.
+// O de fundo cobre alguns padrões de 2 s na fila.
+static constexpr int kInteractiveTimeoutMs = 5000;
+static constexpr int kBackgroundTimeoutMs = 10000;
+
+// Capacidade do anel: 8 capturas de até 1024 fatias (~33 KiB)
+static constexpr uint32_t kCaptureSlots = 8;
+static constexpr uint32_t kCaptureSlotSlices = 1024;
+
+static const std::vector<ConsumerIrFreqRange> kSupportedFreqs = {
+        {.minHz = 30000, .maxHz = 30000}, {.minHz = 33000, .maxHz = 33000},
+        {.minHz = 36000, .maxHz = 36000}, {.minHz = 38000, .maxHz = 38000},
+        {.minHz = 40000, .maxHz = 40000}, {.minHz = 56000, .maxHz = 56000},
+};
+
+// O sysfs só aceita o comando inteiro num único write(). Em falha, *error
+// recebe o errno (ECANCELED: TX de fundo cortado por um interativo).
+static bool writeSysfs(const char* path, const std::string& cmd, int* error = nullptr) {
+    ::android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(path, O_WRONLY | O_CLOEXEC)));
+    if (fd < 0) {
+        if (error) *error = errno;
+        ALOGE("Falha ao abrir %s", path);
+        return false;
+    }
+    ssize_t n = TEMP_FAILURE_RETRY(write(fd, cmd.data(), cmd.size()));
+    if (n != (ssize_t)cmd.size()) {
+        if (error) *error = (n < 0) ? errno : EIO;
+        ALOGE("Falha ao escrever em %s (%zd)", path, n);
+        return false;
+    }
+    return true;
+}
+
+// Trabalho de lane que escreve cmd em path. Retorna 0 ou -errno.
+static IoLoop::Work writeWork(const char* path, std::string cmd) {
+    return [path, cmd = std::move(cmd)]() -> int64_t {
+        int error = 0;
+        return writeSysfs(path, cmd, &error) ? 0 : -(error ? error : EIO);
+    };
+}
+
+// Converte "REC <freq> 9000,4500,560,..." direto para o buffer de destino.
+// Retorna o número de fatias, ou -1 se a linha não for um REC válido.
+static int parseRecLine(const char* line, int32_t* frequencyHz, int32_t* out, uint32_t capacity) {
+    if (strncmp(line, "REC ", 4) != 0) return -1;
+
+    char* p = nullptr;
+    long freq = strtol(line + 4, &p, 10);
+    if (p == line + 4 || freq <= 0) return -1;
+    *frequencyHz = (int32_t)freq;
+
+    uint32_t n = 0;
+    while (*p && n < capacity) {
+        while (*p == ' ' || *p == ',') p++;
+        if (*p < '0' || *p > '9') break;
+        long us = strtol(p, &p, 10);
+        if (us > 0) out[n++] = (int32_t)us;
+    }
+    return (int)n;
+}
+
+// Converte "fmin=1000 fmax=255000 slices=256 ... proto=NEC,TX" (sysfs caps)
+static bool parseCaps(const std::string& text, ConsumerIrCapabilities* caps) {
+    bool any = false;
+    for (const std::string& field : ::android::base::Split(::android::base::Trim(text), " ")) {
+        size_t eq = field.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = field.substr(0, eq);
+        std::string value = field.substr(eq + 1);
+        int32_t n = atoi(value.c_str());
+
+        if (key == "fmin") caps->minCarrierHz = n;
+        else if (key == "fmax") caps->maxCarrierHz = n;
+        else if (key == "slices") caps->maxSlices = n;
+        else if (key == "maxus") caps->maxDurationUs = n;
+        else if (key == "ch") caps->channelCount = n;
+        else if (key == "line") caps->lineBytes = n;
+        else if (key == "rec") caps->captureBytes = n;
+        else if (key == "proto") caps->protocols = ::android::base::Split(value, ",");
+        else if (key == "macros") caps->maxMacros = n;
+        else if (key == "steps") caps->maxMacroSteps = n;
+        else continue;
+        any = true;
+    }
+    return any && caps->channelCount > 0 && caps->maxCarrierHz >= caps->minCarrierHz;
+}
+
+ConsumerIr::ConsumerIr() {
+    mRingReady = mRing.init(kCaptureSlots, kCaptureSlotSlices);
+    if (!mRingReady) ALOGE("Anel de capturas indisponível; captureToRing() vai falhar");
+    if (!mLoop.start()) ALOGE("Sem laço de E/S; as chamadas vão direto ao sysfs");
+}
+
+ConsumerIr::~ConsumerIr() {
+    delete mCaps.load();
+}
+
+const ConsumerIrCapabilities* ConsumerIr::capabilities() {
+    const ConsumerIrCapabilities* caps = mCaps.load(std::memory_order_acquire);
+    if (caps != nullptr) return caps;
+
+    std::string text;
+    if (!::android::base::ReadFileToString(kCapsPath, &text)) return nullptr;
+
+    auto* parsed = new ConsumerIrCapabilities();
+    if (!parseCaps(text, parsed)) {
+        ALOGE("Conteúdo inválido em %s: '%s'", kCapsPath, text.c_str());
+        delete parsed;
+        return nullptr;
+    }
+
+    // Duas threads podem carregar ao mesmo tempo: só a primeira publica
+    const ConsumerIrCapabilities* expected = nullptr;
+    if (!mCaps.compare_exchange_strong(expected, parsed, std::memory_order_acq_rel)) {
+        delete parsed;
+        return expected;
+    }
+    ALOGI("Capacidades: %d-%d Hz, %d fatias, %d canal(is)", parsed->minCarrierHz,
+          parsed->maxCarrierHz, parsed->maxSlices, parsed->channelCount);
+    return parsed;
+}
+
+// Pré-validação com as capacidades cacheadas: erros voltam sem tocar no sysfs
+ndk::ScopedAStatus ConsumerIr::checkPattern(int32_t carrierFreqHz,
+                                            const std::vector<int32_t>& pattern,
+                                            size_t commandBytes) {
+    if (carrierFreqHz <= 0 || pattern.empty()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    const ConsumerIrCapabilities* caps = capabilities();
+    if (caps == nullptr) return ndk::ScopedAStatus::ok();
+
+    if (carrierFreqHz < caps->minCarrierHz || carrierFreqHz > caps->maxCarrierHz) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    // +4: o driver ainda prefixa "TX " e termina a string. Com UPLOAD, o
+    // driver anuncia o limite de /dev/ir_transmit e manda o padrão em partes
+    if ((int64_t)pattern.size() > caps->maxSlices || (int64_t)commandBytes + 4 > caps->lineBytes) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::getCarrierFreqs(std::vector<ConsumerIrFreqRange>* _aidl_return) {
+    const ConsumerIrCapabilities* caps = capabilities();
+    if (caps == nullptr) {
+        *_aidl_return = kSupportedFreqs;
+    } else {
+        *_aidl_return = {{.minHz = caps->minCarrierHz, .maxHz = caps->maxCarrierHz}};
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::getCapabilities(ConsumerIrCapabilities* _aidl_return) {
+    const ConsumerIrCapabilities* caps = capabilities();
+    if (caps == nullptr) return ndk::ScopedAStatus::fromServiceSpecificError(-ENODEV);
+    *_aidl_return = *caps;
+    return ndk::ScopedAStatus::ok();
+}
+
+// Acrescenta "<freqHz> <us,us,...>\n" ao comando
+static void appendPattern(std::string* cmd, int32_t carrierFreqHz, const std::vector<int32_t>& pattern) {
+    *cmd += std::to_string(carrierFreqHz);
+    *cmd += ' ';
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (i) *cmd += ',';
+        *cmd += std::to_string(pattern[i]);
+    }
+    *cmd += '\n';
+}
+
+// Acrescenta "RAW @<freqHz> <b,b,...>\n" (fatias em kRawTickUs) ao comando
+static void appendRawPattern(std::string* cmd, int32_t carrierFreqHz, const std::vector<uint8_t>& ticks) {
+    *cmd += "RAW @";
+    *cmd += std::to_string(carrierFreqHz);
+    *cmd += ' ';
+    for (size_t i = 0; i < ticks.size(); i++) {
+        if (i) *cmd += ',';
+        *cmd += std::to_string(ticks[i]);
+    }
+    *cmd += '\n';
+}
+
+// Seção do atrace com o id de correlação no nome; só formata com o atrace ligado
+class ScopedIrTrace {
+  public:
+    ScopedIrTrace(const char* what, int64_t correlationId) : mOn(ATRACE_ENABLED()) {
+        if (!mOn) return;
+        char name[64];
+        snprintf(name, sizeof(name), "%s id=%" PRIx64, what, (uint64_t)correlationId);
+        ATRACE_BEGIN(name);
+    }
+    ~ScopedIrTrace() {
+        if (mOn) ATRACE_END();
+    }
+
+  private:
+    const bool mOn;
+};
+
+ndk::ScopedAStatus ConsumerIr::sendPattern(int64_t correlationId, int32_t channel,
+                                           int32_t priority, int32_t carrierFreqHz,
+                                           const std::vector<int32_t>& pattern) {
+    ScopedIrTrace trace("IrHal.transmit", correlationId);
+
+    // Fatias fundidas e, no canal 0, sem o espaço final (veja PatternCanon.h)
+    CanonicalPattern canon;
+    const bool canonical = canonicalizePattern(pattern, channel == 0, &canon);
+    const std::vector<int32_t>& slices = canonical ? canon.slices : pattern;
+    const ConsumerIrCapabilities* caps = capabilities();
+    const bool useRaw = canonical && channel == 0 && !canon.rawTicks.empty() && caps != nullptr &&
+                        std::find(caps->protocols.begin(), caps->protocols.end(), "RAW@") !=
+                                caps->protocols.end();
+
+    // Formato do driver: "[!][@<id> ]RAW @<freqHz> <b,...>\n" quando a quantização
+    // é equivalente; senão "[!][@<id> ][TXC <ch> ]<freqHz> <us,us,...>\n"
+    const bool interactive = priority == PRIORITY_INTERACTIVE;
+    std::string cmd = interactive ? "!" : "";
+    if (correlationId != 0) {
+        char prefix[24];
+        snprintf(prefix, sizeof(prefix), "@%" PRIx64 " ", (uint64_t)correlationId);
+        cmd += prefix;
+    }
+    if (useRaw) {
+        appendRawPattern(&cmd, carrierFreqHz, canon.rawTicks);
+    } else {
+        if (channel != 0) cmd += "TXC " + std::to_string(channel) + " ";
+        appendPattern(&cmd, carrierFreqHz, slices);
+    }
+
+    ndk::ScopedAStatus status = checkPattern(carrierFreqHz, slices, cmd.size());
+    if (!status.isOk()) return status;
+
+    // O TX no canal 0 volta no fim da transmissão: o espaço final retirado é
+    // esperado na lane, para o próximo transmit sair no mesmo instante
+    const useconds_t gapUs = canonical ? canon.trailingGapUs : 0;
+    int64_t ret = mLoop.run(
+            interactive ? IoLoop::LANE_INTERACTIVE : IoLoop::LANE_BACKGROUND,
+            interactive ? kInteractiveTimeoutMs : kBackgroundTimeoutMs,
+            [cmd = std::move(cmd), gapUs]() -> int64_t {
+                int error = 0;
+                // O sysfs recusa (E2BIG) uma escrita maior que a página
+                static const size_t kPageBytes = (size_t)sysconf(_SC_PAGESIZE);
+                const char* path = cmd.size() > kPageBytes ? kTransmitDevPath : kTransmitPath;
+                if (!writeSysfs(path, cmd, &error)) return -(error ? error : EIO);
+                if (gapUs > 0) usleep(gapUs);
+                return 0;
+            });
+    if (ret == -ECANCELED) {
+        ALOGI("Transmit id=%" PRIx64 " cortado por um transmit interativo", (uint64_t)correlationId);
+        return ndk::ScopedAStatus::fromServiceSpecificError(-ECANCELED);
+    }
+    if (ret == -ETIMEDOUT) {
+        ALOGW("Transmit id=%" PRIx64 " canal %d venceu o prazo na fila; não enviado",
+              (uint64_t)correlationId, channel);
+        return ndk::ScopedAStatus::fromServiceSpecificError(-ETIMEDOUT);
+    }
+    if (ret < 0) {
+        ALOGE("Falha no transmit id=%" PRIx64 " canal %d", (uint64_t)correlationId, channel);
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::transmit(int32_t in_carrierFreqHz,
+                                        const std::vector<int32_t>& in_pattern) {
+    // Interativo, como no contrato antigo: nunca é cortado e não volta -ECANCELED
+    return sendPattern(0, 0, PRIORITY_INTERACTIVE, in_carrierFreqHz, in_pattern);
+}
+
+ndk::ScopedAStatus ConsumerIr::getChannelCount(int32_t* _aidl_return) {
+    const ConsumerIrCapabilities* caps = capabilities();
+    *_aidl_return = caps != nullptr ? caps->channelCount : 1;
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::transmitOnChannel(int32_t in_channel, int32_t in_carrierFreqHz,
+                                                 const std::vector<int32_t>& in_pattern) {
+    return transmitWithPriority(0, in_channel, PRIORITY_INTERACTIVE, in_carrierFreqHz, in_pattern);
+}
+
+ndk::ScopedAStatus ConsumerIr::transmitWithId(int64_t in_correlationId, int32_t in_channel,
+                                              int32_t in_carrierFreqHz,
+                                              const std::vector<int32_t>& in_pattern) {
+    return transmitWithPriority(in_correlationId, in_channel, PRIORITY_BACKGROUND,
+                                in_carrierFreqHz, in_pattern);
+}
+
+ndk::ScopedAStatus ConsumerIr::transmitWithPriority(int64_t in_correlationId, int32_t in_channel,
+                                                    int32_t in_priority, int32_t in_carrierFreqHz,
+                                                    const std::vector<int32_t>& in_pattern) {
+    const ConsumerIrCapabilities* caps = capabilities();
+    if (in_channel < 0 || (caps != nullptr && in_channel >= caps->channelCount)) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    if (in_priority != PRIORITY_BACKGROUND && in_priority != PRIORITY_INTERACTIVE) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    return sendPattern(in_correlationId, in_channel, in_priority, in_carrierFreqHz, in_pattern);
+}
+
+ndk::ScopedAStatus ConsumerIr::transmitAt(int64_t in_correlationId, int64_t in_uptimeNanos,
+                                          int32_t in_channel, int32_t in_carrierFreqHz,
+                                          const std::vector<int32_t>& in_pattern) {
+    ScopedIrTrace trace("IrHal.transmitAt", in_correlationId);
+
+    const ConsumerIrCapabilities* caps = capabilities();
+    if (in_channel < 0 || (caps != nullptr && in_channel >= caps->channelCount)) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    if (caps != nullptr && std::find(caps->protocols.begin(), caps->protocols.end(), "TX_AT") ==
+                                   caps->protocols.end()) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EOPNOTSUPP);
+    }
+    if (in_uptimeNanos <= 0) return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+
+    // Sem RAW: o TX_AT só leva µs. O espaço final não é esperado aqui, o
+    // driver volta assim que o firmware arma o padrão.
+    CanonicalPattern canon;
+    const bool canonical = canonicalizePattern(in_pattern, true, &canon);
+    const std::vector<int32_t>& slices = canonical ? canon.slices : in_pattern;
+
+    // "!@<id> AT <ns> <ch> <freqHz> <us,...>\n": interativo, para não
+    // esperar um transmit de fundo e perder o instante
+    std::string cmd = "!";
+    if (in_correlationId != 0) {
+        char prefix[24];
+        snprintf(prefix, sizeof(prefix), "@%" PRIx64 " ", (uint64_t)in_correlationId);
+        cmd += prefix;
+    }
+    cmd += "AT " + std::to_string(in_uptimeNanos) + " " + std::to_string(in_channel) + " ";
+    appendPattern(&cmd, in_carrierFreqHz, slices);
+
+    ndk::ScopedAStatus status = checkPattern(in_carrierFreqHz, slices, cmd.size());
+    if (!status.isOk()) return status;
+
+    int64_t ret = mLoop.run(IoLoop::LANE_INTERACTIVE, kInteractiveTimeoutMs,
+                            writeWork(kTransmitPath, std::move(cmd)));
+    if (ret < 0) {
+        switch (-ret) {
+            case ETIME:
+                ALOGW("TransmitAt id=%" PRIx64 " chegou atrasado ao firmware",
+                      (uint64_t)in_correlationId);
+                return ndk::ScopedAStatus::fromServiceSpecificError(-ETIME);
+            case ERANGE:
+            case EOPNOTSUPP:
+            case ETIMEDOUT:
+                return ndk::ScopedAStatus::fromServiceSpecificError((int32_t)ret);
+            case EINVAL:
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            default:
+                ALOGE("Falha no transmitAt id=%" PRIx64 " canal %d", (uint64_t)in_correlationId,
+                      in_channel);
+                return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+        }
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+uint32_t ConsumerIr::captureOnLane() {
+    if (!mRingReady) return 0;
+    if (!writeSysfs(kReceivePath, "LAST_RECV\n")) return 0;
+
+    std::string line;
+    if (!::android::base::ReadFileToString(kReceivePath, &line)) {
+        ALOGE("Falha ao ler %s", kReceivePath);
+        return 0;
+    }
+
+    int32_t* slot = mRing.beginWrite();
+    if (slot == nullptr) return 0;
+
+    int32_t freq = 0;
+    int n = parseRecLine(line.c_str(), &freq, slot, mRing.slotSlices());
+    if (n <= 0) {
+        ALOGE("Resposta do receive inválida: '%s'", line.c_str());
+        mRing.abort();
+        return 0;
+    }
+    return mRing.commit(freq, (uint32_t)n);
+}
+
+ndk::ScopedAStatus ConsumerIr::lastReceive(ConsumerIrCapture* _aidl_return) {
+    int64_t seq = mLoop.run(IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs,
+                            [this]() -> int64_t { return captureOnLane(); });
+    if (seq <= 0) return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+
+    // Caminho legado: copia o slot para o parcelable. O seqlock do anel
+    // detecta uma captura mais nova sobrescrevendo o slot durante a cópia.
+    uint32_t count = 0;
+    _aidl_return->patternMicros.resize(mRing.slotSlices());
+    if (!mRing.read((uint32_t)seq, &_aidl_return->frequencyHz, _aidl_return->patternMicros.data(),
+                    &count)) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    }
+    _aidl_return->patternMicros.resize(count);
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::getCaptureMemory(ConsumerIrCaptureMemory* _aidl_return) {
+    if (!mRingReady) return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+
+    // O parcelable assume a posse do fd: entregamos uma cópia (região já selada RO)
+    _aidl_return->memory = ndk::ScopedFileDescriptor(dup(mRing.fd()));
+    _aidl_return->slotCount = (int32_t)mRing.slotCount();
+    _aidl_return->slotSlices = (int32_t)mRing.slotSlices();
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::captureToRing(int64_t* _aidl_return) {
+    int64_t seq = mLoop.run(IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs,
+                            [this]() -> int64_t { return captureOnLane(); });
+    if (seq <= 0) return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    *_aidl_return = seq;
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::startCaptureSession(ndk::ScopedFileDescriptor* _aidl_return) {
+    // O driver só troca o bulk IN para o modo binário depois do CAP START
+    if (mLoop.run(IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs,
+                  writeWork(kCapturePath, "START\n")) < 0) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    }
+
+    // O fd do char device vai direto para o app: as amostras não passam pela HAL
+    int fd = TEMP_FAILURE_RETRY(open(kCaptureDevPath, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        ALOGE("Falha ao abrir %s", kCaptureDevPath);
+        mLoop.run(IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs, writeWork(kCapturePath, "STOP\n"));
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    }
+    *_aidl_return = ndk::ScopedFileDescriptor(fd);
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::stopCaptureSession() {
+    if (mLoop.run(IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs,
+                  writeWork(kCapturePath, "STOP\n")) < 0) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+// ====== Macros ======
+// O firmware guarda e executa as macros; a HAL só traduz para as linhas de
+// /sys/kernel/infrared/macro (NEW/ADD/RUN/CANCEL/DEL) e lê o STATUS.
+
+static bool validMacroName(const std::string& name) {
+    if (name.empty() || name.size() > kMacroNameMax) return false;
+    for (char c : name) {
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-') return false;
+    }
+    return true;
+}
+
+// Converte "run=tv step=1/4 last=ac result=done us=85041 late=12" (sysfs macro)
+static bool parseMacroStatus(const std::string& text, ConsumerIrMacroStatus* status) {
+    bool any = false;
+    *status = {};
+    for (const std::string& field : ::android::base::Split(::android::base::Trim(text), " ")) {
+        size_t eq = field.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = field.substr(0, eq);
+        std::string value = field.substr(eq + 1);
+
+        if (key == "run") {
+            status->running = value != "-";
+            if (status->running) status->name = value;
+        } else if (key == "step") {
+            sscanf(value.c_str(), "%d/%d", &status->step, &status->stepCount);
+        } else if (key == "last") {
+            if (value != "-") status->lastMacro = value;
+        } else if (key == "result") {
+            if (value != "-") status->lastResult = value;
+        } else if (key == "us") {
+            status->lastDurationUs = atoll(value.c_str());
+        } else if (key == "late") {
+            status->lastMaxLatenessUs = atoi(value.c_str());
+        } else {
+            continue;
+        }
+        any = true;
+    }
+    return any;
+}
+
+bool ConsumerIr::readMacroStatusOnLane(ConsumerIrMacroStatus* status) {
+    std::string text;
+    if (!::android::base::ReadFileToString(kMacroPath, &text)) {
+        ALOGE("Falha ao ler %s", kMacroPath);
+        return false;
+    }
+    if (!parseMacroStatus(text, status)) {
+        ALOGE("Conteúdo inválido em %s: '%s'", kMacroPath, text.c_str());
+        return false;
+    }
+    return true;
+}
+
+ndk::ScopedAStatus ConsumerIr::macroStepLine(const std::string& name,
+                                             const ConsumerIrMacroStep& step,
+                                             std::string* line) {
+    *line = "ADD " + name + " ";
+    switch (step.type) {
+        case ConsumerIrMacroStep::TYPE_PATTERN: {
+            const ConsumerIrCapabilities* caps = capabilities();
+            if (step.channel < 0 || (caps != nullptr && step.channel >= caps->channelCount)) {
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            }
+            *line += (step.channel == 0) ? "TX " : "TXC " + std::to_string(step.channel) + " ";
+            appendPattern(line, step.carrierFreqHz, step.pattern);
+            // "MACRO " vai na frente no driver
+            return checkPattern(step.carrierFreqHz, step.pattern, line->size() + 6);
+        }
+        case ConsumerIrMacroStep::TYPE_NEC: {
+            char hex[16];
+            snprintf(hex, sizeof(hex), "NEC %08X\n", (uint32_t)step.necCode);
+            *line += hex;
+            return ndk::ScopedAStatus::ok();
+        }
+        case ConsumerIrMacroStep::TYPE_DELAY:
+            if (step.delayUs < 0) return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            *line += "WAIT " + std::to_string(step.delayUs) + "\n";
+            return ndk::ScopedAStatus::ok();
+        default:
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+}
+
+ndk::ScopedAStatus ConsumerIr::defineMacro(const std::string& in_name,
+                                           const std::vector<ConsumerIrMacroStep>& in_steps) {
+    ScopedIrTrace trace("IrHal.defineMacro", 0);
+    if (!validMacroName(in_name) || in_steps.empty()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    const ConsumerIrCapabilities* caps = capabilities();
+    if (caps != nullptr && caps->maxMacroSteps > 0 && (int64_t)in_steps.size() > caps->maxMacroSteps) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    // Monta e valida tudo antes de tocar no firmware
+    std::vector<std::string> lines;
+    lines.reserve(in_steps.size());
+    for (const ConsumerIrMacroStep& step : in_steps) {
+        std::string line;
+        ndk::ScopedAStatus status = macroStepLine(in_name, step, &line);
+        if (!status.isOk()) return status;
+        lines.push_back(std::move(line));
+    }
+
+    // NEW + ADDs num único trabalho: nada da lane entra no meio da macro
+    int64_t ret = mLoop.run(
+            IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs,
+            [this, name = in_name, lines = std::move(lines)]() -> int64_t {
+                ConsumerIrMacroStatus status;
+                if (readMacroStatusOnLane(&status) && status.running) return -EBUSY;
+                if (!writeSysfs(kMacroPath, "NEW " + name + "\n")) return -EIO;
+                for (const std::string& line : lines) {
+                    if (!writeSysfs(kMacroPath, line)) {
+                        // Não deixa meia macro no firmware
+                        ALOGE("Falha ao definir a macro %s", name.c_str());
+                        writeSysfs(kMacroPath, "DEL " + name + "\n");
+                        return -EIO;
+                    }
+                }
+                return 0;
+            });
+    if (ret == -EBUSY) return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    if (ret < 0) return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::runMacro(const std::string& in_name) {
+    ScopedIrTrace trace("IrHal.runMacro", 0);
+    if (!validMacroName(in_name)) return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+
+    if (mLoop.run(IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs,
+                  writeWork(kMacroPath, "RUN " + in_name + "\n")) < 0) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::cancelMacro() {
+    if (mLoop.run(IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs,
+                  writeWork(kMacroPath, "CANCEL\n")) < 0) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::deleteMacro(const std::string& in_name) {
+    if (!validMacroName(in_name)) return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+
+    if (mLoop.run(IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs,
+                  writeWork(kMacroPath, "DEL " + in_name + "\n")) < 0) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus ConsumerIr::getMacroStatus(ConsumerIrMacroStatus* _aidl_return) {
+    auto status = std::make_shared<ConsumerIrMacroStatus>();
+    if (mLoop.run(IoLoop::LANE_BACKGROUND, kBackgroundTimeoutMs, [this, status]() -> int64_t {
+            return readMacroStatusOnLane(status.get()) ? 0 : -EIO;
+        }) < 0) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-EIO);
+    }
+    *_aidl_return = *status;
+    return ndk::ScopedAStatus::ok();
+}
+
+}  // namespace aidl::android::hardware::ir
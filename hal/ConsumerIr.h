@@ -0,0 +1,82 @@
+#pragma once
+
+#include <aidl/android/hardware/ir/BnConsumerIr.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "CaptureRing.h"
+#include "IoLoop.h"
+
+namespace aidl::android::hardware::ir {
+
+// HAL do emissor/receptor IR DevTITANS.
+// Fala com o driver ir_remote via /sys/kernel/infrared/{transmit,receive}.
+// Toda E/S nesses nós passa pelo mLoop (veja IoLoop.h): as threads do
+// binder validam, montam o comando e esperam a lane.
+class ConsumerIr : public BnConsumerIr {
+  public:
+    ConsumerIr();
+    ~ConsumerIr();
+
+    ndk::ScopedAStatus getCarrierFreqs(std::vector<ConsumerIrFreqRange>* _aidl_return) override;
+    ndk::ScopedAStatus getCapabilities(ConsumerIrCapabilities* _aidl_return) override;
+    ndk::ScopedAStatus transmit(int32_t in_carrierFreqHz,
+                                const std::vector<int32_t>& in_pattern) override;
+    ndk::ScopedAStatus getChannelCount(int32_t* _aidl_return) override;
+    ndk::ScopedAStatus transmitOnChannel(int32_t in_channel, int32_t in_carrierFreqHz,
+                                         const std::vector<int32_t>& in_pattern) override;
+    ndk::ScopedAStatus transmitWithId(int64_t in_correlationId, int32_t in_channel,
+                                      int32_t in_carrierFreqHz,
+                                      const std::vector<int32_t>& in_pattern) override;
+    ndk::ScopedAStatus transmitWithPriority(int64_t in_correlationId, int32_t in_channel,
+                                            int32_t in_priority, int32_t in_carrierFreqHz,
+                                            const std::vector<int32_t>& in_pattern) override;
+    ndk::ScopedAStatus transmitAt(int64_t in_correlationId, int64_t in_uptimeNanos,
+                                  int32_t in_channel, int32_t in_carrierFreqHz,
+                                  const std::vector<int32_t>& in_pattern) override;
+    ndk::ScopedAStatus lastReceive(ConsumerIrCapture* _aidl_return) override;
+    ndk::ScopedAStatus getCaptureMemory(ConsumerIrCaptureMemory* _aidl_return) override;
+    ndk::ScopedAStatus captureToRing(int64_t* _aidl_return) override;
+    ndk::ScopedAStatus startCaptureSession(ndk::ScopedFileDescriptor* _aidl_return) override;
+    ndk::ScopedAStatus stopCaptureSession() override;
+    ndk::ScopedAStatus defineMacro(const std::string& in_name,
+                                   const std::vector<ConsumerIrMacroStep>& in_steps) override;
+    ndk::ScopedAStatus runMacro(const std::string& in_name) override;
+    ndk::ScopedAStatus cancelMacro() override;
+    ndk::ScopedAStatus deleteMacro(const std::string& in_name) override;
+    ndk::ScopedAStatus getMacroStatus(ConsumerIrMacroStatus* _aidl_return) override;
+
+  private:
+    // Dispara LAST_RECV no driver e grava a captura direto no anel.
+    // Retorna a sequência da captura, ou 0 em caso de erro. Só na lane de fundo.
+    uint32_t captureOnLane();
+
+    // Capacidades lidas de /sys/kernel/infrared/caps. Publicadas uma única
+    // vez (o driver consulta o firmware só no probe) e depois lidas sem lock.
+    // Retorna nullptr enquanto o dispositivo não estiver presente.
+    const ConsumerIrCapabilities* capabilities();
+    // Canal 0 vai no formato do TX (ou do RAW compacto, se a forma canônica
+    // permitir); os demais como "TXC <ch> ...". Com id != 0 a linha leva o
+    // prefixo "@<hex> " que o driver repassa ao firmware; o interativo leva
+    // "!" antes de tudo e vai pela lane interativa, em paralelo com a de fundo.
+    ndk::ScopedAStatus sendPattern(int64_t correlationId, int32_t channel, int32_t priority,
+                                   int32_t carrierFreqHz, const std::vector<int32_t>& pattern);
+    ndk::ScopedAStatus checkPattern(int32_t carrierFreqHz, const std::vector<int32_t>& pattern,
+                                    size_t commandBytes);
+
+    // Linha "ADD <nome> ..." do passo, já validado contra as capacidades
+    ndk::ScopedAStatus macroStepLine(const std::string& name, const ConsumerIrMacroStep& step,
+                                     std::string* line);
+    // Lê /sys/kernel/infrared/macro. Só na lane de fundo.
+    bool readMacroStatusOnLane(ConsumerIrMacroStatus* status);
+
+    CaptureRing mRing;
+    bool mRingReady = false;
+    std::atomic<const ConsumerIrCapabilities*> mCaps{nullptr};
+    // Por último: é destruído primeiro, antes do anel que as lanes usam
+    IoLoop mLoop;
+};
+
+}  // namespace aidl::android::hardware::ir
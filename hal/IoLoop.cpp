@@ -0,0 +1,224 @@
+#define LOG_TAG "ConsumerIrHal"
+
+#include "IoLoop.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <log/log.h>
+
+namespace aidl::android::hardware::ir {
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+IoLoop::~IoLoop() {
+    if (!mStarted) return;
+
+    mStopping = true;
+    wake();
+    mLoopThread.join();
+    {
+        std::lock_guard<std::mutex> lock(mLaneLock);
+        for (auto& cv : mLaneCv) cv.notify_all();
+    }
+    for (auto& t : mLaneThreads) t.join();
+
+    // Sem o laço, quem ainda espera volta daqui
+    auto finish = [](const std::shared_ptr<Op>& op) {
+        if (op && !op->completed) {
+            op->completed = true;
+            op->done.set_value(-ESHUTDOWN);
+        }
+    };
+    for (auto& op : mSubmitted) finish(op);
+    for (auto& op : mFinished) finish(op);
+    for (int l = 0; l < LANE_COUNT; l++) {
+        for (auto& op : mPending[l]) finish(op);
+        finish(mInflight[l]);
+        finish(mAssigned[l]);
+    }
+
+    close(mTimerFd);
+    close(mWakeFd);
+    close(mEpollFd);
+}
+
+bool IoLoop::start() {
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (mEpollFd < 0 || mWakeFd < 0 || mTimerFd < 0) {
+        ALOGE("Laço de E/S indisponível: %s", strerror(errno));
+        goto err;
+    }
+
+    for (int fd : {mWakeFd, mTimerFd}) {
+        struct epoll_event ev = {.events = EPOLLIN, .data = {.fd = fd}};
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            ALOGE("epoll_ctl: %s", strerror(errno));
+            goto err;
+        }
+    }
+
+    for (int l = 0; l < LANE_COUNT; l++) {
+        mLaneThreads[l] = std::thread(&IoLoop::laneMain, this, (Lane)l);
+    }
+    mLoopThread = std::thread(&IoLoop::loopMain, this);
+    mStarted = true;
+    return true;
+
+err:
+    if (mTimerFd >= 0) close(mTimerFd);
+    if (mWakeFd >= 0) close(mWakeFd);
+    if (mEpollFd >= 0) close(mEpollFd);
+    mEpollFd = mWakeFd = mTimerFd = -1;
+    return false;
+}
+
+int64_t IoLoop::run(Lane lane, int timeoutMs, Work work) {
+    if (!mStarted) return work();
+
+    auto op = std::make_shared<Op>();
+    op->work = std::move(work);
+    op->lane = lane;
+    op->deadlineNs = nowNs() + (int64_t)timeoutMs * 1000000LL;
+    std::future<int64_t> done = op->done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mInboxLock);
+        mSubmitted.push_back(op);
+    }
+    wake();
+    return done.get();
+}
+
+void IoLoop::wake() {
+    uint64_t one = 1;
+    if (TEMP_FAILURE_RETRY(write(mWakeFd, &one, sizeof(one))) < 0 && errno != EAGAIN) {
+        ALOGE("Falha ao acordar o laço de E/S: %s", strerror(errno));
+    }
+}
+
+void IoLoop::loopMain() {
+    struct epoll_event events[2];
+
+    while (!mStopping) {
+        int n = epoll_wait(mEpollFd, events, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ALOGE("epoll_wait: %s", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t count;
+            // Os dois fds só servem de campainha: o contador é descartado
+            TEMP_FAILURE_RETRY(read(events[i].data.fd, &count, sizeof(count)));
+        }
+        drainInbox();
+        expire(nowNs());
+        dispatch();
+        armTimer();
+    }
+}
+
+void IoLoop::laneMain(Lane lane) {
+    for (;;) {
+        std::shared_ptr<Op> op;
+        {
+            std::unique_lock<std::mutex> lock(mLaneLock);
+            mLaneCv[lane].wait(lock, [&] { return mStopping || mAssigned[lane] != nullptr; });
+            if (mStopping) return;
+            op = mAssigned[lane];
+        }
+        op->result = op->work();
+        {
+            std::lock_guard<std::mutex> lock(mLaneLock);
+            mAssigned[lane] = nullptr;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mInboxLock);
+            mFinished.push_back(std::move(op));
+        }
+        wake();
+    }
+}
+
+void IoLoop::drainInbox() {
+    std::vector<std::shared_ptr<Op>> submitted, finished;
+    {
+        std::lock_guard<std::mutex> lock(mInboxLock);
+        submitted.swap(mSubmitted);
+        finished.swap(mFinished);
+    }
+    for (auto& op : finished) {
+        mInflight[op->lane] = nullptr;
+        complete(op, op->result);
+    }
+    for (auto& op : submitted) mPending[op->lane].push_back(std::move(op));
+}
+
+// Só a fila vence: um trabalho que já começou pode estar no fio, e um
+// ETIMEDOUT faria o cliente repetir um código de liga/desliga que saiu.
+// O driver limita cada write() (até o COMMIT de um padrão de 2 s).
+void IoLoop::expire(int64_t nowNs) {
+    for (int l = 0; l < LANE_COUNT; l++) {
+        auto& pending = mPending[l];
+        for (auto it = pending.begin(); it != pending.end();) {
+            if ((*it)->deadlineNs > nowNs) {
+                ++it;
+                continue;
+            }
+            complete(*it, -ETIMEDOUT);
+            mExpired++;
+            it = pending.erase(it);
+        }
+    }
+}
+
+void IoLoop::dispatch() {
+    for (int l = 0; l < LANE_COUNT; l++) {
+        if (mInflight[l] || mPending[l].empty()) continue;
+
+        mInflight[l] = std::move(mPending[l].front());
+        mPending[l].pop_front();
+        std::lock_guard<std::mutex> lock(mLaneLock);
+        mAssigned[l] = mInflight[l];
+        mLaneCv[l].notify_one();
+    }
+}
+
+void IoLoop::armTimer() {
+    int64_t next = INT64_MAX;
+    for (int l = 0; l < LANE_COUNT; l++) {
+        for (const auto& op : mPending[l]) next = std::min(next, op->deadlineNs);
+    }
+
+    // it_value zerado desarma o timer
+    struct itimerspec its = {};
+    if (next != INT64_MAX) {
+        its.it_value.tv_sec = next / 1000000000LL;
+        its.it_value.tv_nsec = next % 1000000000LL;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1;
+    }
+    if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &its, nullptr) < 0) {
+        ALOGE("timerfd_settime: %s", strerror(errno));
+    }
+}
+
+void IoLoop::complete(const std::shared_ptr<Op>& op, int64_t result) {
+    op->completed = true;
+    op->done.set_value(result);
+}
+
+}  // namespace aidl::android::hardware::ir
@@ -0,0 +1,117 @@
+/*
+ * Laço de E/S da HAL.
+ *
+ * Os nós de /sys/kernel/infrared não têm E/S assíncrona: o write() de um
+ * transmit só volta depois do [OK] do firmware. Se cada thread do binder
+ * escrevesse direto, um dispositivo lento prenderia todos os clientes. A
+ * HAL separa os dois lados:
+ *
+ *   - as threads do binder só enfileiram o trabalho (run()) e esperam a
+ *     conclusão;
+ *   - um único laço epoll recebe as submissões e as conclusões por um
+ *     eventfd e os prazos por um timerfd, distribui o trabalho e completa
+ *     quem está esperando;
+ *   - o write() bloqueante roda numa lane fixa por classe de prioridade
+ *     (uma thread cada), no lugar dos antigos mLock/mInteractiveLock. As
+ *     lanes executam em paralelo, então um transmit interativo chega ao
+ *     driver enquanto um de fundo ainda está no fio.
+ *
+ * O número de threads não cresce com clientes nem com dispositivos na
+ * fila. O prazo vale só para a fila: um trabalho que ainda não começou
+ * quando ele vence é descartado (uma tecla apertada há segundos não sai
+ * mais); um que já começou devolve o resultado real do write(), porque o
+ * padrão pode ter saído.
+ *
+ * O trabalho recebe cópias do que usa: no destrutor o chamador volta com
+ * ESHUTDOWN e a lane ainda pode estar executando.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aidl::android::hardware::ir {
+
+class IoLoop {
+  public:
+    enum Lane : uint8_t {
+        LANE_BACKGROUND = 0,  // transmits de fundo, recepção, captura e macros
+        LANE_INTERACTIVE,     // transmits interativos e agendados
+        LANE_COUNT,
+    };
+
+    // Retorna >= 0 (valor do chamador) ou -errno
+    using Work = std::function<int64_t()>;
+
+    IoLoop() = default;
+    ~IoLoop();
+
+    IoLoop(const IoLoop&) = delete;
+    IoLoop& operator=(const IoLoop&) = delete;
+
+    // Cria o epoll, o eventfd, o timerfd e as threads. Se falhar, run()
+    // executa o trabalho direto na thread do chamador.
+    bool start();
+
+    // Executa work na lane e espera o resultado. Retorna o valor de work,
+    // ou -ETIMEDOUT se ficou na fila por mais de timeoutMs sem começar.
+    int64_t run(Lane lane, int timeoutMs, Work work);
+
+  private:
+    struct Op {
+        Work work;
+        int64_t deadlineNs = 0;   // CLOCK_MONOTONIC; só enquanto está na fila
+        Lane lane = LANE_BACKGROUND;
+        int64_t result = 0;       // escrito pela lane
+        bool completed = false;   // só o laço mexe
+        std::promise<int64_t> done;
+    };
+
+    void loopMain();
+    void laneMain(Lane lane);
+
+    // Só na thread do laço
+    void drainInbox();
+    void expire(int64_t nowNs);
+    void dispatch();
+    void armTimer();
+    void complete(const std::shared_ptr<Op>& op, int64_t result);
+
+    void wake();
+
+    int mEpollFd = -1;
+    int mWakeFd = -1;   // eventfd: submissões e conclusões
+    int mTimerFd = -1;  // timerfd: próximo prazo
+    bool mStarted = false;
+    std::atomic<bool> mStopping{false};
+
+    // Caixa de entrada do laço, preenchida pelo binder e pelas lanes
+    std::mutex mInboxLock;
+    std::vector<std::shared_ptr<Op>> mSubmitted;
+    std::vector<std::shared_ptr<Op>> mFinished;
+
+    // Estado do laço: filas e o que está em cada lane
+    std::deque<std::shared_ptr<Op>> mPending[LANE_COUNT];
+    std::shared_ptr<Op> mInflight[LANE_COUNT];
+    uint64_t mExpired = 0;  // descartados na fila
+
+    // Entrega do laço para as lanes
+    std::mutex mLaneLock;
+    std::condition_variable mLaneCv[LANE_COUNT];
+    std::shared_ptr<Op> mAssigned[LANE_COUNT];
+
+    std::thread mLoopThread;
+    std::thread mLaneThreads[LANE_COUNT];
+};
+
+}  // namespace aidl::android::hardware::ir
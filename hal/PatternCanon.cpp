@@ -0,0 +1,71 @@
+#include "PatternCanon.h"
+
+#include <stdlib.h>
+
+namespace aidl::android::hardware::ir {
+
+bool patternsEquivalent(const std::vector<int32_t>& reference,
+                        const std::vector<int32_t>& candidate) {
+    if (reference.size() != candidate.size()) return false;
+
+    int64_t total = 0, drift = 0;
+    for (size_t i = 0; i < reference.size(); i++) {
+        int64_t diff = (int64_t)candidate[i] - reference[i];
+        if (llabs(diff) * 100 > (int64_t)reference[i] * kSliceTolerancePct) return false;
+        total += reference[i];
+        drift += diff;
+    }
+    return llabs(drift) <= kTotalToleranceUs || llabs(drift) * 100 <= total * kTotalTolerancePct;
+}
+
+// Cada fatia vira o múltiplo de kRawTickUs mais próximo (1..255 passos)
+static void quantize(const std::vector<int32_t>& slices, std::vector<uint8_t>* ticks) {
+    ticks->clear();
+    std::vector<int32_t> snapped;
+    snapped.reserve(slices.size());
+    ticks->reserve(slices.size());
+    for (int32_t us : slices) {
+        int32_t q = (us + kRawTickUs / 2) / kRawTickUs;
+        if (q < 1 || q > 255) {
+            ticks->clear();
+            return;
+        }
+        ticks->push_back((uint8_t)q);
+        snapped.push_back(q * kRawTickUs);
+    }
+    if (!patternsEquivalent(slices, snapped)) ticks->clear();
+}
+
+bool canonicalizePattern(const std::vector<int32_t>& pattern, bool trimTrailingGap,
+                         CanonicalPattern* out) {
+    out->slices.clear();
+    out->slices.reserve(pattern.size());
+    out->trailingGapUs = 0;
+    out->rawTicks.clear();
+
+    // A fatia de 0 µs no meio junta as vizinhas, que têm o mesmo nível.
+    // Uma na primeira posição fica: o firmware a recusa como antes.
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] < 0) return false;
+        if (pattern[i] == 0 && !out->slices.empty()) {
+            if (i + 1 < pattern.size()) {
+                if (pattern[i + 1] < 0) return false;
+                out->slices.back() += pattern[++i];
+            }
+            continue;
+        }
+        out->slices.push_back(pattern[i]);
+    }
+
+    // Tamanho par: termina num espaço
+    if (trimTrailingGap && out->slices.size() >= 2 && out->slices.size() % 2 == 0) {
+        out->trailingGapUs = out->slices.back();
+        out->slices.pop_back();
+    }
+    if (out->slices.empty()) return false;
+
+    quantize(out->slices, &out->rawTicks);
+    return true;
+}
+
+}  // namespace aidl::android::hardware::ir
@@ -0,0 +1,51 @@
+/*
+ * Forma canônica dos padrões antes de irem para o driver.
+ *
+ * Os padrões que chegam do ConsumerIrService costumam ter fatias de 0 µs
+ * no meio (duas marcas ou dois espaços seguidos), durações com jitter de
+ * poucos µs e um espaço final que só segura o canal ocupado. A HAL:
+ *
+ *   1. funde as fatias vizinhas do mesmo nível (as de 0 µs somem);
+ *   2. tira o espaço final (no canal 0 a HAL espera por ele depois do TX,
+ *      então o intervalo até o próximo transmit não muda);
+ *   3. tenta quantizar em kRawTickUs, o passo do "RAW @<freqHz> <b,...>"
+ *      do firmware. O RAW só é usado se cada fatia couber em 1..255 passos
+ *      e o resultado for equivalente ao original (patternsEquivalent).
+ *      Senão o padrão vai como TX, com as durações exatas.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace aidl::android::hardware::ir {
+
+// Passo do RAW do firmware (RAW_TICK_US em hardware/lib/ir_core/ir_limits.h)
+static constexpr int32_t kRawTickUs = 50;
+
+// Tolerância da quantização: por fatia e no total do padrão (o maior entre
+// a porcentagem e o piso em µs, para padrões curtos)
+static constexpr int32_t kSliceTolerancePct = 10;
+static constexpr int32_t kTotalTolerancePct = 1;
+static constexpr int32_t kTotalToleranceUs = 100;
+
+struct CanonicalPattern {
+    std::vector<int32_t> slices;     // µs exatos, já fundidos e sem o espaço final
+    int32_t trailingGapUs = 0;       // espaço final retirado
+    std::vector<uint8_t> rawTicks;   // as mesmas fatias em kRawTickUs; vazio = sem RAW
+};
+
+// Falha (e out fica indefinido) se alguma fatia for negativa ou se não
+// sobrar nenhuma marca; nesse caso o padrão segue como veio.
+bool canonicalizePattern(const std::vector<int32_t>& pattern, bool trimTrailingGap,
+                         CanonicalPattern* out);
+
+// true se "candidate" reproduz "reference" fatia a fatia dentro de
+// kSliceTolerancePct e com a duração total dentro de kTotalTolerancePct
+// (ou kTotalToleranceUs).
+bool patternsEquivalent(const std::vector<int32_t>& reference,
+                        const std::vector<int32_t>& candidate);
+
+}  // namespace aidl::android::hardware::ir
@@ -0,0 +1,29 @@
+#define LOG_TAG "ConsumerIrHal"
+
+#include <android/binder_manager.h>
+#include <android/binder_process.h>
+#include <log/log.h>
+
+#include "ConsumerIr.h"
+
+using aidl::android::hardware::ir::ConsumerIr;
+
+// Fixo: as threads do binder só esperam o laço de E/S (IoLoop.h), então não
+// precisam crescer com os clientes
+static constexpr uint32_t kBinderThreads = 4;
+
+int main() {
+    ABinderProcess_setThreadPoolMaxThreadCount(kBinderThreads);
+    ABinderProcess_startThreadPool();
+
+    std::shared_ptr<ConsumerIr> ir = ndk::SharedRefBase::make<ConsumerIr>();
+    const std::string instance = std::string() + ConsumerIr::descriptor + "/default";
+    binder_status_t status = AServiceManager_addService(ir->asBinder().get(), instance.c_str());
+    if (status != STATUS_OK) {
+        ALOGE("Falha ao registrar %s (%d)", instance.c_str(), status);
+        return EXIT_FAILURE;
+    }
+
+    ABinderProcess_joinThreadPool();
+    return EXIT_FAILURE;  // não deveria retornar
+}
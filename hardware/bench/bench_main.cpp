@@ -0,0 +1,176 @@
+// Benchmark do núcleo de comandos no host (pio run -e native).
+//
+// Cada caso alimenta linhas ASCII por irCoreFeed (ou capturas por
+// irCoreRec) como se viessem da UART e mede comandos/s e ns por fatia.
+// Antes de medir, a resposta de uma execução é conferida: um caso que
+// deixe de responder [OK] derruba o benchmark com código de saída 1. Por
+// último, uma rajada de repetições NEC confere que nada vai para a UART.
+//
+// Uso: bench [iteracoes] [-v]   (-v ecoa as respostas da conferência)
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "fw_stats.h"
+#include "ir_core.h"
+#include "ir_upload.h"
+#include "native_port.h"
+
+struct BenchCase {
+  const char* name;
+  std::string line;      // linha enviada (com '\n'); vazia = REC
+  const uint16_t* rec;   // captura para irCoreRec
+  uint16_t slices;
+  const char* expect;    // prefixo esperado da resposta
+};
+
+static std::string pattern(uint16_t n, uint16_t mark, uint16_t space) {
+  std::string s;
+  for (uint16_t i = 0; i < n; i++) {
+    if (i) s += ',';
+    s += std::to_string((i & 1) ? space : mark);
+  }
+  return s;
+}
+
+static std::string rawBytes(uint16_t n) {
+  std::string s = "RAW";
+  for (uint16_t i = 0; i < n; i++) s += (i & 1) ? " 34" : " 0x0B";
+  return s;
+}
+
+// O mesmo padrão na forma compacta que a HAL gera (fatias em RAW_TICK_US)
+static std::string rawAt(uint16_t n, uint16_t mark, uint16_t space) {
+  std::string s = "RAW @38000 180,90";
+  for (uint16_t i = 2; i < n; i++) {
+    s += ',';
+    s += std::to_string(((i & 1) ? space : mark) / RAW_TICK_US);
+  }
+  return s;
+}
+
+// Padrão longo pelo upload em partes, como o driver manda: BEGIN, CHUNKs
+// de até perChunk fatias com o CRC de cada um e o COMMIT com o do todo
+static std::string upload(uint16_t n, uint16_t mark, uint16_t space, uint16_t perChunk) {
+  std::vector<uint16_t> us(n);
+  uint32_t total = 0;
+  for (uint16_t i = 0; i < n; i++) total += us[i] = (i & 1) ? space : mark;
+
+  char buf[64];
+  snprintf(buf, sizeof(buf), "BEGIN 0 38000 %u %lu\n", (unsigned)n, (unsigned long)total);
+  std::string s = buf;
+  for (uint16_t off = 0; off < n; off += perChunk) {
+    uint16_t k = (n - off < perChunk) ? n - off : perChunk;
+    snprintf(buf, sizeof(buf), "CHUNK %u %04x ", (unsigned)off, irCrc16(0xFFFF, &us[off], k));
+    s += buf;
+    for (uint16_t i = 0; i < k; i++) {
+      if (i) s += ',';
+      s += std::to_string(us[off + i]);
+    }
+    s += '\n';
+  }
+  snprintf(buf, sizeof(buf), "COMMIT %04x\n", irCrc16(0xFFFF, us.data(), n));
+  return s + buf;
+}
+
+static void runOnce(const BenchCase& c) {
+  if (c.rec) irCoreRec(c.rec, c.slices);
+  else irCoreFeed((const uint8_t*)c.line.data(), c.line.size());
+}
+
+static bool check(const BenchCase& c) {
+  benchOutClear();
+  runOnce(c);
+  // Casos de várias linhas (upload): nenhuma delas pode ter falhado
+  bool failed = strncmp(c.expect, "[OK]", 4) == 0 && strstr(benchOut, "[ERR]");
+  if (!failed && strncmp(benchOut, c.expect, strlen(c.expect)) == 0) return true;
+  fprintf(stderr, "[FAIL] %s: esperado \"%s\", veio \"%s\"\n", c.name, c.expect, benchOut);
+  return false;
+}
+
+int main(int argc, char** argv) {
+  long iters = 20000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) benchVerbose = true;
+    else iters = strtol(argv[i], nullptr, 10);
+  }
+  if (iters <= 0) iters = 1;
+
+  // NEC 20DF10EF já decodificado (67 fatias) e uma captura que ainda cabe
+  // inteira em IR_REC_BYTES
+  static uint16_t nec[67];
+  static uint16_t longRec[100];
+  nec[0] = 9000; nec[1] = 4500;
+  for (int i = 2; i < 67; i++) nec[i] = (i & 1) ? ((i * 7) % 3 ? 560 : 1690) : 560;
+  for (int i = 0; i < 100; i++) longRec[i] = (i & 1) ? 1690 : 560;
+
+  // A linha ASCII cabe em IR_LINE_BYTES: 100 fatias de "560," ~ 400 bytes
+  const BenchCase cases[] = {
+    { "TX 67",       "TX 38000 9000,4500," + pattern(65, 560, 1690) + "\n", nullptr, 67,  "[OK] TX" },
+    { "TX 100",      "TX 38000:25 " + pattern(100, 560, 1690) + "\n",       nullptr, 100, "[OK] TX" },
+    { "TX @id 67",   "@1a2b3c TX 38000 " + pattern(67, 560, 560) + "\n",    nullptr, 67,  "[OK] TX" },
+    { "TXC 1 67",    "TXC 1 56000 " + pattern(67, 600, 600) + "\n",         nullptr, 67,  "[OK] TXC" },
+    { "RAW 38",      rawBytes(38) + "\n",                                   nullptr, 38,  "[OK] RAW" },
+    { "RAW @ 67",    rawAt(67, 550, 1700) + "\n",                           nullptr, 67,  "[OK] RAW" },
+    { "NEC",         "NEC 20DF10EF\n",                                      nullptr, 67,  "[OK] NEC" },
+    { "REC 67",      "",                                                    nec,     67,  "[OK] REC" },
+    { "REC 100",     "",                                                    longRec, 100, "[OK] REC" },
+    { "TX invalido", "TX 38000 560,0,560\n",                                nullptr, 3,   "[ERR]" },
+    // Ar-condicionado: 600 fatias em CHUNKs de 64; 4096 chega aos 2 s
+    { "UPLOAD 600",  upload(600, 420, 1260, 64),                           nullptr, 600,  "[OK] BEGIN" },
+    { "UPLOAD 4096", upload(4096, 480, 480, 64),                           nullptr, 4096, "[OK] BEGIN" },
+  };
+
+  // Os casos REC medem a montagem da linha: sem agrupamento de repetições
+  static const char noWindow[] = "REC WINDOW 0\n";
+  irCoreFeed((const uint8_t*)noWindow, sizeof(noWindow) - 1);
+
+  bool ok = true;
+  for (const BenchCase& c : cases) ok = check(c) && ok;
+  if (!ok) return 1;
+
+  bool verbose = benchVerbose;
+  benchVerbose = false;
+  statsReset();
+
+  printf("%-12s %10s %12s %10s %10s %6s\n", "caso", "iter", "cmd/s", "ns/cmd", "ns/fatia", "bytes");
+  for (const BenchCase& c : cases) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (long i = 0; i < iters; i++) runOnce(c);
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    double perCmd = ns / iters;
+    printf("%-12s %10ld %12.0f %10.0f %10.1f %6zu\n", c.name, iters, 1e9 / perCmd, perCmd,
+           perCmd / c.slices, c.line.size());
+  }
+  printf("saida=%llu bytes, fatias=%llu\n", (unsigned long long)benchOutBytes,
+         (unsigned long long)benchTxSlices);
+
+  // Botão segurado: um NEC seguido de repetições dentro da janela. Só a
+  // primeira captura gera saída; as demais são contadas na rajada.
+  static const uint16_t necRepeat[3] = { 9000, 2250, 560 };
+  static const char window[] = "REC WINDOW 150\n";
+  irCoreFeed((const uint8_t*)window, sizeof(window) - 1);
+  irCoreRec(nec, 67);
+  uint64_t outBefore = benchOutBytes;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < iters; i++) irCoreRec(necRepeat, 3);
+  auto t1 = std::chrono::steady_clock::now();
+  double perRep = std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+  printf("%-12s %10ld %12.0f %10.0f %10s  saida=%llu bytes\n", "REC repetido", iters, 1e9 / perRep,
+         perRep, "-", (unsigned long long)(benchOutBytes - outBefore));
+  if (benchOutBytes != outBefore) {
+    fprintf(stderr, "[FAIL] REC repetido: repeticoes geraram saida\n");
+    return 1;
+  }
+
+  // Histogramas do próprio firmware para as mesmas execuções
+  if (verbose) {
+    benchVerbose = true;
+    statsPrint();
+  }
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Porta native do núcleo (ir_port.h) para o benchmark: a "UART" só conta
+// bytes (ou ecoa em stdout com benchVerbose), o "RMT" aceita qualquer
+// padrão sem transmitir e o display é descartado.
+#include "native_port.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "ir_port.h"
+
+#define NATIVE_TX_CHANNELS 4
+
+bool benchVerbose = false;
+uint64_t benchOutBytes = 0;
+uint64_t benchTxSlices = 0;
+char benchOut[BENCH_OUT_BYTES];
+
+static size_t benchOutLen = 0;
+
+static uint32_t carrierHz[NATIVE_TX_CHANNELS];
+
+void portWrite(const char* data, size_t len) {
+  benchOutBytes += len;
+  if (benchVerbose) fwrite(data, 1, len, stdout);
+  size_t room = sizeof(benchOut) - 1 - benchOutLen;
+  size_t n = (len < room) ? len : room;
+  memcpy(benchOut + benchOutLen, data, n);
+  benchOutLen += n;
+  benchOut[benchOutLen] = 0;
+}
+
+void benchOutClear() {
+  benchOutLen = 0;
+  benchOut[0] = 0;
+}
+
+int64_t portNowUs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint8_t portTxChannels() {
+  return NATIVE_TX_CHANNELS;
+}
+
+bool portTransmit(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n) {
+  (void)dutyPct; (void)us;
+  if (ch >= NATIVE_TX_CHANNELS) return false;
+  carrierHz[ch] = freqHz;
+  benchTxSlices += n;
+  return true;
+}
+
+// O "RMT" termina na hora e não há console para um ABORT chegar
+bool portTxBusy(uint8_t ch) {
+  (void)ch;
+  return false;
+}
+
+bool portTxLongBusy(uint8_t ch) {
+  (void)ch;
+  return false;
+}
+
+void portTxStop(uint8_t ch) {
+  (void)ch;
+}
+
+// O "timer" dispara na hora marcada: o atraso medido é sempre 0
+static int64_t firedUs[NATIVE_TX_CHANNELS];
+
+bool portTransmitAt(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n,
+                    int64_t atUs) {
+  if (!portTransmit(ch, freqHz, dutyPct, us, n)) return false;
+  firedUs[ch] = atUs;
+  return true;
+}
+
+bool portTxArmed(uint8_t ch) {
+  (void)ch;
+  return false;
+}
+
+int64_t portTxFiredUs(uint8_t ch) {
+  return (ch < NATIVE_TX_CHANNELS) ? firedUs[ch] : 0;
+}
+
+size_t portRead(uint8_t* buf, size_t max) {
+  (void)buf; (void)max;
+  return 0;
+}
+
+uint32_t portCarrierHz(uint8_t ch) {
+  return (ch < NATIVE_TX_CHANNELS) ? carrierHz[ch] : 0;
+}
+
+void portShow(const char* l1, const char* l2, const char* l3, uint16_t packets) {
+  (void)l1; (void)l2; (void)l3; (void)packets;
+}
+
+// Sem receptor no host: a captura contínua não existe aqui
+void portCapStart() {
+  static const char msg[] = "[ERR] CAP indisponivel no native\n";
+  portWrite(msg, sizeof(msg) - 1);
+}
+
+void portCapStop() {
+  portCapStart();
+}
+
+bool portCapActive() {
+  return false;
+}
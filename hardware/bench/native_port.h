@@ -0,0 +1,15 @@
+// Estado observável da porta native (bench/native_port.cpp).
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BENCH_OUT_BYTES 1024
+
+extern bool benchVerbose;        // ecoa a saída da console em stdout
+extern uint64_t benchOutBytes;   // bytes escritos na "UART"
+extern uint64_t benchTxSlices;   // fatias entregues ao "RMT"
+
+// Início da saída desde o último benchOutClear() (truncada, com '\0')
+extern char benchOut[BENCH_OUT_BYTES];
+void benchOutClear();
@@ -0,0 +1,48 @@
+// Motor de transmissão multi-canal (RMT do ESP32).
+//
+// Cada canal tem o próprio pino, a própria portadora e um buffer de itens
+// RMT; os canais transmitem em paralelo e de forma não bloqueante.
+// A portadora é gerada pelo hardware do RMT com período e duty programados
+// em ticks de 12,5 ns (APB 80 MHz), sem arredondar para kHz inteiros.
+// O canal 0 é o IR_SEND_PIN (TX/NEC/RAW).
+#pragma once
+
+#include <stdint.h>
+
+#include "ir_limits.h"   // TX_DEFAULT_DUTY, TX_CARRIER_MIN_HZ/MAX_HZ
+
+#ifndef IR_TX_CHANNELS
+  #define IR_TX_CHANNELS 4   // o ESP32 tem 8 canais RMT
+#endif
+
+// Inicializa um canal RMT por pino (pins[i] -> canal i)
+bool txEngineBegin(const uint8_t* pins, uint8_t count);
+
+uint8_t txEngineChannels();
+
+// Dispara o padrão (µs, on/off alternados) no canal, sem bloquear.
+// Se o canal ainda estiver transmitindo, espera o fim antes de reutilizar o buffer.
+// Padrões maiores que o buffer do canal (upload em partes, até
+// MAX_UPLOAD_COUNT fatias) usam o buffer longo, um canal por vez: se outro
+// canal ainda transmite dele, retorna false sem esperar.
+bool txEngineStart(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n);
+
+// true se o buffer longo está com outro canal, ainda transmitindo
+bool txEngineLongBusy(uint8_t ch);
+
+// Frequência efetivamente gerada no canal (após a quantização em ticks)
+uint32_t txEngineCarrierHz(uint8_t ch);
+
+bool txEngineBusy(uint8_t ch);
+void txEngineWait(uint8_t ch);
+
+// Corta a transmissão em curso no canal (a saída volta para o nível ocioso)
+void txEngineStop(uint8_t ch);
+
+// Arma o padrão para começar quando esp_timer_get_time() chegar a atUs
+// (TX_AT). Os itens são montados já aqui; o disparo vem do esp_timer e não
+// passa pelo loop(). Enquanto armado, txEngineStart recusa o canal.
+bool txEngineStartAt(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n,
+                     int64_t atUs);
+bool txEngineArmed(uint8_t ch);
+int64_t txEngineFiredUs(uint8_t ch);   // início real do último disparo armado
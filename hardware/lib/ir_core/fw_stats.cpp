@@ -0,0 +1,71 @@
+#include "fw_stats.h"
+
+#include <string.h>   // memset
+
+#include "ir_core.h"
+#include "ir_port.h"
+
+struct StageStats {
+  uint32_t count;
+  uint64_t sumUs;
+  uint32_t maxUs;
+  uint32_t hist[STATS_BUCKETS];
+};
+
+static const char* const STAGE_NAMES[STAGE_COUNT] = { "parse", "tx", "nec", "rec", "txat" };
+
+static StageStats stages[STAGE_COUNT];
+static uint32_t counters[CNT_COUNT];
+static int64_t sinceUs = 0;
+
+static inline uint8_t bucketOf(uint32_t us) {
+  if (us == 0) return 0;
+  uint8_t b = 31 - __builtin_clz(us);
+  return (b < STATS_BUCKETS - 1) ? b : STATS_BUCKETS - 1;
+}
+
+void statsRecord(StatStage stage, uint32_t us) {
+  StageStats& s = stages[stage];
+  s.count++;
+  s.sumUs += us;
+  if (us > s.maxUs) s.maxUs = us;
+  s.hist[bucketOf(us)]++;
+}
+
+void statsCount(StatCounter counter, uint32_t n) {
+  counters[counter] += n;
+}
+
+void statsReset() {
+  memset(stages, 0, sizeof(stages));
+  memset(counters, 0, sizeof(counters));
+  sinceUs = portNowUs();
+}
+
+void statsPrint() {
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    const StageStats& s = stages[i];
+    irPrintf("STAT %s n=%lu sum=%llu max=%lu h=", STAGE_NAMES[i], (unsigned long)s.count,
+             (unsigned long long)s.sumUs, (unsigned long)s.maxUs);
+    // Corta as faixas vazias do fim para a linha não crescer à toa
+    int8_t last = STATS_BUCKETS - 1;
+    while (last > 0 && s.hist[last] == 0) last--;
+    for (int8_t b = 0; b <= last; b++) irPrintf(b ? ",%lu" : "%lu", (unsigned long)s.hist[b]);
+    portWrite("\n", 1);
+  }
+  irPrintf("[OK] STATS up=%llu lines=%lu trunc=%lu drop=%lu perr=%lu limit=%lu rep=%lu sleep=%lu slept=%lu"
+           " abort=%lu cut=%lu upl=%lu uerr=%lu\n",
+           (unsigned long long)((portNowUs() - sinceUs) / 1000),
+           (unsigned long)counters[CNT_LINES], (unsigned long)counters[CNT_TRUNCATED],
+           (unsigned long)counters[CNT_DROPPED], (unsigned long)counters[CNT_PARSE_ERR],
+           (unsigned long)counters[CNT_OVER_LIMIT], (unsigned long)counters[CNT_REC_REPEAT],
+           (unsigned long)counters[CNT_SLEEP], (unsigned long)counters[CNT_SLEEP_MS],
+           (unsigned long)counters[CNT_ABORT], (unsigned long)counters[CNT_CUT],
+           (unsigned long)counters[CNT_UPLOAD], (unsigned long)counters[CNT_UPLOAD_ERR]);
+}
+
+StatScope::StatScope(StatStage stage) : stage_(stage), t0_(portNowUs()) {}
+
+StatScope::~StatScope() {
+  statsRecord(stage_, (uint32_t)(portNowUs() - t0_));
+}
@@ -0,0 +1,55 @@
+// Telemetria do firmware: histogramas de latência por etapa e contadores
+// de erro, consultados pelo comando STATS (e zerados por STATS RESET).
+//
+// Cada histograma usa faixas em potência de 2 de µs: a faixa i conta as
+// amostras em [2^i, 2^(i+1)) µs (a faixa 0 inclui o 0) e a última acumula
+// tudo acima. Registrar uma amostra custa poucos ciclos e não aloca.
+#pragma once
+
+#include <stdint.h>
+
+#define STATS_BUCKETS 20   // última faixa: >= 2^19 µs (~0,5 s)
+
+enum StatStage : uint8_t {
+  STAGE_PARSE,   // trim + tokenização em irCoreHandleLine
+  STAGE_TX,      // doTX / doTXC / doRAW (parse do padrão + transmissão)
+  STAGE_NEC,     // doNEC
+  STAGE_REC,     // irCoreRec (montagem da linha REC)
+  STAGE_TXAT,    // TX_AT: atraso do disparo em relação ao instante pedido
+  STAGE_COUNT
+};
+
+enum StatCounter : uint8_t {
+  CNT_LINES,       // linhas ASCII processadas
+  CNT_TRUNCATED,   // linhas maiores que o buffer
+  CNT_DROPPED,     // bytes descartados dessas linhas
+  CNT_PARSE_ERR,   // comando/argumento inválido
+  CNT_OVER_LIMIT,  // padrão acima de MAX_PATTERN_COUNT ou MAX_XMIT_TIME_US
+  CNT_REC_REPEAT,  // capturas agrupadas numa rajada (repetição NEC ou idênticas)
+  CNT_SLEEP,       // entradas em light-sleep (SLEEP)
+  CNT_SLEEP_MS,    // tempo total dormindo (ms)
+  CNT_ABORT,       // linhas ABORT
+  CNT_CUT,         // padrões do canal 0 cortados por um ABORT
+  CNT_UPLOAD,      // padrões montados em partes e transmitidos (COMMIT)
+  CNT_UPLOAD_ERR,  // CHUNK/COMMIT recusados (CRC, offset, incompleto) e montagens expiradas
+  CNT_COUNT
+};
+
+void statsRecord(StatStage stage, uint32_t us);
+void statsCount(StatCounter counter, uint32_t n = 1);
+void statsReset();
+
+// Uma linha "STAT <etapa> n= sum= max= h=..." por etapa e, por fim,
+// "[OK] STATS up= lines= trunc= drop= perr= limit= rep= sleep= slept= abort= cut= upl= uerr="
+// (na console do núcleo).
+void statsPrint();
+
+// Mede o escopo inteiro (inclusive os retornos antecipados por erro).
+class StatScope {
+  public:
+    explicit StatScope(StatStage stage);
+    ~StatScope();
+  private:
+    StatStage stage_;
+    int64_t t0_;
+};
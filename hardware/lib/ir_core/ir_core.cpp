@@ -0,0 +1,877 @@
+#include "ir_core.h"
+
+#include <ctype.h>      // isspace, isxdigit
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>     // strtok, strlen
+#include <strings.h>    // strcasecmp
+
+#include "fw_stats.h"
+#include "ir_macro.h"
+#include "ir_port.h"
+#include "ir_upload.h"
+
+// ====== Estado / buffers ======
+static char asciiBuf[IR_LINE_BYTES];
+static uint16_t asciiLen = 0;
+static uint32_t asciiDropped = 0;     // bytes perdidos da linha atual (buffer cheio)
+static uint16_t packetCount = 0;
+static uint32_t lastFreqHz = 38000;
+static uint8_t lastDutyPct = TX_DEFAULT_DUTY;
+
+// Guarda o último comando recebido em formato REC ...
+static char lastRecLine[IR_REC_BYTES];
+static bool hasLastRec = false;
+
+// Rajada de capturas (botão segurado): a primeira vira o REC e as
+// repetições seguintes só são contadas até a janela expirar.
+#define REC_REF_SLICES 128            // fatias guardadas para comparar capturas
+static uint32_t recWindowUs = IR_REC_WINDOW_MS * 1000UL;   // 0 = sem agrupamento
+static uint16_t recRef[REC_REF_SLICES];
+static uint16_t recRefCount = 0;
+static int64_t recFirstUs = 0, recLastUs = 0;
+static uint16_t recRepeats = 0;       // da rajada corrente (ou da última, se já fechada)
+static bool recBurstOpen = false;
+
+// Id de correlação da linha atual ("@<hex> CMD ..."; 0 = sem id) e o instante
+// em que ela chegou. O [OK] ecoa os dois para o driver alinhar os relógios.
+static uint64_t cmdId = 0;
+static int64_t cmdRxUs = 0;
+
+// "!<CMD>": prioridade interativa. O padrão não é cortado por ABORT e a
+// macro em execução perde o canal 0 para ele.
+static bool cmdPrio = false;
+
+// Console guardada durante a espera do canal 0 (pendScan: início da linha
+// ainda não examinada) e o último corte por ABORT, até o ABORT responder
+static uint8_t pendBuf[IR_PEND_BYTES];
+static uint16_t pendLen = 0, pendScan = 0;
+static bool txCut = false;
+static int64_t txCutAtUs = 0, txCutLatUs = 0;
+
+// TX_AT: instante agendado de cada canal armado (relógio do firmware; 0 = livre)
+static int64_t txAtUs[IR_TX_AT_CHANNELS];
+
+// Light-sleep: limite de ociosidade e a última atividade (byte ou captura)
+static uint32_t sleepMs = 0;
+static int64_t lastActivityUs = 0;
+
+// ====== Saída ======
+void irPrintf(const char* fmt, ...) {
+  char buf[IR_LINE_BYTES + 64];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return;
+  portWrite(buf, ((size_t)n < sizeof(buf)) ? (size_t)n : sizeof(buf) - 1);
+}
+
+void irPrintln(const char* s) {
+  portWrite(s, strlen(s));
+  portWrite("\n", 1);
+}
+
+uint16_t irCorePacketCount() {
+  return packetCount;
+}
+
+// ====== Helpers ======
+static inline void show3(const char* l1, const char* l2 = "", const char* l3 = "") {
+  portShow(l1, l2, l3, packetCount);
+}
+
+static inline void trim(char* s) {
+  int n = strlen(s);
+  while (n > 0 && (s[n-1] == '\r' || s[n-1] == '\n' || isspace((unsigned char)s[n-1]))) s[--n] = 0;
+  int i = 0; while (isspace((unsigned char)s[i])) i++;
+  if (i > 0) memmove(s, s + i, strlen(s + i) + 1);
+}
+
+static inline bool isHexStr(const char* s, int expectLen) {
+  if ((int)strlen(s) != expectLen) return false;
+  for (const char* p = s; *p; ++p) if (!isxdigit((unsigned char)*p)) return false;
+  return true;
+}
+
+static void help() {
+  irPrintln("IR ASCII cmds:");
+  irPrintln("  NEC <HEX8>                  e.g. NEC 20DF10EF");
+  irPrintln("  TX <freqHz> <us,...>        e.g. TX 38000 9000,4500,560,560,560,560");
+  irPrintln("  TX <freqHz>:<duty%> <us,...> e.g. TX 455000:25 ...  (duty padrao 33%)");
+  irPrintln("  RAW <b b b>                 e.g. RAW 10 20 30 40  (each * 50us)");
+  irPrintln("  RAW @<freqHz> <b,b,...>     e.g. RAW @38000 180,90,11,11  (portadora explicita)");
+  irPrintln("  TXC <ch> <freqHz>[:duty] <us,...> e.g. TXC 1 38000 9000,4500,560,560");
+  irPrintln("  CHANNELS                    numero de canais de TX");
+  irPrintln("  CAPS                        capacidades (portadora, limites, canais)");
+  irPrintln("  CAP START | CAP STOP        stream binario de marcas/espacos");
+  irPrintln("  STATS | STATS RESET         latencias e contadores de erro");
+  irPrintln("  REC WINDOW [ms]             agrupa repeticoes do botao segurado (0 desliga)");
+  irPrintln("  SLEEP [ms]                  light-sleep apos ms ocioso (0 desliga)");
+  irPrintln("  ABORT                       corta o TX do canal 0 no proximo espaco longo e cancela a macro");
+  irPrintln("  !<cmd>                      TX interativo: nao e cortado e interrompe a macro");
+  irPrintln("  SYNC                        relogio do firmware (rx/tx em us) para o driver");
+  irPrintln("  TX_AT <us> <ch> <freqHz>[:duty] <us,...>  dispara no instante dado do relogio");
+  irPrintln("  BEGIN <ch> <freqHz>[:duty] <n> <totalUs>  abre um padrao longo (ate 4096 fatias)");
+  irPrintln("  CHUNK <off> <crc> <us,...>  fatias a partir de off (crc16 em hex)");
+  irPrintln("  COMMIT <crc>                confere o padrao montado e transmite");
+  irPrintln("  MACRO NEW <nome>            macro vazia (ou redefine)");
+  irPrintln("  MACRO ADD <nome> TX|TXC|NEC|WAIT ...  e.g. MACRO ADD tv WAIT 300000");
+  irPrintln("  MACRO RUN <nome> | MACRO CANCEL | MACRO DEL <nome>");
+  irPrintln("  MACRO STATUS | MACRO LIST");
+}
+
+// Fecha a linha de [OK]; com id, acrescenta " id=<hex> rx=<µs> done=<µs>"
+void irAckEnd() {
+  if (cmdId) {
+    irPrintf(" id=%llx rx=%lld done=%lld", (unsigned long long)cmdId,
+             (long long)cmdRxUs, (long long)portNowUs());
+  }
+  portWrite("\n", 1);
+}
+
+// [ERR] de comando/argumento inválido, contado no STATS
+void irParseError(const char* msg) {
+  statsCount(CNT_PARSE_ERR);
+  irPrintln(msg);
+}
+
+// [ERR] de padrão acima dos limites de segurança
+static void overLimit(const char* msg) {
+  statsCount(CNT_OVER_LIMIT);
+  irPrintln(msg);
+}
+
+// ====== Execução dos comandos ======
+// "[@<hex>] ABORT", com espaços em volta
+static bool isAbortLine(const uint8_t* s, size_t n) {
+  char line[32];
+  if (n >= sizeof(line)) return false;
+  memcpy(line, s, n);
+  line[n] = 0;
+  trim(line);
+  char* cmd = line;
+  if (*cmd == '@') {
+    cmd = strchr(cmd, ' ');
+    if (!cmd) return false;
+    while (isspace((unsigned char)*cmd)) cmd++;
+  }
+  return strcasecmp(cmd, "ABORT") == 0;
+}
+
+// Guarda o que chegou pela console; true se chegou uma linha ABORT
+static bool pollAbort() {
+  if (pendLen < sizeof(pendBuf)) pendLen += portRead(pendBuf + pendLen, sizeof(pendBuf) - pendLen);
+  bool found = false;
+  for (uint16_t i = pendScan; i < pendLen; i++) {
+    if (pendBuf[i] != '\n') continue;
+    if (isAbortLine(pendBuf + pendScan, i - pendScan)) found = true;
+    pendScan = i + 1;
+  }
+  return found;
+}
+
+// Processa os bytes guardados durante a espera do canal 0. Só o chamador
+// mais externo esvazia: os comandos reprocessados podem guardar mais.
+static void drainPending() {
+  static bool draining = false;
+  if (draining) return;
+  draining = true;
+  while (pendLen) {
+    uint8_t buf[IR_PEND_BYTES];
+    uint16_t n = pendLen;
+    memcpy(buf, pendBuf, n);
+    pendLen = pendScan = 0;
+    irCoreFeed(buf, n);
+  }
+  draining = false;
+}
+
+// Próximo corte seguro a partir de elapsed (µs desde o início): depois de
+// IR_FRAME_GAP_US dentro de um espaço longo, ou -1 se não há nenhum à frente
+static int64_t frameBoundary(const uint16_t* us, uint16_t n, int64_t elapsed) {
+  int64_t t = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    if ((i & 1) && us[i] >= IR_FRAME_GAP_US && elapsed < t + us[i]) {
+      return (elapsed > t + IR_FRAME_GAP_US) ? elapsed : t + IR_FRAME_GAP_US;
+    }
+    t += us[i];
+  }
+  return -1;
+}
+
+bool irCoreWaitCh0(const uint16_t* us, uint16_t n, bool cuttable) {
+  int64_t t0 = portNowUs();
+  int64_t seenUs = 0, cutUs = -1;     // relativos a t0
+  while (portTxBusy(0)) {
+    int64_t now = portNowUs() - t0;
+    if (pollAbort() && cuttable && cutUs < 0) {
+      seenUs = now;
+      cutUs = frameBoundary(us, n, now);
+      if (cutUs < 0) cuttable = false;   // sem fronteira: vai até o fim
+    }
+    if (cutUs >= 0 && now >= cutUs) {
+      portTxStop(0);
+      txCut = true;
+      txCutAtUs = now;
+      txCutLatUs = now - seenUs;
+      statsCount(CNT_CUT);
+      return false;
+    }
+  }
+  return true;
+}
+
+// portTransmit recusou: um padrão longo com o buffer longo em uso por
+// outro canal não espera (o loop ficaria até 2 s sem ABORT/SYNC/TX_AT)
+static void txFailed(uint8_t ch) {
+  irPrintln(portTxLongBusy(ch) ? "[ERR] buffer longo ocupado" : "[ERR] falha no canal RMT");
+}
+
+// Canal 0: bloqueia até o fim do padrão, como o TX sempre fez. Em falha
+// (RMT ou corte por ABORT) o [ERR] já sai daqui.
+static bool sendCh0(uint32_t freqHz, uint8_t dutyPct, const uint16_t* raw, uint16_t count) {
+  if (!portTransmit(0, freqHz, dutyPct, raw, count)) {
+    txFailed(0);
+    return false;
+  }
+  if (!irCoreWaitCh0(raw, count, !cmdPrio)) {
+    irPrintf("[ERR] abortado at=%lld\n", (long long)txCutAtUs);
+    return false;
+  }
+  return true;
+}
+
+// NEC em fatias: líder 9000/4500, 32 bits MSB primeiro (560 + 560/1690) e
+// marca final de 560 µs, a 38 kHz.
+uint16_t irBuildNEC(uint32_t code, uint16_t* raw) {
+  uint16_t n = 0;
+  raw[n++] = 9000; raw[n++] = 4500;
+  for (int b = 31; b >= 0; b--) {
+    raw[n++] = 560;
+    raw[n++] = ((code >> b) & 1) ? 1690 : 560;
+  }
+  raw[n++] = 560;
+  return n;
+}
+
+bool irParseNEC(const char* hex8, uint32_t* code) {
+  if (!isHexStr(hex8, 8)) { irParseError("[ERR] use: NEC 20DF10EF"); return false; }
+  *code = (uint32_t)strtoul(hex8, nullptr, 16);
+  return true;
+}
+
+static void doNEC(const char* hex8) {
+  StatScope st(STAGE_NEC);
+  uint32_t code;
+  if (!irParseNEC(hex8, &code)) return;
+  static uint16_t nec[NEC_SLICES];
+  uint16_t count = irBuildNEC(code, nec);
+  if (!sendCh0(38000, TX_DEFAULT_DUTY, nec, count)) return;
+  packetCount++;
+  show3("NEC", hex8, "enviado");
+  irPrintf("[OK] NEC 0x%s", hex8);
+  irAckEnd();
+}
+
+// Converte "9000,4500,560,..." em fatias (µs). Imprime o [ERR] e retorna 0
+// se o padrão for inválido.
+uint16_t irParsePattern(char* listStr, uint16_t* raw) {
+  uint16_t count = 0;
+  uint32_t totalUs = 0;
+
+  char* tok = strtok(listStr, ",");
+  for (; tok && count < MAX_PATTERN_COUNT; tok = strtok(nullptr, ",")) {
+    while (*tok && isspace((unsigned char)*tok)) tok++;
+    uint32_t us = strtoul(tok, nullptr, 10);
+    if (us == 0) { irParseError("[ERR] duracao <= 0"); return 0; }
+    raw[count++] = (uint16_t) us;
+    totalUs += us;
+  }
+  // Antes as fatias excedentes eram descartadas em silêncio
+  if (tok) { overLimit("[ERR] pattern com fatias demais"); return 0; }
+  if (count == 0) { irParseError("[ERR] pattern vazio"); return 0; }
+  if (totalUs > MAX_XMIT_TIME_US) { overLimit("[ERR] pattern muito longo"); return 0; }
+  return count;
+}
+
+// Converte "<freqHz>" ou "<freqHz>:<duty%>". Imprime o [ERR] e retorna
+// false se a portadora estiver fora da faixa do RMT.
+bool irParseCarrier(const char* s, uint32_t* freqHz, uint8_t* dutyPct) {
+  char* end = nullptr;
+  *freqHz = strtoul(s, &end, 10);
+  *dutyPct = TX_DEFAULT_DUTY;
+  if (*freqHz < TX_CARRIER_MIN_HZ || *freqHz > TX_CARRIER_MAX_HZ) {
+    irParseError("[ERR] freqHz invalida"); return false;
+  }
+  if (end && *end == ':') {
+    uint32_t d = strtoul(end + 1, nullptr, 10);
+    if (d == 0 || d >= 100) { irParseError("[ERR] duty invalido (1-99)"); return false; }
+    *dutyPct = (uint8_t)d;
+  }
+  return true;
+}
+
+static void doTX(char* freqStr, char* listStr) {
+  StatScope st(STAGE_TX);
+  if (!freqStr || !listStr) { irParseError("[ERR] use: TX <freqHz> <us,us,...>"); return; }
+  uint32_t freqHz; uint8_t dutyPct;
+  if (!irParseCarrier(freqStr, &freqHz, &dutyPct)) return;
+
+  static uint16_t raw[MAX_PATTERN_COUNT];
+  uint16_t count = irParsePattern(listStr, raw);
+  if (count == 0) return;
+
+  if (!sendCh0(freqHz, dutyPct, raw, count)) return;
+
+  lastFreqHz = freqHz;
+  lastDutyPct = dutyPct;
+  packetCount++;
+
+  char fbuf[28]; snprintf(fbuf, sizeof(fbuf), "f=%lu Hz", (unsigned long)freqHz);
+  char cbuf[28]; snprintf(cbuf, sizeof(cbuf), "n=%u slices", count);
+  show3("TRANSMIT", fbuf, cbuf);
+  irPrintf("[OK] TX f=%lu Hz, n=%u, real=%lu Hz, duty=%u%%", (unsigned long)freqHz, count,
+           (unsigned long)portCarrierHz(0), (unsigned)dutyPct);
+  irAckEnd();
+}
+
+// TXC <ch> <freqHz>[:duty] <us,...>: canal 0 bloqueia como o TX; nos demais
+// o motor RMT dispara e o [OK] volta logo, permitindo zonas em paralelo.
+static void doTXC(char* chStr, char* freqStr, char* listStr) {
+  StatScope st(STAGE_TX);
+  if (!chStr || !freqStr || !listStr) { irParseError("[ERR] use: TXC <ch> <freqHz> <us,us,...>"); return; }
+  uint32_t ch = strtoul(chStr, nullptr, 10);
+  if (ch >= portTxChannels()) { irParseError("[ERR] canal invalido"); return; }
+  uint32_t freqHz; uint8_t dutyPct;
+  if (!irParseCarrier(freqStr, &freqHz, &dutyPct)) return;
+
+  // O motor converte as fatias em itens RMT no start: um único buffer basta
+  static uint16_t raw[MAX_PATTERN_COUNT];
+  uint16_t count = irParsePattern(listStr, raw);
+  if (count == 0) return;
+
+  if (ch == 0) {
+    if (!sendCh0(freqHz, dutyPct, raw, count)) return;
+  } else if (!portTransmit((uint8_t)ch, freqHz, dutyPct, raw, count)) {
+    irPrintln("[ERR] falha no canal RMT");
+    return;
+  }
+  if (ch == 0) { lastFreqHz = freqHz; lastDutyPct = dutyPct; }
+  packetCount++;
+
+  char tbuf[28]; snprintf(tbuf, sizeof(tbuf), "TRANSMIT ch%lu", (unsigned long)ch);
+  char fbuf[28]; snprintf(fbuf, sizeof(fbuf), "f=%lu Hz", (unsigned long)freqHz);
+  char cbuf[28]; snprintf(cbuf, sizeof(cbuf), "n=%u slices", count);
+  show3(tbuf, fbuf, cbuf);
+  irPrintf("[OK] TXC ch=%lu f=%lu Hz, n=%u", (unsigned long)ch, (unsigned long)freqHz, count);
+  irAckEnd();
+}
+
+// Disparos do TX_AT que já aconteceram: libera o canal e registra o atraso
+// em relação ao instante pedido (STAT txat)
+static void pollTxAt() {
+  for (uint8_t ch = 0; ch < IR_TX_AT_CHANNELS; ch++) {
+    if (!txAtUs[ch] || portTxArmed(ch)) continue;
+    int64_t late = portTxFiredUs(ch) - txAtUs[ch];
+    statsRecord(STAGE_TXAT, (late > 0) ? (uint32_t)late : 0);
+    txAtUs[ch] = 0;
+  }
+}
+
+// TX_AT <us> <ch> <freqHz>[:duty] <us,...>: o [OK] sai assim que o padrão
+// está armado; o disparo fica com o timer da porta. Várias placas com o
+// mesmo instante (convertido pelo driver de cada uma) saem juntas.
+static void doTxAt(char* atStr, char* chStr, char* freqStr, char* listStr) {
+  StatScope st(STAGE_TX);
+  if (!atStr || !chStr || !freqStr || !listStr) {
+    irParseError("[ERR] use: TX_AT <us> <ch> <freqHz> <us,us,...>"); return;
+  }
+  char* end = nullptr;
+  int64_t atUs = strtoll(atStr, &end, 10);
+  if (end == atStr || *end || atUs <= 0) { irParseError("[ERR] TX_AT: instante invalido"); return; }
+  uint32_t ch = strtoul(chStr, nullptr, 10);
+  if (ch >= portTxChannels() || ch >= IR_TX_AT_CHANNELS) { irParseError("[ERR] canal invalido"); return; }
+  pollTxAt();
+  if (txAtUs[ch]) { irPrintln("[ERR] TX_AT pendente no canal"); return; }
+  uint32_t freqHz; uint8_t dutyPct;
+  if (!irParseCarrier(freqStr, &freqHz, &dutyPct)) return;
+
+  static uint16_t raw[MAX_PATTERN_COUNT];
+  uint16_t count = irParsePattern(listStr, raw);
+  if (count == 0) return;
+
+  // O now= no [ERR] deixa o driver ver que a sincronização envelheceu
+  int64_t now = portNowUs();
+  if (atUs - now < IR_TX_AT_MIN_LEAD_US) { irPrintf("[ERR] TX_AT atrasado now=%lld\n", (long long)now); return; }
+  if (atUs - now > IR_TX_AT_MAX_LEAD_US) { irPrintf("[ERR] TX_AT longe demais now=%lld\n", (long long)now); return; }
+  if (!portTransmitAt((uint8_t)ch, freqHz, dutyPct, raw, count, atUs)) {
+    irPrintln("[ERR] falha no canal RMT");
+    return;
+  }
+  txAtUs[ch] = atUs;
+  if (ch == 0) { lastFreqHz = freqHz; lastDutyPct = dutyPct; }
+  packetCount++;
+
+  char tbuf[28]; snprintf(tbuf, sizeof(tbuf), "TX_AT ch%lu", (unsigned long)ch);
+  char fbuf[28]; snprintf(fbuf, sizeof(fbuf), "f=%lu Hz", (unsigned long)freqHz);
+  char lbuf[28]; snprintf(lbuf, sizeof(lbuf), "em %lld ms", (long long)((atUs - now) / 1000));
+  show3(tbuf, fbuf, lbuf);
+  irPrintf("[OK] TX_AT ch=%lu at=%lld lead=%lld", (unsigned long)ch, (long long)atUs, (long long)(atUs - now));
+  irAckEnd();
+}
+
+// COMMIT <crc>: transmite o padrão montado por BEGIN/CHUNK no canal do
+// BEGIN, como um TXC (o canal 0 bloqueia e aceita o ABORT, como o TX)
+static void doCommit(int argc, char** argv) {
+  StatScope st(STAGE_TX);
+  IrUpload up;
+  if (!irUploadCommit(argc, argv, &up)) return;
+  if (up.ch < IR_TX_AT_CHANNELS) {
+    pollTxAt();
+    if (txAtUs[up.ch]) { irPrintln("[ERR] TX_AT pendente no canal"); return; }
+  }
+
+  if (up.ch == 0) {
+    if (!sendCh0(up.freqHz, up.dutyPct, up.us, up.n)) return;
+    lastFreqHz = up.freqHz;
+    lastDutyPct = up.dutyPct;
+  } else if (!portTransmit(up.ch, up.freqHz, up.dutyPct, up.us, up.n)) {
+    txFailed(up.ch);
+    return;
+  }
+  packetCount++;
+  statsCount(CNT_UPLOAD);
+
+  char tbuf[28]; snprintf(tbuf, sizeof(tbuf), "UPLOAD ch%u", (unsigned)up.ch);
+  char fbuf[28]; snprintf(fbuf, sizeof(fbuf), "f=%lu Hz", (unsigned long)up.freqHz);
+  char cbuf[28]; snprintf(cbuf, sizeof(cbuf), "n=%u slices", (unsigned)up.n);
+  show3(tbuf, fbuf, cbuf);
+  irPrintf("[OK] COMMIT ch=%u f=%lu Hz, n=%u", (unsigned)up.ch, (unsigned long)up.freqHz, (unsigned)up.n);
+  irAckEnd();
+}
+
+// SYNC: relógio do firmware na chegada da linha e logo antes da resposta.
+// O driver troca vários e fica com o de menor ida e volta (offset e deriva).
+static void doSync() {
+  irPrintf("[OK] SYNC rx=%lld tx=%lld\n", (long long)cmdRxUs, (long long)portNowUs());
+}
+
+// RAW @<freqHz>[:duty] <b,b,...>: forma compacta gerada pela HAL. Cada
+// byte (1..255) vale RAW_TICK_US; a portadora vai junto e vira a do RAW.
+static uint16_t parseRawList(const char* s, uint16_t* raw, uint32_t* totalUs) {
+  uint16_t n = 0;
+  *totalUs = 0;
+  while (*s) {
+    char* end = nullptr;
+    unsigned long v = strtoul(s, &end, 10);
+    if (end == s || v == 0 || v > 255 || (*end && *end != ',')) {
+      irParseError("[ERR] RAW: byte invalido (1-255)");
+      return 0;
+    }
+    if (n >= MAX_PATTERN_COUNT) { overLimit("[ERR] pattern com fatias demais"); return 0; }
+    raw[n++] = (uint16_t)(v * RAW_TICK_US);
+    *totalUs += raw[n - 1];
+    s = *end ? end + 1 : end;
+  }
+  if (n == 0) irParseError("[ERR] RAW vazio");
+  return n;
+}
+
+static void doRAW(int argc, char** argv) {
+  StatScope st(STAGE_TX);
+  // RAW 10 20 30 40  (cada valor vira 50us)
+  if (argc <= 1) { irParseError("[ERR] use: RAW <b b b>"); return; }
+  static uint16_t raw[MAX_PATTERN_COUNT];
+  uint16_t n = 0; uint32_t totalUs = 0;
+  // Sem "@<freqHz>": mesma portadora (Hz e duty) do último TX no canal 0
+  uint32_t freqHz = lastFreqHz;
+  uint8_t dutyPct = lastDutyPct;
+
+  if (argv[1][0] == '@') {
+    if (argc != 3) { irParseError("[ERR] use: RAW @<freqHz> <b,b,...>"); return; }
+    if (!irParseCarrier(argv[1] + 1, &freqHz, &dutyPct)) return;
+    n = parseRawList(argv[2], raw, &totalUs);
+    if (n == 0) return;
+  } else {
+    for (int i = 1; i < argc && n < MAX_PATTERN_COUNT; i++) {
+      // aceita decimal ou hex (0x.. ou sem 0x)
+      uint32_t v = 0;
+      if (strncasecmp(argv[i], "0x", 2) == 0) v = strtoul(argv[i] + 2, nullptr, 16);
+      else v = strtoul(argv[i], nullptr, 0);
+      if (v > 255) v = 255;
+      raw[n++] = (uint16_t)(v * RAW_TICK_US);
+      totalUs += raw[n-1];
+    }
+    if (n == 0) { irParseError("[ERR] RAW vazio"); return; }
+  }
+  if (totalUs > MAX_XMIT_TIME_US) { overLimit("[ERR] pattern muito longo"); return; }
+
+  if (!sendCh0(freqHz, dutyPct, raw, n)) return;
+
+  lastFreqHz = freqHz;
+  lastDutyPct = dutyPct;
+  packetCount++;
+  char cbuf[16]; snprintf(cbuf, sizeof(cbuf), "n=%u", n);
+  show3("RAW", cbuf, "enviado");
+  irPrintf("[OK] RAW n=%u", n);
+  irAckEnd();
+}
+
+// Duração dentro da tolerância do receptor (25% + 100 µs)
+static inline bool nearUs(uint16_t v, uint16_t ref) {
+  uint16_t d = (v > ref) ? v - ref : ref - v;
+  return d <= ref / 4 + 100;
+}
+
+// Quadro de repetição NEC: 9000 de marca, 2250 de espaço e a marca final
+static bool isNecRepeat(const uint16_t* us, uint16_t count) {
+  return count == 3 && nearUs(us[0], 9000) && nearUs(us[1], 2250) && nearUs(us[2], 560);
+}
+
+static bool sameAsRef(const uint16_t* us, uint16_t count) {
+  if (count == 0 || count != recRefCount) return false;
+  for (uint16_t i = 0; i < count; i++) if (!nearUs(us[i], recRef[i])) return false;
+  return true;
+}
+
+// Fecha a rajada: uma linha e um redesenho do display por botão segurado
+static void recBurstEnd() {
+  recBurstOpen = false;
+  if (recRepeats == 0) return;
+  char rbuf[30]; snprintf(rbuf, sizeof(rbuf), "rep=%u", (unsigned)recRepeats);
+  char tbuf[30]; snprintf(tbuf, sizeof(tbuf), "%lu ms", (unsigned long)((recLastUs - recFirstUs) / 1000));
+  show3("RECEBIDO", rbuf, tbuf);
+  irPrintf("[OK] REC repeat n=%u us=%lld\n", (unsigned)recRepeats, (long long)(recLastUs - recFirstUs));
+}
+
+bool irCoreRec(const uint16_t* us, uint16_t count) {
+  StatScope st(STAGE_REC);
+  int64_t now = portNowUs();
+  lastActivityUs = now;
+
+  // Mesmo botão ainda pressionado: só estende a rajada
+  if (recBurstOpen && (uint64_t)(now - recLastUs) <= recWindowUs &&
+      (isNecRepeat(us, count) || sameAsRef(us, count))) {
+    recRepeats++;
+    recLastUs = now;
+    statsCount(CNT_REC_REPEAT);
+    return false;
+  }
+  if (recBurstOpen) recBurstEnd();
+
+  // Use last used transmit frequency as fallback for display and REC output.
+  uint32_t freq = lastFreqHz;  // Hz (fallback)
+
+  // Monta a linha no formato: REC <freq> 9000,4500,560,560,...
+  int n = snprintf(lastRecLine, sizeof(lastRecLine), "REC %lu ", (unsigned long)freq);
+
+  for (uint16_t i = 0; i < count && n < (int)sizeof(lastRecLine) - 1; i++) {
+    int wrote = snprintf(lastRecLine + n, sizeof(lastRecLine) - n,
+                         (i + 1 < count) ? "%u," : "%u", (unsigned)us[i]);
+    if (wrote < 0 || wrote >= (int)(sizeof(lastRecLine) - n)) break;
+    n += wrote;
+  }
+
+  hasLastRec = true;
+  packetCount++;
+
+  // Feedback no display
+  char fbuf[30]; snprintf(fbuf, sizeof(fbuf), "f=%lu", (unsigned long)freq);
+  char cbuf[30]; snprintf(cbuf, sizeof(cbuf), "n=%u", (unsigned)count);
+  show3("RECEBIDO", fbuf, cbuf);
+
+  irPrintln("[OK] REC armazenado. Use LAST_REC para ver.");
+
+  // Abre a rajada com esta captura como referência
+  recRepeats = 0;
+  recFirstUs = recLastUs = now;
+  recRefCount = (count <= REC_REF_SLICES) ? count : 0;
+  memcpy(recRef, us, recRefCount * sizeof(us[0]));
+  recBurstOpen = recWindowUs > 0;
+  return true;
+}
+
+static void doPrintLastReceived() {
+  if (!hasLastRec) {
+    irPrintln("[ERR] nenhum REC armazenado ainda");
+    return;
+  }
+  // Botão segurado: as repetições vão no fim, depois das fatias
+  if (recRepeats) {
+    irPrintf("%s rep=%u hold=%lld\n", lastRecLine, (unsigned)recRepeats,
+             (long long)(recLastUs - recFirstUs));
+    return;
+  }
+  irPrintln(lastRecLine);
+}
+
+// REC WINDOW [<ms>]: janela de agrupamento das repetições (0 desliga)
+static void doRecWindow(int argc, char** argv) {
+  if (argc >= 3) {
+    char* end = nullptr;
+    unsigned long ms = strtoul(argv[2], &end, 10);
+    if (!end || *end || ms > IR_REC_WINDOW_MAX_MS) { irParseError("[ERR] use: REC WINDOW <0-2000 ms>"); return; }
+    if (recBurstOpen) recBurstEnd();
+    recWindowUs = ms * 1000UL;
+  }
+  irPrintf("[OK] REC WINDOW ms=%lu\n", (unsigned long)(recWindowUs / 1000));
+}
+
+// SLEEP [<ms>]: ociosidade antes do light-sleep (0 desliga)
+static void doSleep(int argc, char** argv) {
+  if (argc >= 2) {
+    char* end = nullptr;
+    unsigned long ms = strtoul(argv[1], &end, 10);
+    if (!end || *end || ms > IR_SLEEP_MAX_MS) { irParseError("[ERR] use: SLEEP <0-600000 ms>"); return; }
+    sleepMs = ms;
+  }
+  irPrintf("[OK] SLEEP ms=%lu\n", (unsigned long)sleepMs);
+}
+
+bool irCoreCanSleep() {
+  if (!sleepMs || asciiLen || recBurstOpen || irMacroRunning() || portCapActive() || irUploadOpen()) {
+    return false;
+  }
+  // O timer do TX_AT não acorda o chip
+  for (uint8_t ch = 0; ch < IR_TX_AT_CHANNELS; ch++) if (txAtUs[ch]) return false;
+  return (uint64_t)(portNowUs() - lastActivityUs) >= (uint64_t)sleepMs * 1000ULL;
+}
+
+void irCoreWoke(uint32_t sleptUs) {
+  asciiLen = 0;
+  asciiDropped = 0;
+  lastActivityUs = portNowUs();
+  statsCount(CNT_SLEEP);
+  statsCount(CNT_SLEEP_MS, sleptUs / 1000);
+}
+
+// ABORT: o corte do canal 0 já aconteceu na espera do TX de fundo (a linha
+// é reprocessada depois dele); aqui só a macro é cancelada e a montagem de
+// fundo em aberto é descartada. O resultado vai na resposta: tx=1 com o
+// ponto do corte e a latência desde o ABORT, upload=1 se havia montagem.
+static void doAbort() {
+  bool macro = irMacroRunning();
+  statsCount(CNT_ABORT);
+  if (macro) irMacroPreempt();
+  bool upload = irUploadAbort();
+  irPrintf("[OK] ABORT tx=%d macro=%d", txCut ? 1 : 0, macro ? 1 : 0);
+  if (txCut) irPrintf(" at=%lld lat=%lld", (long long)txCutAtUs, (long long)txCutLatUs);
+  if (upload) irPrintf(" upload=1");
+  txCut = false;
+  irAckEnd();
+}
+
+// Capacidades reais do firmware, numa linha "chave=valor" para o driver
+// consultar uma única vez no probe. A faixa de portadora é a do gerador
+// do RMT (período em ticks de 12,5 ns, registradores de 16 bits).
+static void doCAPS() {
+  irPrintf("[OK] CAPS fmin=%lu fmax=%lu slices=%u maxus=%lu ch=%u proto=NEC,TX,TXC,RAW,RAW@,CAP,MACRO,SLEEP,ABORT,SYNC,TX_AT,UPLOAD"
+           " line=%u rec=%u macros=%u steps=%u pool=%u upload=%u\n",
+           TX_CARRIER_MIN_HZ, TX_CARRIER_MAX_HZ, (unsigned)MAX_PATTERN_COUNT, (unsigned long)MAX_XMIT_TIME_US,
+           (unsigned)portTxChannels(), (unsigned)sizeof(asciiBuf), (unsigned)sizeof(lastRecLine),
+           (unsigned)MACRO_MAX, (unsigned)MACRO_MAX_STEPS, (unsigned)MACRO_POOL_SLICES,
+           (unsigned)MAX_UPLOAD_COUNT);
+}
+
+// ====== Parser de linha ASCII ======
+void irCoreHandleLine(char* line) {
+  char* argv[40] = {0};
+  int argc = 0;
+  cmdRxUs = portNowUs();
+  cmdId = 0;
+  cmdPrio = false;
+  {
+    StatScope st(STAGE_PARSE);
+    trim(line);
+    if (!*line) return;
+    statsCount(CNT_LINES);
+
+    // tokenização simples
+    for (char* p = strtok(line, " "); p && argc < 40; p = strtok(nullptr, " ")) {
+      argv[argc++] = p;
+    }
+  }
+  // "@<hex>" na frente: id de correlação vindo do driver
+  if (argc > 0 && argv[0][0] == '@') {
+    cmdId = strtoull(argv[0] + 1, nullptr, 16);
+    for (int i = 1; i < argc; i++) argv[i - 1] = argv[i];
+    argv[--argc] = nullptr;
+  }
+  if (argc == 0) return;
+  if (argv[0][0] == '!') {
+    cmdPrio = true;
+    argv[0]++;
+  }
+
+  // O canal 0 (e a captura, que o desliga) é da macro até ela terminar,
+  // a não ser que um TX interativo a interrompa
+  bool txCmd = strcasecmp(argv[0], "TX") == 0 || strcasecmp(argv[0], "TRANSMIT") == 0 ||
+               strcasecmp(argv[0], "TXC") == 0 || strcasecmp(argv[0], "NEC") == 0 ||
+               strcasecmp(argv[0], "RAW") == 0 || strcasecmp(argv[0], "TX_AT") == 0 ||
+               strcasecmp(argv[0], "BEGIN") == 0 || strcasecmp(argv[0], "COMMIT") == 0 ||
+               (strcasecmp(argv[0], "CAP") == 0 && argc >= 2 && strcasecmp(argv[1], "START") == 0);
+  if (txCmd && irMacroRunning()) {
+    if (!cmdPrio || strcasecmp(argv[0], "CAP") == 0) { irPrintln("[ERR] macro em execucao"); return; }
+    irMacroPreempt();
+  }
+
+  // Canal com TX_AT armado: os itens dele ficam no RMT até o disparo
+  // (o próprio TX_AT confere o canal dele, e o COMMIT o do BEGIN)
+  int txCh = -1;
+  if (txCmd && strcasecmp(argv[0], "TX_AT") != 0 && strcasecmp(argv[0], "COMMIT") != 0) {
+    bool explicitCh = strcasecmp(argv[0], "TXC") == 0 || strcasecmp(argv[0], "BEGIN") == 0;
+    txCh = (explicitCh && argc >= 2) ? atoi(argv[1]) : 0;
+  } else if (strcasecmp(argv[0], "MACRO") == 0 && argc >= 2 && strcasecmp(argv[1], "RUN") == 0) {
+    txCh = 0;
+  }
+  if (txCh >= 0 && txCh < IR_TX_AT_CHANNELS) {
+    pollTxAt();
+    if (txAtUs[txCh]) { irPrintln("[ERR] TX_AT pendente no canal"); return; }
+  }
+
+  if (strcasecmp(argv[0], "CAP") == 0) {
+    if (argc >= 2 && strcasecmp(argv[1], "START") == 0) { portCapStart(); return; }
+    if (argc >= 2 && strcasecmp(argv[1], "STOP") == 0)  { portCapStop();  return; }
+    irParseError("[ERR] use: CAP START | CAP STOP");
+    return;
+  }
+
+  // Durante a sessão a UART carrega o stream binário; só CAP STOP é aceito
+  if (portCapActive()) { irPrintln("[ERR] sessao de captura ativa"); return; }
+
+  if (strcasecmp(argv[0], "NEC") == 0) {
+    if (argc < 2) { irParseError("[ERR] use: NEC <HEX8>"); return; }
+    doNEC(argv[1]);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "TX") == 0 || strcasecmp(argv[0], "TRANSMIT") == 0) {
+    if (argc < 3) {
+      irParseError("[ERR] use: TX <freqHz> <us,us,...>");
+      return;
+    }
+    doTX(argv[1], argv[2]);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "TXC") == 0) {
+    if (argc < 4) { irParseError("[ERR] use: TXC <ch> <freqHz> <us,us,...>"); return; }
+    doTXC(argv[1], argv[2], argv[3]);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "TX_AT") == 0) {
+    if (argc < 5) { irParseError("[ERR] use: TX_AT <us> <ch> <freqHz> <us,us,...>"); return; }
+    doTxAt(argv[1], argv[2], argv[3], argv[4]);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "SYNC") == 0) {
+    doSync();
+    return;
+  }
+
+  if (strcasecmp(argv[0], "BEGIN") == 0) {
+    irUploadBegin(argc, argv, cmdPrio);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "CHUNK") == 0) {
+    irUploadChunk(argc, argv);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "COMMIT") == 0) {
+    doCommit(argc, argv);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "STATS") == 0) {
+    if (argc >= 2 && strcasecmp(argv[1], "RESET") == 0) {
+      statsReset();
+      irPrintln("[OK] STATS RESET");
+    } else {
+      statsPrint();
+    }
+    return;
+  }
+
+  if (strcasecmp(argv[0], "MACRO") == 0) {
+    irMacroCommand(argc, argv);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "CAPS") == 0) {
+    doCAPS();
+    return;
+  }
+
+  if (strcasecmp(argv[0], "ABORT") == 0) {
+    doAbort();
+    return;
+  }
+
+  if (strcasecmp(argv[0], "SLEEP") == 0) {
+    doSleep(argc, argv);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "CHANNELS") == 0) {
+    irPrintf("[OK] CHANNELS n=%u\n", (unsigned)portTxChannels());
+    return;
+  }
+
+  if (strcasecmp(argv[0], "RAW") == 0) {
+    doRAW(argc, argv);
+    return;
+  }
+
+  if (strcasecmp(argv[0], "HELP") == 0 || strcasecmp(argv[0], "?") == 0) {
+    help();
+    return;
+  }
+  if (strcasecmp(argv[0], "REC") == 0 && argc >= 2 && strcasecmp(argv[1], "WINDOW") == 0) {
+    doRecWindow(argc, argv);
+    return;
+  }
+  if (strcasecmp(argv[0], "LAST_RECV") == 0 || strcasecmp(argv[0], "?") == 0) {
+    doPrintLastReceived();
+    return;
+  }
+
+  irParseError("[ERR] comandos: NEC <hex8>, TX <freq> <us,...>, RAW <b b b>, HELP");
+}
+
+void irCorePoll() {
+  irMacroPoll();
+  irUploadPoll();
+  pollTxAt();
+  drainPending();
+  // Janela expirou sem nova repetição: o botão foi solto
+  if (recBurstOpen && (uint64_t)(portNowUs() - recLastUs) > recWindowUs) recBurstEnd();
+}
+
+void irCoreFeed(const uint8_t* data, size_t len) {
+  if (len) lastActivityUs = portNowUs();
+  for (size_t i = 0; i < len; i++) {
+    char c = (char)data[i];
+    if (c == '\r') continue;
+    if (c == '\n') {
+      asciiBuf[(asciiLen < sizeof(asciiBuf)-1) ? asciiLen : sizeof(asciiBuf)-1] = 0;
+      if (asciiDropped) {
+        statsCount(CNT_TRUNCATED);
+        statsCount(CNT_DROPPED, asciiDropped);
+        asciiDropped = 0;
+      }
+      irCoreHandleLine(asciiBuf);
+      asciiLen = 0;
+    } else if (asciiLen < sizeof(asciiBuf) - 1) {
+      asciiBuf[asciiLen++] = c;
+    } else {
+      asciiDropped++;
+    }
+  }
+  drainPending();
+}
@@ -0,0 +1,78 @@
+// Núcleo de comandos do firmware, sem dependência de hardware: montagem
+// das linhas ASCII, parse, despacho e formatação das respostas (TX, TXC,
+// RAW, NEC, REC, CAPS, STATS...). Todo acesso ao hardware passa por
+// ir_port.h, então o mesmo código roda no ESP32 e no ambiente native.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ir_limits.h"
+
+#define IR_LINE_BYTES  512    // linha ASCII (inclui o '\0')
+#define IR_REC_BYTES   512    // linha "REC ..." guardada para o LAST_RECV
+
+// Consome bytes da console; cada '\n' despacha a linha acumulada.
+// Linhas maiores que o buffer são truncadas (e contadas no STATS).
+void irCoreFeed(const uint8_t* data, size_t len);
+
+// Processa uma linha completa (sem '\n'); a linha é modificada.
+void irCoreHandleLine(char* line);
+
+// Trabalho temporizado (passos das macros). Chamar a cada volta do loop.
+void irCorePoll();
+
+#define IR_REC_WINDOW_MS      150   // janela padrão da rajada (quadros NEC a cada ~108 ms)
+#define IR_REC_WINDOW_MAX_MS  2000
+
+// Registra uma captura (µs, marca/espaço alternados) como "REC <freq> ..."
+// e responde "[OK] REC armazenado". Um quadro de repetição NEC ou uma
+// captura igual à anterior dentro da janela (REC WINDOW) só conta na rajada
+// corrente: nada é impresso e o retorno é false. O fim da rajada sai como
+// uma única linha "[OK] REC repeat n=<k> us=<duração>" (via irCorePoll).
+bool irCoreRec(const uint16_t* us, uint16_t n);
+
+uint16_t irCorePacketCount();
+
+// Silêncio que o receptor precisa para fechar um quadro. Um espaço pelo
+// menos desse tamanho no meio do padrão é uma fronteira de quadro: o ABORT
+// só corta o canal 0 ali, depois de IR_FRAME_GAP_US de espaço.
+#define IR_FRAME_GAP_US  5000
+#define IR_PEND_BYTES    128   // console guardada enquanto o canal 0 transmite
+
+// Espera o fim do padrão disparado no canal 0. Os bytes que chegam nesse
+// meio tempo são guardados e processados, na ordem, quando o comando
+// termina; se um deles for a linha ABORT e cuttable = true, o padrão é
+// cortado na próxima fronteira de quadro. Retorna false se foi cortado.
+bool irCoreWaitCh0(const uint16_t* us, uint16_t n, bool cuttable);
+
+// TX_AT <µs> <ch> <freqHz>[:duty] <us,...>: dispara no instante dado do
+// relógio do firmware (portNowUs), que o driver acompanha com SYNC. O alvo
+// precisa estar entre IR_TX_AT_MIN_LEAD_US e IR_TX_AT_MAX_LEAD_US à frente.
+#define IR_TX_AT_MIN_LEAD_US  500
+#define IR_TX_AT_MAX_LEAD_US  10000000LL
+#define IR_TX_AT_CHANNELS     8      // canais com TX_AT armado ao mesmo tempo
+
+#define IR_SLEEP_MAX_MS  600000
+
+// Light-sleep ocioso (SLEEP <ms>, 0 = desligado, o padrão). true quando
+// não chega nada pela UART nem pelo receptor há pelo menos esse tempo e
+// não há macro, rajada REC ou captura em andamento.
+bool irCoreCanSleep();
+// A porta chama ao acordar: os bytes que despertaram a UART chegam
+// corrompidos, então a linha parcial é descartada.
+void irCoreWoke(uint32_t sleptUs);
+
+// printf para a console (via portWrite)
+void irPrintf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+void irPrintln(const char* s);
+
+// ====== Parse e codificação compartilhados (TX, NEC e MACRO ADD) ======
+// Em entrada inválida imprimem o [ERR] (contado no STATS) e falham.
+#define NEC_SLICES 67
+uint16_t irParsePattern(char* listStr, uint16_t* raw);    // 0 = inválido
+bool irParseCarrier(const char* s, uint32_t* freqHz, uint8_t* dutyPct);
+bool irParseNEC(const char* hex8, uint32_t* code);
+uint16_t irBuildNEC(uint32_t code, uint16_t* raw);        // NEC_SLICES fatias
+void irParseError(const char* msg);
+void irAckEnd();
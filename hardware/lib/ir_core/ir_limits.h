@@ -0,0 +1,17 @@
+// Limites compartilhados entre o núcleo de comandos e o motor de TX.
+#pragma once
+
+#include <stdint.h>
+
+// ====== Limites de segurança ======
+static const uint32_t MAX_XMIT_TIME_US   = 2000000UL;  // 2 s
+static const uint16_t MAX_PATTERN_COUNT  = 256;
+// Padrão montado em partes (BEGIN/CHUNK/COMMIT, veja ir_upload.h): com
+// ~490 µs de média por fatia, 4096 fatias já ocupam o MAX_XMIT_TIME_US
+static const uint16_t MAX_UPLOAD_COUNT   = 4096;
+#define RAW_TICK_US        50     // cada byte do RAW (espelhado em hal/PatternCanon.h)
+
+// ====== Portadora (gerador do RMT) ======
+#define TX_DEFAULT_DUTY    33     // % (mesmo padrão do IRremote)
+#define TX_CARRIER_MIN_HZ  1000UL
+#define TX_CARRIER_MAX_HZ  500000UL
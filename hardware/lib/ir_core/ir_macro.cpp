@@ -0,0 +1,314 @@
+#include "ir_macro.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>    // strcasecmp
+
+#include "fw_stats.h"
+#include "ir_core.h"
+#include "ir_port.h"
+
+// Abaixo disso o passo seguinte é esperado em laço ocupado, sem devolver o
+// loop: a volta do loop (UART, display) custa mais que a folga aceitável.
+#define MACRO_SPIN_US 2000
+
+enum : uint8_t { STEP_PATTERN, STEP_WAIT };
+enum : uint8_t { RES_NONE, RES_DONE, RES_CANCEL, RES_ERROR, RES_PREEMPT };
+
+struct MacroStep {
+  uint8_t kind;
+  uint8_t ch;
+  uint8_t dutyPct;
+  uint32_t freqHz;
+  uint32_t durUs;     // duração do padrão ou da espera
+  uint16_t off, n;    // fatias em pool[off .. off+n)
+};
+
+struct Macro {
+  char name[MACRO_NAME_BYTES];
+  uint8_t nSteps;
+  MacroStep steps[MACRO_MAX_STEPS];
+};
+
+// Tudo estático: as fatias de todas as macros ficam contíguas em pool, na
+// ordem das macros; o DEL compacta o que vem depois.
+static Macro macros[MACRO_MAX];
+static uint8_t macroCount = 0;
+static uint16_t pool[MACRO_POOL_SLICES];
+static uint16_t poolUsed = 0;
+
+// Execução corrente (run < 0 = parada) e o resultado da última
+static int8_t run = -1;
+static uint8_t runStep = 0;
+static int64_t runStartUs = 0;
+static int64_t runDueUs = 0;       // instante agendado do próximo passo
+static uint32_t runMaxLateUs = 0;
+
+static char lastName[MACRO_NAME_BYTES] = "";
+static uint8_t lastResult = RES_NONE;
+static uint8_t lastSteps = 0, lastTotal = 0;
+static uint32_t lastUs = 0, lastMaxLateUs = 0;
+
+static const char* resultName(uint8_t r) {
+  switch (r) {
+  case RES_DONE:   return "done";
+  case RES_CANCEL: return "cancel";
+  case RES_ERROR:  return "error";
+  case RES_PREEMPT: return "preempt";
+  default:         return "-";
+  }
+}
+
+bool irMacroRunning() {
+  return run >= 0;
+}
+
+// ====== Tabela ======
+static bool validName(const char* s) {
+  size_t n = strlen(s);
+  if (n == 0 || n >= MACRO_NAME_BYTES) return false;
+  for (; *s; ++s) if (!isalnum((unsigned char)*s) && *s != '_' && *s != '-') return false;
+  return true;
+}
+
+static int findMacro(const char* name) {
+  for (int i = 0; i < macroCount; i++) if (strcmp(macros[i].name, name) == 0) return i;
+  return -1;
+}
+
+static uint16_t macroSlices(const Macro& m) {
+  uint16_t n = 0;
+  for (uint8_t i = 0; i < m.nSteps; i++) n += m.steps[i].n;
+  return n;
+}
+
+// Fim das fatias da macro idx no pool (as da seguinte começam aqui)
+static uint16_t macroPoolEnd(int idx) {
+  uint16_t end = 0;
+  for (int i = 0; i <= idx; i++) end += macroSlices(macros[i]);
+  return end;
+}
+
+// Remove as fatias da macro idx e desloca as das macros seguintes
+static void releaseSlices(int idx) {
+  uint16_t n = macroSlices(macros[idx]);
+  if (n == 0) return;
+  uint16_t from = macroPoolEnd(idx);
+  memmove(pool + from - n, pool + from, (poolUsed - from) * sizeof(pool[0]));
+  poolUsed -= n;
+  for (int i = idx + 1; i < macroCount; i++) {
+    for (uint8_t s = 0; s < macros[i].nSteps; s++) macros[i].steps[s].off -= n;
+  }
+  macros[idx].nSteps = 0;
+}
+
+// Abre n fatias no fim das da macro idx, deslocando as das seguintes
+static uint16_t* reserveSlices(int idx, uint16_t n, uint16_t* off) {
+  if (poolUsed + n > MACRO_POOL_SLICES) return nullptr;
+  uint16_t at = macroPoolEnd(idx);
+  memmove(pool + at + n, pool + at, (poolUsed - at) * sizeof(pool[0]));
+  poolUsed += n;
+  for (int i = idx + 1; i < macroCount; i++) {
+    for (uint8_t s = 0; s < macros[i].nSteps; s++) macros[i].steps[s].off += n;
+  }
+  *off = at;
+  return pool + at;
+}
+
+static void doNew(const char* name) {
+  int idx = findMacro(name);
+  if (idx >= 0) {
+    releaseSlices(idx);        // redefinição: recomeça vazia, mesma posição
+  } else {
+    if (macroCount >= MACRO_MAX) { irPrintln("[ERR] macros demais"); return; }
+    idx = macroCount++;
+    strcpy(macros[idx].name, name);
+    macros[idx].nSteps = 0;
+  }
+  irPrintf("[OK] MACRO NEW %s", name);
+  irAckEnd();
+}
+
+static void doDel(const char* name) {
+  int idx = findMacro(name);
+  if (idx < 0) { irPrintln("[ERR] macro inexistente"); return; }
+  releaseSlices(idx);
+  for (int i = idx + 1; i < macroCount; i++) macros[i - 1] = macros[i];
+  macroCount--;
+  irPrintf("[OK] MACRO DEL %s", name);
+  irAckEnd();
+}
+
+// MACRO ADD <nome> TX <freq>[:duty] <us,...> | TXC <ch> <freq>[:duty] <us,...>
+//                  | NEC <HEX8> | WAIT <us>
+static void doAdd(int argc, char** argv) {
+  if (argc < 5) { irParseError("[ERR] use: MACRO ADD <nome> TX|TXC|NEC|WAIT ..."); return; }
+  int idx = findMacro(argv[2]);
+  if (idx < 0) { irPrintln("[ERR] macro inexistente"); return; }
+  Macro& m = macros[idx];
+  if (m.nSteps >= MACRO_MAX_STEPS) { irPrintln("[ERR] macro com passos demais"); return; }
+
+  MacroStep st = {};
+  static uint16_t raw[MAX_PATTERN_COUNT];
+  uint16_t count = 0;
+  const char* kind = argv[3];
+
+  if (strcasecmp(kind, "WAIT") == 0) {
+    char* end = nullptr;
+    unsigned long us = strtoul(argv[4], &end, 10);
+    if (!end || *end || us > MACRO_MAX_WAIT_US) { irParseError("[ERR] WAIT invalido"); return; }
+    st.kind = STEP_WAIT;
+    st.durUs = (uint32_t)us;
+  } else if (strcasecmp(kind, "NEC") == 0) {
+    uint32_t code;
+    if (!irParseNEC(argv[4], &code)) return;
+    count = irBuildNEC(code, raw);
+    st.freqHz = 38000;
+    st.dutyPct = TX_DEFAULT_DUTY;
+  } else if (strcasecmp(kind, "TX") == 0 || strcasecmp(kind, "TXC") == 0) {
+    int a = 4;
+    if (strcasecmp(kind, "TXC") == 0) {
+      uint32_t ch = strtoul(argv[a++], nullptr, 10);
+      if (ch >= portTxChannels()) { irParseError("[ERR] canal invalido"); return; }
+      st.ch = (uint8_t)ch;
+    }
+    if (argc < a + 2) { irParseError("[ERR] use: MACRO ADD <nome> TX[C] [ch] <freqHz> <us,...>"); return; }
+    if (!irParseCarrier(argv[a], &st.freqHz, &st.dutyPct)) return;
+    count = irParsePattern(argv[a + 1], raw);
+    if (count == 0) return;
+  } else {
+    irParseError("[ERR] passo invalido (TX, TXC, NEC, WAIT)");
+    return;
+  }
+
+  if (count) {
+    uint16_t* dst = reserveSlices(idx, count, &st.off);
+    if (!dst) { irPrintln("[ERR] macro sem espaco"); return; }
+    memcpy(dst, raw, count * sizeof(raw[0]));
+    st.n = count;
+    for (uint16_t i = 0; i < count; i++) st.durUs += raw[i];
+  }
+  m.steps[m.nSteps++] = st;
+  irPrintf("[OK] MACRO ADD %s step=%u", m.name, (unsigned)(m.nSteps - 1));
+  irAckEnd();
+}
+
+// ====== Execução ======
+static void finish(uint8_t result) {
+  const Macro& m = macros[run];
+  strcpy(lastName, m.name);
+  lastResult = result;
+  lastSteps = runStep;
+  lastTotal = m.nSteps;
+  lastUs = (uint32_t)(portNowUs() - runStartUs);
+  lastMaxLateUs = runMaxLateUs;
+  run = -1;
+}
+
+static void printLast(const char* verb) {
+  irPrintf("[OK] MACRO %s %s result=%s steps=%u/%u us=%lu late=%lu\n", verb, lastName,
+           resultName(lastResult), (unsigned)lastSteps, (unsigned)lastTotal,
+           (unsigned long)lastUs, (unsigned long)lastMaxLateUs);
+}
+
+static void doRun(const char* name) {
+  int idx = findMacro(name);
+  if (idx < 0) { irPrintln("[ERR] macro inexistente"); return; }
+  if (macros[idx].nSteps == 0) { irPrintln("[ERR] macro vazia"); return; }
+  run = (int8_t)idx;
+  runStep = 0;
+  runStartUs = runDueUs = portNowUs();
+  runMaxLateUs = 0;
+  irPrintf("[OK] MACRO RUN %s steps=%u", name, (unsigned)macros[idx].nSteps);
+  irAckEnd();
+}
+
+// Um passo por chamada, para o CANCEL (e o resto da console) entrar entre
+// passos; o canal 0 ainda bloqueia pela duração do padrão, como no TX.
+void irMacroPoll() {
+  if (run < 0) return;
+  const Macro& m = macros[run];
+
+  int64_t now = portNowUs();
+  if (runDueUs - now > MACRO_SPIN_US) return;
+  while (now < runDueUs) now = portNowUs();
+  uint32_t late = (uint32_t)(now - runDueUs);
+  if (late > runMaxLateUs) runMaxLateUs = late;
+
+  const MacroStep& st = m.steps[runStep];
+  if (st.kind == STEP_WAIT) {
+    runDueUs += st.durUs;
+  } else {
+    StatScope sc(STAGE_TX);
+    if (!portTransmit(st.ch, st.freqHz, st.dutyPct, pool + st.off, st.n)) {
+      finish(RES_ERROR);
+      printLast("DONE");
+      return;
+    }
+    // Cortado por um ABORT: a linha é processada logo depois e encerra a macro
+    if (st.ch == 0 && !irCoreWaitCh0(pool + st.off, st.n, true)) return;
+    // Só o canal 0 ocupa a linha do tempo; os demais seguem em paralelo
+    if (st.ch == 0) runDueUs += st.durUs;
+  }
+
+  if (++runStep >= m.nSteps) {
+    finish(RES_DONE);
+    printLast("DONE");
+  }
+}
+
+static void doCancel() {
+  if (run < 0) { irPrintln("[OK] MACRO CANCEL -"); return; }
+  finish(RES_CANCEL);
+  printLast("CANCEL");
+}
+
+void irMacroPreempt() {
+  if (run < 0) return;
+  finish(RES_PREEMPT);
+  printLast("CANCEL");
+}
+
+static void doStatus() {
+  if (run >= 0) {
+    irPrintf("[OK] MACRO STATUS run=%s step=%u/%u", macros[run].name, (unsigned)runStep,
+             (unsigned)macros[run].nSteps);
+  } else {
+    irPrintf("[OK] MACRO STATUS run=- step=0/0");
+  }
+  irPrintf(" last=%s result=%s us=%lu late=%lu\n", lastName[0] ? lastName : "-",
+           resultName(lastResult), (unsigned long)lastUs, (unsigned long)lastMaxLateUs);
+}
+
+static void doList() {
+  irPrintf("[OK] MACRO LIST n=%u free=%u", (unsigned)macroCount,
+           (unsigned)(MACRO_POOL_SLICES - poolUsed));
+  for (int i = 0; i < macroCount; i++) {
+    irPrintf(" %s:%u", macros[i].name, (unsigned)macros[i].nSteps);
+  }
+  portWrite("\n", 1);
+}
+
+void irMacroCommand(int argc, char** argv) {
+  const char* verb = (argc >= 2) ? argv[1] : "";
+
+  if (strcasecmp(verb, "STATUS") == 0) { doStatus(); return; }
+  if (strcasecmp(verb, "LIST") == 0)   { doList();   return; }
+  if (strcasecmp(verb, "CANCEL") == 0) { doCancel(); return; }
+
+  if (argc < 3) { irParseError("[ERR] use: MACRO NEW|ADD|RUN|DEL <nome> ... | CANCEL | STATUS | LIST"); return; }
+  const char* name = argv[2];
+  if (!validName(name)) { irParseError("[ERR] nome de macro invalido"); return; }
+
+  // A tabela (e o pool) não mudam sob a execução
+  if (run >= 0) { irPrintln("[ERR] macro em execucao"); return; }
+  if (portCapActive()) { irPrintln("[ERR] sessao de captura ativa"); return; }
+
+  if (strcasecmp(verb, "NEW") == 0) { doNew(name); return; }
+  if (strcasecmp(verb, "ADD") == 0) { doAdd(argc, argv); return; }
+  if (strcasecmp(verb, "RUN") == 0) { doRun(name); return; }
+  if (strcasecmp(verb, "DEL") == 0) { doDel(name); return; }
+  irParseError("[ERR] use: MACRO NEW|ADD|RUN|DEL <nome> ... | CANCEL | STATUS | LIST");
+}
@@ -0,0 +1,25 @@
+// Macros ("cenas"): sequências nomeadas de padrões, NEC e esperas,
+// guardadas na RAM do firmware e executadas localmente. O tempo de cada
+// passo é agendado em µs a partir do início da execução, então as esperas
+// não acumulam a latência do host nem a da volta do loop.
+#pragma once
+
+#include <stdint.h>
+
+#define MACRO_MAX          8      // macros guardadas
+#define MACRO_MAX_STEPS    32     // passos por macro
+#define MACRO_NAME_BYTES   16     // nome (inclui o '\0')
+#define MACRO_POOL_SLICES  4096   // fatias de todas as macros juntas
+#define MACRO_MAX_WAIT_US  60000000UL
+
+// MACRO NEW|ADD|RUN|CANCEL|STATUS|LIST|DEL ...; argv[0] é "MACRO"
+void irMacroCommand(int argc, char** argv);
+
+// Executa os passos vencidos; chamado por irCorePoll()
+void irMacroPoll();
+
+// Enquanto uma macro roda, o canal 0 é dela: TX/NEC/RAW/TXC/CAP são recusados
+bool irMacroRunning();
+
+// Encerra a macro em execução com result=preempt (ABORT ou TX interativo)
+void irMacroPreempt();
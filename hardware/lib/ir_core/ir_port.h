@@ -0,0 +1,51 @@
+// Porta de hardware do núcleo de comandos.
+//
+// O firmware (src/main.cpp) implementa estas funções sobre UART, RMT,
+// IRremote e SSD1306; o ambiente native (bench/) implementa com mocks.
+// O núcleo não chama nada do Arduino/ESP-IDF fora daqui.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Saída da console (UART)
+void portWrite(const char* data, size_t len);
+
+// Bytes que já chegaram pela console, sem bloquear (0 = nada). O núcleo só
+// lê por aqui enquanto espera o canal 0, para um ABORT entrar no meio do TX.
+size_t portRead(uint8_t* buf, size_t max);
+
+// Relógio monotônico em µs
+int64_t portNowUs();
+
+uint8_t portTxChannels();
+
+// Dispara o padrão (µs, on/off alternados) no canal, sem bloquear. O
+// núcleo espera o canal 0 com portTxBusy (veja irCoreWaitCh0).
+bool portTransmit(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n);
+bool portTxBusy(uint8_t ch);
+// true se um padrão longo (upload) não pode sair no canal agora porque
+// outro canal ainda transmite do mesmo buffer; portTransmit recusa na hora
+bool portTxLongBusy(uint8_t ch);
+// Corta a transmissão em curso; a saída volta para espaço
+void portTxStop(uint8_t ch);
+
+// TX_AT: arma o padrão para sair no canal quando portNowUs() chegar a atUs.
+// O disparo vem de um timer de hardware, sem depender do loop; a porta
+// copia o padrão e o canal fica reservado até lá. portTxArmed é true até o
+// disparo e portTxFiredUs dá o instante em que ele começou de fato.
+bool portTransmitAt(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n,
+                    int64_t atUs);
+bool portTxArmed(uint8_t ch);
+int64_t portTxFiredUs(uint8_t ch);
+
+// Frequência efetivamente gerada no canal (após a quantização do hardware)
+uint32_t portCarrierHz(uint8_t ch);
+
+// Três linhas no display e o contador de pacotes
+void portShow(const char* l1, const char* l2, const char* l3, uint16_t packets);
+
+// Sessão de captura contínua: as próprias funções respondem [OK]/[ERR]
+void portCapStart();
+void portCapStop();
+bool portCapActive();
@@ -0,0 +1,148 @@
+#include "ir_upload.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fw_stats.h"
+#include "ir_core.h"
+#include "ir_port.h"
+
+// O pool é estático e do tamanho do maior padrão; cada BEGIN usa só as n
+// fatias que declarou, e o que chega por CHUNK vai direto para lá.
+static uint16_t pool[MAX_UPLOAD_COUNT];
+
+static bool upOpen = false;
+static bool upPrio = false;
+static bool upCut = false;          // descartada por ABORT (até o próximo BEGIN)
+static uint8_t upCh = 0;
+static uint8_t upDutyPct = TX_DEFAULT_DUTY;
+static uint32_t upFreqHz = 0;
+static uint16_t upN = 0;            // fatias declaradas no BEGIN
+static uint16_t upGot = 0;          // prefixo contíguo já recebido
+static int64_t upLastUs = 0;
+
+uint16_t irCrc16(uint16_t crc, const uint16_t* us, uint16_t n) {
+  for (uint16_t i = 0; i < n; i++) {
+    for (uint8_t k = 0; k < 2; k++) {
+      crc ^= (uint16_t)(((us[i] >> (8 * k)) & 0xFF) << 8);
+      for (uint8_t b = 0; b < 8; b++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Número inteiro sem sinal em base dada, ocupando o token inteiro
+static bool parseNum(const char* s, int base, unsigned long max, unsigned long* out) {
+  char* end = nullptr;
+  if (!s || !*s) return false;
+  *out = strtoul(s, &end, base);
+  return end && !*end && *out <= max;
+}
+
+// [ERR] de montagem (CRC, offset, fora de ordem), contado no STATS
+static void uploadError(const char* msg) {
+  statsCount(CNT_UPLOAD_ERR);
+  irPrintln(msg);
+}
+
+bool irUploadOpen() {
+  return upOpen;
+}
+
+// Sem montagem aberta: diz se foi um ABORT que a levou
+static void notOpen() {
+  uploadError(upCut ? "[ERR] abortado upload" : "[ERR] upload inexistente");
+}
+
+void irUploadBegin(int argc, char** argv, bool isPrio) {
+  if (argc < 5) { irParseError("[ERR] use: BEGIN <ch> <freqHz> <n> <totalUs>"); return; }
+  unsigned long ch, n, totalUs;
+  if (!parseNum(argv[1], 10, 255, &ch) || ch >= portTxChannels()) { irParseError("[ERR] canal invalido"); return; }
+  uint32_t freqHz; uint8_t dutyPct;
+  if (!irParseCarrier(argv[2], &freqHz, &dutyPct)) return;
+  if (!parseNum(argv[3], 10, 65535, &n) || n == 0 || !parseNum(argv[4], 10, 0xFFFFFFFFUL, &totalUs)) {
+    irParseError("[ERR] use: BEGIN <ch> <freqHz> <n> <totalUs>"); return;
+  }
+  // Recusado já aqui, antes de o driver mandar kilobytes de CHUNK
+  if (n > MAX_UPLOAD_COUNT) { statsCount(CNT_OVER_LIMIT); irPrintln("[ERR] pattern com fatias demais"); return; }
+  if (totalUs > MAX_XMIT_TIME_US) { statsCount(CNT_OVER_LIMIT); irPrintln("[ERR] pattern muito longo"); return; }
+
+  // Uma montagem anterior em aberto é de um envio que o driver desistiu
+  upOpen = true;
+  upPrio = isPrio;
+  upCut = false;
+  upCh = (uint8_t)ch;
+  upFreqHz = freqHz;
+  upDutyPct = dutyPct;
+  upN = (uint16_t)n;
+  upGot = 0;
+  upLastUs = portNowUs();
+  irPrintf("[OK] BEGIN ch=%u n=%u", (unsigned)upCh, (unsigned)upN);
+  irAckEnd();
+}
+
+void irUploadChunk(int argc, char** argv) {
+  if (argc < 4) { irParseError("[ERR] use: CHUNK <off> <crc> <us,us,...>"); return; }
+  if (!upOpen) { notOpen(); return; }
+  unsigned long off, crc;
+  if (!parseNum(argv[1], 10, 65535, &off) || !parseNum(argv[2], 16, 0xFFFF, &crc)) {
+    irParseError("[ERR] use: CHUNK <off> <crc> <us,us,...>"); return;
+  }
+
+  // Confere antes de copiar: um pedaço corrompido não estraga o que já chegou
+  static uint16_t raw[MAX_PATTERN_COUNT];
+  uint16_t k = irParsePattern(argv[3], raw);
+  if (k == 0) return;
+  if (irCrc16(0xFFFF, raw, k) != (uint16_t)crc) { uploadError("[ERR] CHUNK crc"); return; }
+  // Só em ordem: off além do recebido deixaria um buraco
+  if (off > upGot || off + k > upN) {
+    irPrintf("[ERR] CHUNK offset got=%u\n", (unsigned)upGot);
+    statsCount(CNT_UPLOAD_ERR);
+    return;
+  }
+
+  memcpy(pool + off, raw, k * sizeof(raw[0]));
+  if (off + k > upGot) upGot = (uint16_t)(off + k);
+  upLastUs = portNowUs();
+  irPrintf("[OK] CHUNK off=%lu n=%u got=%u", off, (unsigned)k, (unsigned)upGot);
+  irAckEnd();
+}
+
+bool irUploadCommit(int argc, char** argv, IrUpload* out) {
+  if (argc < 2) { irParseError("[ERR] use: COMMIT <crc>"); return false; }
+  if (!upOpen) { notOpen(); return false; }
+  unsigned long crc;
+  if (!parseNum(argv[1], 16, 0xFFFF, &crc)) { irParseError("[ERR] use: COMMIT <crc>"); return false; }
+
+  upOpen = false;
+  if (upGot != upN) {
+    irPrintf("[ERR] upload incompleto got=%u n=%u\n", (unsigned)upGot, (unsigned)upN);
+    statsCount(CNT_UPLOAD_ERR);
+    return false;
+  }
+  if (irCrc16(0xFFFF, pool, upN) != (uint16_t)crc) { uploadError("[ERR] COMMIT crc"); return false; }
+  // O totalUs do BEGIN é do driver; vale a soma do que chegou
+  uint32_t totalUs = 0;
+  for (uint16_t i = 0; i < upN; i++) totalUs += pool[i];
+  if (totalUs > MAX_XMIT_TIME_US) { statsCount(CNT_OVER_LIMIT); irPrintln("[ERR] pattern muito longo"); return false; }
+
+  out->ch = upCh;
+  out->freqHz = upFreqHz;
+  out->dutyPct = upDutyPct;
+  out->us = pool;
+  out->n = upN;
+  return true;
+}
+
+bool irUploadAbort() {
+  if (!upOpen || upPrio) return false;
+  upOpen = false;
+  upCut = true;
+  return true;
+}
+
+void irUploadPoll() {
+  if (!upOpen || portNowUs() - upLastUs < UPLOAD_IDLE_US) return;
+  upOpen = false;
+  statsCount(CNT_UPLOAD_ERR);
+}
@@ -0,0 +1,49 @@
+// Upload em partes dos padrões que não cabem numa linha ASCII
+// (IR_LINE_BYTES) nem em MAX_PATTERN_COUNT fatias: códigos de
+// ar-condicionado e de projetor passam de 400 fatias. O driver abre a
+// montagem, manda as fatias em pedaços que cabem na linha e fecha com o
+// CRC do padrão inteiro; só então o padrão sai, como num TXC.
+//
+//   BEGIN <ch> <freqHz>[:duty] <n> <totalUs>   reserva n fatias no pool
+//   CHUNK <off> <crc> <us,...>                 fatias [off, off+k)
+//   COMMIT <crc>                               confere e transmite
+//
+// O CRC é o CRC-16/CCITT-FALSE (polinômio 0x1021, início 0xFFFF) sobre as
+// fatias em little-endian, o mesmo crc_itu_t(0xffff, ...) do kernel. Um
+// CHUNK com CRC errado não toca no pool e pode ser reenviado; um CHUNK
+// repetido (o [OK] se perdeu) só reescreve o que já tinha chegado.
+#pragma once
+
+#include <stdint.h>
+
+#include "ir_limits.h"   // MAX_UPLOAD_COUNT
+
+#define UPLOAD_IDLE_US  2000000LL   // sem BEGIN/CHUNK por esse tempo, a montagem é descartada
+
+// Padrão conferido pelo COMMIT; us aponta para o pool e vale até o próximo BEGIN
+struct IrUpload {
+  uint8_t ch;
+  uint8_t dutyPct;
+  uint32_t freqHz;
+  const uint16_t* us;
+  uint16_t n;
+};
+
+// argv[0] é "BEGIN"/"CHUNK"; respondem [OK]/[ERR]. prio = linha com "!":
+// a montagem não é descartada por um ABORT.
+void irUploadBegin(int argc, char** argv, bool prio);
+void irUploadChunk(int argc, char** argv);
+
+// COMMIT <crc>: fecha a montagem e a entrega em out. Em falha imprime o
+// [ERR] e retorna false; de um jeito ou de outro a montagem acaba aqui.
+bool irUploadCommit(int argc, char** argv, IrUpload* out);
+
+bool irUploadOpen();
+// ABORT: descarta a montagem de fundo em aberto (os CHUNK/COMMIT seguintes
+// respondem "[ERR] abortado"). Retorna true se havia uma.
+bool irUploadAbort();
+
+// Descarta a montagem ociosa há UPLOAD_IDLE_US; chamado por irCorePoll()
+void irUploadPoll();
+
+uint16_t irCrc16(uint16_t crc, const uint16_t* us, uint16_t n);
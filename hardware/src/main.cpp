@@ -3,37 +3,53 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <IRremote.hpp>
-#include <ctype.h>      // isspace, isxdigit
-#include <string.h>     // strtok, strlen
+#include <driver/gpio.h> // gpio_get_level (ISR da captura contínua)
+#include <esp_timer.h>    // relógio do núcleo (portNowUs)
+#include <esp_sleep.h>    // light-sleep ocioso (SLEEP)
+#include <driver/uart.h>  // despertar pela UART
+#include "ir_core.h"
+#include "ir_port.h"
+#include "tx_engine.h"
 
 // ====== Hardware & Display ======
 #define IR_SEND_PIN     2
-#define IR_RECV_PIN     14 
+#define IR_RECV_PIN     14
+// Canais do motor RMT: canal 0 -> IR_SEND_PIN; zonas: canal 1 -> 25, canal 2 -> 26, canal 3 -> 27
+static const uint8_t IR_TX_PINS[] = { IR_SEND_PIN, 25, 26, 27 };
 #define SCREEN_WIDTH    128
 #define SCREEN_HEIGHT   32
 #define OLED_ADDR       0x3C
 
 #define UART            Serial
 #define BAUD            115200
- 
-// ====== Limites de segurança ======
-static const uint32_t MAX_XMIT_TIME_US   = 2000000UL;  // 2 s
-static const uint16_t MAX_PATTERN_COUNT  = 256;
 
 // ====== Estado / buffers ======
+// Parse, despacho e respostas dos comandos ficam em lib/ir_core; aqui só
+// o que depende do ESP32 (UART, RMT, IRremote, display, captura por ISR).
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
-static char asciiBuf[512];
-static uint16_t asciiLen = 0;
-static uint16_t packetCount = 0;
-static uint32_t lastFreqHz = 38000;
 
 #ifndef MICROS_PER_TICK
   #define MICROS_PER_TICK 50
 #endif
 
-// Guarda o último comando recebido em formato REC ...
-static char lastRecLine[512];
-static bool hasLastRec = false;
+// ====== Sessão de captura contínua (CAP START/STOP) ======
+// Cada borda do receptor vira uma duração de 16 bits: bit15 = nível
+// (1 = marca, 0 = espaço), bits 0..14 = µs. Durações maiores que 0x7FFF
+// são quebradas em várias entradas do mesmo nível.
+// Quadro binário na UART: 0xA5 <n> <n × u16 little-endian>; n = 0 encerra.
+#define CAP_SYNC        0xA5
+#define CAP_RING_SIZE   512              // potência de 2
+#define CAP_CHUNK_MAX   64               // entradas por quadro
+#define CAP_FLUSH_US    20000UL          // envia pendentes a cada 20 ms
+#define CAP_MAX_GAP_US  1000000UL        // silêncios longos são truncados em 1 s
+
+static volatile uint16_t capRing[CAP_RING_SIZE];
+static volatile uint16_t capHead = 0, capTail = 0;
+static volatile uint32_t capLastEdgeUs = 0;
+static volatile uint32_t capOverruns = 0;
+static bool capActive = false;
+static uint32_t capTotal = 0;
+static uint32_t capLastFlushUs = 0;
 
 // ====== Helpers ======
 static inline void show3(const String& l1, const String& l2 = "", const String& l3 = "") {
@@ -44,207 +60,203 @@ static inline void show3(const String& l1, const String& l2 = "", const String&
   display.setCursor(0, 12); display.println(l2);   // 12 px
   display.setCursor(0, 24); display.println(l3);   // 24 px (última linha)
   display.setCursor(100, 24);                      // cabe no 128×32
-  display.print("#"); display.print(packetCount);
+  display.print("#"); display.print(irCorePacketCount());
   display.display();
 }
 
-static inline void trim(char* s) {
-  int n = strlen(s);
-  while (n > 0 && (s[n-1] == '\r' || s[n-1] == '\n' || isspace((unsigned char)s[n-1]))) s[--n] = 0;
-  int i = 0; while (isspace((unsigned char)s[i])) i++;
-  if (i > 0) memmove(s, s + i, strlen(s + i) + 1);
+// ====== Porta do núcleo (ir_port.h) ======
+void portWrite(const char* data, size_t len) {
+  UART.write((const uint8_t*)data, len);
 }
 
-static inline bool isHexStr(const char* s, int expectLen) {
-  if ((int)strlen(s) != expectLen) return false;
-  for (const char* p = s; *p; ++p) if (!isxdigit((unsigned char)*p)) return false;
-  return true;
+size_t portRead(uint8_t* buf, size_t max) {
+  int avail = UART.available();
+  if (avail <= 0) return 0;
+  return UART.read(buf, ((size_t)avail < max) ? (size_t)avail : max);
 }
 
-static void help() {
-  UART.println(F("IR ASCII cmds:"));
-  UART.println(F("  NEC <HEX8>                  e.g. NEC 20DF10EF"));
-  UART.println(F("  TX <freqHz> <us,...>        e.g. TX 38000 9000,4500,560,560,560,560"));
-  UART.println(F("  RAW <b b b>                 e.g. RAW 10 20 30 40  (each * 50us)"));
+int64_t portNowUs() {
+  return esp_timer_get_time();
 }
 
-// ====== Execução dos comandos ======
-static void doNEC(const char* hex8) {
-  if (!isHexStr(hex8, 8)) { UART.println(F("[ERR] use: NEC 20DF10EF")); return; }
-  uint8_t raw[4];
-  for (int i = 0; i < 4; i++) {
-    char tmp[3] = { hex8[2*i], hex8[2*i+1], 0 };
-    raw[i] = (uint8_t) strtoul(tmp, nullptr, 16);
-  }
-  uint32_t code = (uint32_t(raw[0])<<24)|(uint32_t(raw[1])<<16)|(uint32_t(raw[2])<<8)|raw[3];
-  IrSender.sendNECMSB(code, 32);   // API nova (MSB)
-  packetCount++;
-  show3("NEC", String(hex8), "enviado");
-  UART.printf("[OK] NEC 0x%s\n", hex8);
+uint8_t portTxChannels() {
+  return txEngineChannels();
 }
 
-static void doTX(char* freqStr, char* listStr) {
-  if (!freqStr || !listStr) { UART.println(F("[ERR] use: TX <freqHz> <us,us,...>")); return; }
-  uint32_t freqHz = strtoul(freqStr, nullptr, 10);
-  if (freqHz == 0) { UART.println(F("[ERR] freqHz invalida")); return; }
-
-  static uint16_t raw[MAX_PATTERN_COUNT];
-  uint16_t count = 0;
-  uint32_t totalUs = 0;
-
-  // Parse "9000,4500,560,560,..."
-  for (char* tok = strtok(listStr, ","); tok && count < MAX_PATTERN_COUNT; tok = strtok(nullptr, ",")) {
-    while (*tok && isspace((unsigned char)*tok)) tok++;
-    uint32_t us = strtoul(tok, nullptr, 10);
-    if (us == 0) { UART.println(F("[ERR] duracao <= 0")); return; }
-    raw[count++] = (uint16_t) us;
-    totalUs += us;
-  }
-  if (count == 0) { UART.println(F("[ERR] pattern vazio")); return; }
-  if (totalUs > MAX_XMIT_TIME_US) { UART.println(F("[ERR] pattern muito longo")); return; }
+bool portTransmit(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n) {
+  return txEngineStart(ch, freqHz, dutyPct, us, n);
+}
 
-  uint8_t kHz = (uint8_t)((freqHz + 500) / 1000);
-  if (kHz == 0) kHz = 1; if (kHz > 255) kHz = 255;
+bool portTxBusy(uint8_t ch) {
+  return txEngineBusy(ch);
+}
+
+bool portTxLongBusy(uint8_t ch) {
+  return txEngineLongBusy(ch);
+}
 
-  IrSender.enableIROut(kHz);
-  IrSender.sendRaw(raw, count, kHz);
+void portTxStop(uint8_t ch) {
+  txEngineStop(ch);
+}
 
-  lastFreqHz = freqHz;
-  packetCount++;
+bool portTransmitAt(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n,
+                    int64_t atUs) {
+  return txEngineStartAt(ch, freqHz, dutyPct, us, n, atUs);
+}
 
-  char fbuf[28]; snprintf(fbuf, sizeof(fbuf), "f=%lu Hz", (unsigned long)freqHz);
-  char cbuf[28]; snprintf(cbuf, sizeof(cbuf), "n=%u slices", count);
-  show3("TRANSMIT", fbuf, cbuf);
-  UART.printf("[OK] TX f=%lu Hz, n=%u\n", (unsigned long)freqHz, count);
+bool portTxArmed(uint8_t ch) {
+  return txEngineArmed(ch);
 }
 
-static void doRAW(int argc, char** argv) {
-  // RAW 10 20 30 40  (cada valor vira 50us)
-  if (argc <= 1) { UART.println(F("[ERR] use: RAW <b b b>")); return; }
-  static uint16_t raw[MAX_PATTERN_COUNT];
-  uint16_t n = 0; uint32_t totalUs = 0;
-
-  for (int i = 1; i < argc && n < MAX_PATTERN_COUNT; i++) {
-    // aceita decimal ou hex (0x.. ou sem 0x)
-    uint32_t v = 0;
-    if (strncasecmp(argv[i], "0x", 2) == 0) v = strtoul(argv[i] + 2, nullptr, 16);
-    else v = strtoul(argv[i], nullptr, 0);
-    if (v > 255) v = 255;
-    raw[n++] = (uint16_t)(v * 50);
-    totalUs += raw[n-1];
-  }
+int64_t portTxFiredUs(uint8_t ch) {
+  return txEngineFiredUs(ch);
+}
 
-  if (n == 0) { UART.println(F("[ERR] RAW vazio")); return; }
-  if (totalUs > MAX_XMIT_TIME_US) { UART.println(F("[ERR] pattern muito longo")); return; }
+uint32_t portCarrierHz(uint8_t ch) {
+  return txEngineCarrierHz(ch);
+}
 
-  uint8_t kHz = (uint8_t)((lastFreqHz + 500) / 1000);
-  if (kHz == 0) kHz = 38;
-  IrSender.sendRaw(raw, n, kHz);
+void portShow(const char* l1, const char* l2, const char* l3, uint16_t packets) {
+  (void)packets;   // show3 lê o contador do núcleo
+  show3(l1, l2, l3);
+}
 
-  packetCount++;
-  show3("RAW(antigo)", String("n=") + n, "enviado");
-  UART.printf("[OK] RAW n=%u\n", n);
+bool portCapActive() {
+  return capActive;
 }
 
+// ====== Recepção ======
 void doREC() {
   if (!IrReceiver.decode()) return;
 
-  // Use last used transmit frequency as fallback for display and REC output.
-  uint32_t freq = lastFreqHz;  // Hz (fallback)
-
   // === RAW buffer (ticks -> microsegundos) ===
   IRRawlenType rawCount = IrReceiver.decodedIRData.rawlen;
   const IRRawbufType* buf = IrReceiver.decodedIRData.rawDataPtr->rawbuf;
 
-  // Quick diagnostic
-  UART.print(F("[DBG] rawlen=")); UART.println((unsigned long)rawCount);
-
   if (rawCount == 0) {
     IrReceiver.resume();
     return;
   }
 
-  // Monta a linha no formato: REC <freq> 9000,4500,560,560,...
-  int n = snprintf(lastRecLine, sizeof(lastRecLine), "REC %lu ", (unsigned long)freq);
-
   // Começa em i = 1 para pular o primeiro elemento (gap/lixo)
-  for (IRRawlenType i = 1; i < rawCount && n < (int)sizeof(lastRecLine) - 1; i++) {
-    uint32_t us = (uint32_t)buf[i] * (uint32_t)MICROS_PER_TICK;
+  static uint16_t us[RAW_BUFFER_LENGTH];
+  uint16_t n = 0;
+  for (IRRawlenType i = 1; i < rawCount; i++) {
+    uint32_t v = (uint32_t)buf[i] * (uint32_t)MICROS_PER_TICK;
 
     // ignore zero entries
-    if (us == 0) continue;
-
-    int wrote = snprintf(lastRecLine + n, sizeof(lastRecLine) - n,
-                         (i + 1 < rawCount) ? "%lu," : "%lu",
-                         (unsigned long)us);
-    if (wrote < 0 || wrote >= (int)(sizeof(lastRecLine) - n)) break;
-    n += wrote;
+    if (v == 0) continue;
+    us[n++] = (v > 0xFFFF) ? 0xFFFF : (uint16_t)v;
   }
 
-  hasLastRec = true;
-  packetCount++;
-
-  // Feedback no display
-  char fbuf[30]; snprintf(fbuf, sizeof(fbuf), "f=%lu", (unsigned long)freq);
-  char cbuf[30]; snprintf(cbuf, sizeof(cbuf), "n=%u", (unsigned int)((rawCount > 0) ? (rawCount - 1) : 0));
-  show3("RECEBIDO", fbuf, cbuf);
-
-  UART.println(F("[OK] REC armazenado. Use LAST_REC para ver."));
+  // Repetições do botão segurado ficam só no contador da rajada
+  if (irCoreRec(us, n)) {
+    UART.print(F("[DBG] rawlen=")); UART.println((unsigned long)rawCount);
+  }
 
   IrReceiver.resume();
 }
 
-void doPrintLastReceived() {
-  if (!hasLastRec) {
-    UART.println(F("[ERR] nenhum REC armazenado ainda"));
-    return;
+// ====== Captura contínua ======
+static void IRAM_ATTR capIsr() {
+  uint32_t now = micros();
+  uint32_t dur = now - capLastEdgeUs;
+  capLastEdgeUs = now;
+  if (dur > CAP_MAX_GAP_US) dur = CAP_MAX_GAP_US;
+
+  // TSOP: saída em LOW durante a marca. Se agora está HIGH, o trecho que
+  // acabou de terminar era marca.
+  uint16_t level = gpio_get_level((gpio_num_t)IR_RECV_PIN) ? 0x8000 : 0;
+  while (dur > 0) {
+    uint16_t piece = (dur > 0x7FFF) ? 0x7FFF : (uint16_t)dur;
+    uint16_t next = (capHead + 1) & (CAP_RING_SIZE - 1);
+    if (next == capTail) { capOverruns++; return; }
+    capRing[capHead] = level | piece;
+    capHead = next;
+    dur -= piece;
   }
-  UART.println(lastRecLine);
 }
 
-// ====== Parser de linha ASCII ======
-static void handleAsciiLine(char* line) {
-  trim(line);
-  if (!*line) return;
-
-  // tokenização simples
-  char* argv[40] = {0};
-  int argc = 0;
-  for (char* p = strtok(line, " "); p && argc < 40; p = strtok(nullptr, " ")) {
-    argv[argc++] = p;
-  }
-  if (argc == 0) return;
-
-  if (strcasecmp(argv[0], "NEC") == 0) {
-    if (argc < 2) { UART.println(F("[ERR] use: NEC <HEX8>")); return; }
-    doNEC(argv[1]);
-    return;
-  }
-  
-  if (strcasecmp(argv[0], "TX") == 0 || strcasecmp(argv[0], "TRANSMIT") == 0) {
-    if (argc < 3) { 
-      UART.println(F("[ERR] use: TX <freqHz> <us,us,...>")); 
-      return; 
+static void capFlush(bool force) {
+  uint16_t pending = (capHead - capTail) & (CAP_RING_SIZE - 1);
+  if (pending == 0) return;
+  if (!force && pending < CAP_CHUNK_MAX && (micros() - capLastFlushUs) < CAP_FLUSH_US) return;
+
+  uint8_t frame[2 + 2 * CAP_CHUNK_MAX];
+  while (pending > 0) {
+    uint8_t n = 0;
+    while (n < CAP_CHUNK_MAX && capTail != capHead) {
+      uint16_t v = capRing[capTail];
+      frame[2 + 2 * n]     = (uint8_t)(v & 0xFF);
+      frame[2 + 2 * n + 1] = (uint8_t)(v >> 8);
+      capTail = (capTail + 1) & (CAP_RING_SIZE - 1);
+      n++;
     }
-    doTX(argv[1], argv[2]);
-    return;
-  }
-  
-  if (strcasecmp(argv[0], "RAW") == 0) {
-    doRAW(argc, argv);
-    return;
+    frame[0] = CAP_SYNC;
+    frame[1] = n;
+    UART.write(frame, 2 + 2 * n);
+    capTotal += n;
+    pending = force ? ((capHead - capTail) & (CAP_RING_SIZE - 1)) : 0;
   }
+  capLastFlushUs = micros();
+}
 
-  if (strcasecmp(argv[0], "HELP") == 0 || strcasecmp(argv[0], "?") == 0) {
-    help();
-    return;
-  }
-  if (strcasecmp(argv[0], "LAST_RECV") == 0 || strcasecmp(argv[0], "?") == 0) {
-    doPrintLastReceived();
-    return;
-  }
+void portCapStart() {
+  if (capActive) { UART.println(F("[ERR] CAP ja ativa")); return; }
+
+  IrReceiver.stop();
+  capHead = capTail = 0;
+  capOverruns = 0;
+  capTotal = 0;
+  capLastEdgeUs = micros();
+  capLastFlushUs = capLastEdgeUs;
+  capActive = true;
+  attachInterrupt(digitalPinToInterrupt(IR_RECV_PIN), capIsr, CHANGE);
 
-  UART.println(F("[ERR] comandos: NEC <hex8>, TX <freq> <us,...>, RAW <b b b>, HELP"));
+  show3("CAPTURA", "continua", "ativa");
+  UART.println(F("[OK] CAP START"));
+}
+
+void portCapStop() {
+  if (!capActive) { UART.println(F("[ERR] CAP nao ativa")); return; }
+
+  detachInterrupt(digitalPinToInterrupt(IR_RECV_PIN));
+  capActive = false;
+  capFlush(true);
+
+  const uint8_t endFrame[2] = { CAP_SYNC, 0 };
+  UART.write(endFrame, sizeof(endFrame));
+  IrReceiver.start();
+
+  char cbuf[28]; snprintf(cbuf, sizeof(cbuf), "n=%lu", (unsigned long)capTotal);
+  show3("CAPTURA", "encerrada", cbuf);
+  UART.printf("[OK] CAP STOP n=%lu ovf=%lu\n", (unsigned long)capTotal, (unsigned long)capOverruns);
+}
+
+// ====== Light-sleep ocioso (SLEEP <ms>) ======
+// Acorda pela UART ou por uma marca no receptor. Os bytes que despertam a
+// UART se perdem (o driver manda uma linha vazia antes do comando) e o
+// primeiro quadro IR depois de acordar costuma chegar incompleto.
+#define UART_WAKE_EDGES 3
+
+static void idleSleep() {
+  if (!irCoreCanSleep()) return;
+  for (uint8_t ch = 0; ch < txEngineChannels(); ch++)
+    if (txEngineBusy(ch)) return;
+
+  UART.flush();   // termina de enviar a última resposta
+  uart_set_wakeup_threshold(UART_NUM_0, UART_WAKE_EDGES);
+  esp_sleep_enable_uart_wakeup(UART_NUM_0);
+  gpio_wakeup_enable((gpio_num_t)IR_RECV_PIN, GPIO_INTR_LOW_LEVEL);   // TSOP: marca em LOW
+  esp_sleep_enable_gpio_wakeup();
+
+  int64_t t0 = esp_timer_get_time();
+  esp_light_sleep_start();
+  int64_t slept = esp_timer_get_time() - t0;
+
+  gpio_wakeup_disable((gpio_num_t)IR_RECV_PIN);
+  uart_flush_input(UART_NUM_0);   // descarta o que chegou corrompido no despertar
+  irCoreWoke((uint32_t)slept);
 }
 
 // ====== Setup/Loop ======
@@ -255,22 +267,26 @@ void setup() {
   } else {
     show3("IR ASCII v1.0", "Aguardando cmd", "");
   }
-  IrSender.begin(IR_SEND_PIN, ENABLE_LED_FEEDBACK, USE_DEFAULT_FEEDBACK_LED_PIN);
   IrReceiver.begin(IR_RECV_PIN, ENABLE_LED_FEEDBACK, USE_DEFAULT_FEEDBACK_LED_PIN);
+  if (!txEngineBegin(IR_TX_PINS, sizeof(IR_TX_PINS))) {
+    UART.printf("[WARN] RMT inicializou so %u canal(is) de TX\n", (unsigned)txEngineChannels());
+  }
   UART.println(F("[IR] pronto. Digite HELP."));
 }
 
 void loop() {
-  doREC();
-  while (UART.available()) {
-    int c = UART.read();
-    if (c == '\r') continue;
-    if (c == '\n') {
-      asciiBuf[(asciiLen < sizeof(asciiBuf)-1) ? asciiLen : sizeof(asciiBuf)-1] = 0;
-      handleAsciiLine(asciiBuf);
-      asciiLen = 0;
-    } else if (asciiLen < sizeof(asciiBuf) - 1) {
-      asciiBuf[asciiLen++] = (char)c;
-    }
+  if (capActive) capFlush(false);
+  else doREC();
+
+  uint8_t buf[64];
+  int avail;
+  while ((avail = UART.available()) > 0) {
+    size_t n = UART.read(buf, (avail < (int)sizeof(buf)) ? (size_t)avail : sizeof(buf));
+    irCoreFeed(buf, n);
   }
+
+  // Passos das macros (MACRO RUN) vencidos
+  irCorePoll();
+
+  idleSleep();
 }
@@ -0,0 +1,218 @@
+#include "tx_engine.h"
+
+#include <Arduino.h>
+#include <driver/rmt.h>
+#include <esp_timer.h>
+
+// ====== Configuração RMT ======
+#define RMT_CLK_DIV        80                  // 80 MHz / 80 = 1 tick por µs
+#define RMT_SRC_CLK_HZ     80000000UL          // portadora é gerada a partir do APB
+#define RMT_MAX_DURATION   0x7FFF              // 15 bits por meia-entrada
+#define TX_ITEMS_MAX       257                 // 256 fatias + item final
+
+// Padrões do upload em partes (até MAX_UPLOAD_COUNT fatias) não cabem no
+// buffer do canal: há um único buffer longo, do último canal que o usou.
+// Enquanto esse canal transmite, outro padrão longo é recusado: esperar
+// até 2 s aqui prenderia o loop (ABORT, SYNC, TX_AT).
+// Além de uma meia-entrada por fatia, as quebras em RMT_MAX_DURATION somam
+// no máximo MAX_XMIT_TIME_US / RMT_MAX_DURATION meias-entradas.
+#define TX_LONG_ITEMS      ((MAX_UPLOAD_COUNT + MAX_XMIT_TIME_US / RMT_MAX_DURATION + 1) / 2 + 2)
+
+// TX_AT: o esp_timer acorda o callback um pouco antes e o resto é esperado
+// em laço, porque a tarefa do esp_timer tem dezenas de µs de latência
+#define TX_AT_EARLY_US     300
+
+struct TxChannel {
+  rmt_channel_t rmt;
+  bool ready;
+  uint32_t freqHz;        // pedida
+  uint8_t dutyPct;
+  uint32_t actualHz;      // gerada de fato
+  rmt_item32_t items[TX_ITEMS_MAX];
+  esp_timer_handle_t atTimer;   // disparo do TX_AT
+  uint16_t atItems;             // itens já montados para ele
+  int64_t atUs;
+  volatile bool armed;
+  volatile int64_t firedUs;
+};
+
+static TxChannel channels[IR_TX_CHANNELS];
+static uint8_t channelCount = 0;
+
+static rmt_item32_t longItems[TX_LONG_ITEMS];
+static int8_t longOwner = -1;   // canal transmitindo de longItems (-1 = nenhum ainda)
+
+// Programa período e duty da portadora direto em ticks do APB. A resolução
+// é de 12,5 ns: 36,7 kHz sai com erro de ~3 Hz e 455 kHz com ~0,1%.
+static void setCarrier(TxChannel& c, uint32_t freqHz, uint8_t dutyPct) {
+  if (c.freqHz == freqHz && c.dutyPct == dutyPct) return;
+  uint32_t period = (RMT_SRC_CLK_HZ + freqHz / 2) / freqHz;
+  uint32_t high = (period * dutyPct + 50) / 100;
+  if (high == 0) high = 1;
+  if (high >= period) high = period - 1;
+  uint32_t low = period - high;
+  // Registradores de 16 bits: abaixo de ~1 kHz a portadora satura
+  if (high > 0xFFFF) high = 0xFFFF;
+  if (low > 0xFFFF) low = 0xFFFF;
+  rmt_set_tx_carrier(c.rmt, true, (uint16_t)high, (uint16_t)low, RMT_CARRIER_LEVEL_HIGH);
+  c.freqHz = freqHz;
+  c.dutyPct = dutyPct;
+  c.actualHz = RMT_SRC_CLK_HZ / (high + low);
+}
+
+// Converte µs on/off em itens RMT (duas meias-entradas por item).
+// Retorna o número de itens, ou 0 se não couber nos max itens do buffer.
+static uint16_t buildItems(rmt_item32_t* items, uint16_t max, const uint16_t* us, uint16_t n) {
+  uint16_t half = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    uint32_t d = us[i];
+    uint32_t level = (i % 2 == 0) ? 1 : 0;   // começa em ON
+    while (d > 0) {
+      uint32_t piece = (d > RMT_MAX_DURATION) ? RMT_MAX_DURATION : d;
+      if (half / 2 >= max - 1) return 0;
+      rmt_item32_t& it = items[half / 2];
+      if (half % 2 == 0) {
+        it.level0 = level; it.duration0 = piece;
+        it.level1 = 0;     it.duration1 = 0;
+      } else {
+        it.level1 = level; it.duration1 = piece;
+      }
+      half++;
+      d -= piece;
+    }
+  }
+  // Item zerado marca o fim da transmissão
+  uint16_t count = (half + 1) / 2;
+  items[count].val = 0;
+  return count + 1;
+}
+
+// Callback do esp_timer (tarefa de alta prioridade): espera o instante
+// exato e escreve os itens montados no txEngineStartAt
+static void fireAt(void* arg) {
+  TxChannel& c = *(TxChannel*)arg;
+  while (esp_timer_get_time() < c.atUs) {}
+  c.firedUs = esp_timer_get_time();
+  rmt_write_items(c.rmt, c.items, c.atItems, false);
+  c.armed = false;
+}
+
+bool txEngineBegin(const uint8_t* pins, uint8_t count) {
+  if (count > IR_TX_CHANNELS) count = IR_TX_CHANNELS;
+
+  for (uint8_t i = 0; i < count; i++) {
+    TxChannel& c = channels[i];
+    c.rmt = (rmt_channel_t)(RMT_CHANNEL_0 + i);
+
+    rmt_config_t cfg = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pins[i], c.rmt);
+    cfg.clk_div = RMT_CLK_DIV;
+    cfg.tx_config.carrier_en = true;
+    cfg.tx_config.carrier_freq_hz = 38000;
+    cfg.tx_config.carrier_duty_percent = TX_DEFAULT_DUTY;
+    cfg.tx_config.carrier_level = RMT_CARRIER_LEVEL_HIGH;
+    cfg.tx_config.idle_output_en = true;
+    cfg.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+
+    if (rmt_config(&cfg) != ESP_OK || rmt_driver_install(c.rmt, 0, 0) != ESP_OK) return false;
+    c.freqHz = 0;
+    setCarrier(c, 38000, TX_DEFAULT_DUTY);
+
+    esp_timer_create_args_t targs = {};
+    targs.callback = fireAt;
+    targs.arg = &c;
+    targs.dispatch_method = ESP_TIMER_TASK;
+    targs.name = "tx_at";
+    if (esp_timer_create(&targs, &c.atTimer) != ESP_OK) return false;
+    c.armed = false;
+    c.ready = true;
+    channelCount = i + 1;
+  }
+  return true;
+}
+
+uint8_t txEngineChannels() {
+  return channelCount;
+}
+
+uint32_t txEngineCarrierHz(uint8_t ch) {
+  return (ch < channelCount) ? channels[ch].actualHz : 0;
+}
+
+bool txEngineBusy(uint8_t ch) {
+  if (ch >= channelCount) return false;
+  return rmt_wait_tx_done(channels[ch].rmt, 0) != ESP_OK;
+}
+
+void txEngineWait(uint8_t ch) {
+  if (ch >= channelCount) return;
+  rmt_wait_tx_done(channels[ch].rmt, portMAX_DELAY);
+}
+
+// No ESP32 o rmt_tx_stop grava um item de fim na RAM do canal: o RMT para
+// ali e a interrupção de fim libera o canal como numa transmissão completa.
+void txEngineStop(uint8_t ch) {
+  if (ch >= channelCount || !txEngineBusy(ch)) return;
+  rmt_tx_stop(channels[ch].rmt);
+  rmt_wait_tx_done(channels[ch].rmt, pdMS_TO_TICKS(10));
+}
+
+bool txEngineLongBusy(uint8_t ch) {
+  return longOwner >= 0 && longOwner != ch && txEngineBusy((uint8_t)longOwner);
+}
+
+bool txEngineStart(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n) {
+  if (ch >= channelCount || !channels[ch].ready) return false;
+  if (freqHz < TX_CARRIER_MIN_HZ || freqHz > TX_CARRIER_MAX_HZ) return false;
+  if (dutyPct == 0 || dutyPct >= 100) return false;
+  TxChannel& c = channels[ch];
+  if (c.armed) return false;
+
+  // O driver RMT lê os itens durante a transmissão: não dá para reescrever antes do fim
+  txEngineWait(ch);
+
+  rmt_item32_t* items = c.items;
+  uint16_t count = buildItems(c.items, TX_ITEMS_MAX, us, n);
+  if (count == 0) {
+    // Não coube no do canal: vai para o longo, se o dono atual já terminou
+    if (txEngineLongBusy(ch)) return false;
+    longOwner = (int8_t)ch;
+    items = longItems;
+    count = buildItems(longItems, TX_LONG_ITEMS, us, n);
+    if (count == 0) return false;
+  }
+
+  setCarrier(c, freqHz, dutyPct);
+  return rmt_write_items(c.rmt, items, count, false) == ESP_OK;
+}
+
+bool txEngineStartAt(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n,
+                     int64_t atUs) {
+  if (ch >= channelCount || !channels[ch].ready) return false;
+  if (freqHz < TX_CARRIER_MIN_HZ || freqHz > TX_CARRIER_MAX_HZ) return false;
+  if (dutyPct == 0 || dutyPct >= 100) return false;
+  TxChannel& c = channels[ch];
+  if (c.armed) return false;
+
+  txEngineWait(ch);
+  uint16_t items = buildItems(c.items, TX_ITEMS_MAX, us, n);
+  if (items == 0) return false;
+  setCarrier(c, freqHz, dutyPct);
+
+  c.atItems = items;
+  c.atUs = atUs;
+  c.armed = true;
+  int64_t delay = atUs - TX_AT_EARLY_US - esp_timer_get_time();
+  if (esp_timer_start_once(c.atTimer, (delay > 0) ? (uint64_t)delay : 1) != ESP_OK) {
+    c.armed = false;
+    return false;
+  }
+  return true;
+}
+
+bool txEngineArmed(uint8_t ch) {
+  return ch < channelCount && channels[ch].armed;
+}
+
+int64_t txEngineFiredUs(uint8_t ch) {
+  return (ch < channelCount) ? channels[ch].firedUs : 0;
+}
@@ -0,0 +1,328 @@
+#include "emu_port.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "ir_core.h"
+#include "ir_port.h"
+
+#define EMU_TX_CHANNELS 4
+#define CAP_SYNC        0xA5
+#define CAP_CHUNK_MAX   64
+
+EmuFaults emuFaults;
+std::mutex emuCoreLock;
+
+struct Reply {
+  int64_t dueUs;
+  std::string data;
+};
+
+// Fila do bulk IN: respostas dos comandos e quadros da captura, em ordem
+static std::mutex qLock;
+static std::condition_variable qCond;
+static std::deque<Reply> queue;
+static bool stopping = false;
+
+// Saída do comando corrente; só quem segura emuCoreLock escreve
+static std::string cur;
+
+static std::mt19937 rng(std::random_device{}());
+static uint32_t carrierHz[EMU_TX_CHANNELS];
+
+// Console: bulk OUT -> núcleo
+static std::mutex inLock;
+static std::condition_variable inCond;
+static std::string input;
+
+// Fim da transmissão simulada em cada canal
+static int64_t txBusyUntil[EMU_TX_CHANNELS];
+// TX_AT: instante armado de cada canal (0 = nenhum)
+static int64_t txArmedAt[EMU_TX_CHANNELS];
+
+static std::atomic<bool> capOn(false);
+static std::mutex capLock;          // gerador x CAP STOP
+static uint32_t capTotal = 0;
+
+int64_t emuNowUs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Chamar com qLock
+static bool roll(int pct) {
+  return pct > 0 && (int)(rng() % 100) < pct;
+}
+
+static void enqueue(int64_t dueUs, std::string data) {
+  {
+    std::lock_guard<std::mutex> g(qLock);
+    queue.push_back({ dueUs, std::move(data) });
+  }
+  qCond.notify_all();
+}
+
+void emuReplyCommit() {
+  if (cur.empty()) return;
+  std::string out;
+  out.swap(cur);
+
+  // rng é compartilhado com a thread do bulk IN
+  std::unique_lock<std::mutex> g(qLock);
+  if (roll(emuFaults.dropPct)) {
+    if (emuFaults.verbose) fprintf(stderr, "emu: resposta descartada: %s", out.c_str());
+    return;
+  }
+  if (roll(emuFaults.errPct)) out = "[ERR] injetado\n";
+  if (roll(emuFaults.noisePct)) out.insert(0, "[DBG] ruido injetado\n");
+  if (emuFaults.verbose) fprintf(stderr, "emu: < %s", out.c_str());
+
+  int64_t delayUs = (int64_t)emuFaults.latencyMs * 1000;
+  if (emuFaults.jitterMs > 0) delayUs += rng() % ((uint32_t)emuFaults.jitterMs * 1000 + 1);
+  queue.push_back({ emuNowUs() + delayUs, std::move(out) });
+  g.unlock();
+  qCond.notify_all();
+}
+
+bool emuReplyNext(std::string* out) {
+  std::unique_lock<std::mutex> g(qLock);
+  for (;;) {
+    if (stopping) return false;
+    if (queue.empty()) { qCond.wait(g); continue; }
+    int64_t wait = queue.front().dueUs - emuNowUs();
+    if (wait <= 0) break;
+    qCond.wait_for(g, std::chrono::microseconds(wait));
+  }
+
+  // Pedaço de 1..frag bytes; o resto da resposta espera fragGapUs
+  Reply& r = queue.front();
+  size_t maxLen = (emuFaults.frag > 1) ? (size_t)emuFaults.frag : 1;
+  size_t len = (maxLen < r.data.size()) ? 1 + rng() % maxLen : r.data.size();
+  out->assign(r.data, 0, len);
+  r.data.erase(0, len);
+  if (r.data.empty()) queue.pop_front();
+  else r.dueUs = emuNowUs() + emuFaults.fragGapUs;
+  return true;
+}
+
+void emuReplyDiscard() {
+  cur.clear();
+  std::lock_guard<std::mutex> g(qLock);
+  queue.clear();
+}
+
+void emuStop() {
+  {
+    std::lock_guard<std::mutex> g(qLock);
+    stopping = true;
+  }
+  qCond.notify_all();
+  {
+    std::lock_guard<std::mutex> g(inLock);
+  }
+  inCond.notify_all();
+}
+
+void emuInput(const uint8_t* data, size_t len) {
+  {
+    std::lock_guard<std::mutex> g(inLock);
+    input.append((const char*)data, len);
+  }
+  inCond.notify_all();
+}
+
+void emuCoreLoop() {
+  std::string chunk;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> g(inLock);
+      inCond.wait(g, [] {
+        std::lock_guard<std::mutex> q(qLock);
+        return stopping || !input.empty();
+      });
+      if (input.empty()) return;
+      chunk.swap(input);
+      input.clear();
+    }
+    std::lock_guard<std::mutex> g(emuCoreLock);
+    irCoreFeed((const uint8_t*)chunk.data(), chunk.size());
+    emuReplyCommit();
+  }
+}
+
+void emuPollLoop() {
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    {
+      std::lock_guard<std::mutex> g(qLock);
+      if (stopping) return;
+    }
+    std::lock_guard<std::mutex> g(emuCoreLock);
+    irCorePoll();
+    emuReplyCommit();
+  }
+}
+
+// ====== Captura contínua sintética ======
+static void capPushEntry(std::vector<uint16_t>& v, bool mark, uint32_t us) {
+  while (us > 0) {
+    uint16_t piece = (us > 0x7FFF) ? 0x7FFF : (uint16_t)us;
+    v.push_back((mark ? 0x8000 : 0) | piece);
+    us -= piece;
+  }
+}
+
+void emuCapLoop(int periodMs) {
+  std::vector<uint16_t> entries;
+  uint32_t code = 0x20DF10EF;
+
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(periodMs));
+    {
+      std::lock_guard<std::mutex> g(qLock);
+      if (stopping) return;
+    }
+    std::lock_guard<std::mutex> g(capLock);
+    if (!capOn) continue;
+
+    // NEC completo seguido do silêncio até o próximo período
+    entries.clear();
+    uint32_t total = 9000 + 4500 + 560;
+    capPushEntry(entries, true, 9000);
+    capPushEntry(entries, false, 4500);
+    for (int b = 31; b >= 0; b--) {
+      uint32_t space = ((code >> b) & 1) ? 1690 : 560;
+      capPushEntry(entries, true, 560);
+      capPushEntry(entries, false, space);
+      total += 560 + space;
+    }
+    capPushEntry(entries, true, 560);
+    uint32_t periodUs = (uint32_t)periodMs * 1000;
+    capPushEntry(entries, false, (periodUs > total) ? periodUs - total : 1000);
+
+    std::string frames;
+    for (size_t i = 0; i < entries.size(); i += CAP_CHUNK_MAX) {
+      size_t n = std::min(entries.size() - i, (size_t)CAP_CHUNK_MAX);
+      frames += (char)CAP_SYNC;
+      frames += (char)n;
+      for (size_t k = 0; k < n; k++) {
+        frames += (char)(entries[i + k] & 0xFF);
+        frames += (char)(entries[i + k] >> 8);
+      }
+    }
+    capTotal += entries.size();
+    enqueue(emuNowUs(), std::move(frames));
+  }
+}
+
+// ====== Porta do núcleo (ir_port.h) ======
+void portWrite(const char* data, size_t len) {
+  cur.append(data, len);
+}
+
+int64_t portNowUs() {
+  return emuNowUs();
+}
+
+uint8_t portTxChannels() {
+  return EMU_TX_CHANNELS;
+}
+
+// Chamado só pelo núcleo, com emuCoreLock
+size_t portRead(uint8_t* buf, size_t max) {
+  std::lock_guard<std::mutex> g(inLock);
+  size_t n = std::min(input.size(), max);
+  memcpy(buf, input.data(), n);
+  input.erase(0, n);
+  return n;
+}
+
+// O canal fica ocupado pela duração do padrão, como o RMT do firmware
+bool portTransmit(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n) {
+  (void)dutyPct;
+  if (ch >= EMU_TX_CHANNELS) return false;
+  carrierHz[ch] = freqHz;
+  int64_t total = 0;
+  if (emuFaults.txTime) {
+    for (uint16_t i = 0; i < n; i++) total += us[i];
+  }
+  txBusyUntil[ch] = emuNowUs() + total;
+  return true;
+}
+
+// O núcleo espera o canal 0 consultando aqui: cede a CPU entre as consultas
+bool portTxBusy(uint8_t ch) {
+  if (ch >= EMU_TX_CHANNELS || emuNowUs() >= txBusyUntil[ch]) return false;
+  std::this_thread::sleep_for(std::chrono::microseconds(100));
+  return true;
+}
+
+// Cada canal do emulador tem buffer próprio para qualquer padrão
+bool portTxLongBusy(uint8_t ch) {
+  (void)ch;
+  return false;
+}
+
+void portTxStop(uint8_t ch) {
+  if (ch < EMU_TX_CHANNELS) txBusyUntil[ch] = 0;
+}
+
+// O disparo é exato: o canal fica ocupado de atUs até o fim do padrão
+bool portTransmitAt(uint8_t ch, uint32_t freqHz, uint8_t dutyPct, const uint16_t* us, uint16_t n,
+                    int64_t atUs) {
+  if (!portTransmit(ch, freqHz, dutyPct, us, n)) return false;
+  txBusyUntil[ch] += atUs - emuNowUs();
+  txArmedAt[ch] = atUs;
+  return true;
+}
+
+bool portTxArmed(uint8_t ch) {
+  return ch < EMU_TX_CHANNELS && emuNowUs() < txArmedAt[ch];
+}
+
+int64_t portTxFiredUs(uint8_t ch) {
+  return (ch < EMU_TX_CHANNELS) ? txArmedAt[ch] : 0;
+}
+
+uint32_t portCarrierHz(uint8_t ch) {
+  return (ch < EMU_TX_CHANNELS) ? carrierHz[ch] : 0;
+}
+
+void portShow(const char* l1, const char* l2, const char* l3, uint16_t packets) {
+  (void)l1; (void)l2; (void)l3; (void)packets;
+}
+
+void portCapStart() {
+  if (capOn) { irPrintln("[ERR] CAP ja ativa"); return; }
+  // O [OK] sai antes do primeiro quadro, como no firmware
+  irPrintln("[OK] CAP START");
+  emuReplyCommit();
+  std::lock_guard<std::mutex> g(capLock);
+  capTotal = 0;
+  capOn = true;
+}
+
+void portCapStop() {
+  if (!capOn) { irPrintln("[ERR] CAP nao ativa"); return; }
+  uint32_t total;
+  {
+    std::lock_guard<std::mutex> g(capLock);
+    capOn = false;
+    total = capTotal;
+  }
+  enqueue(emuNowUs(), std::string("\xA5\x00", 2));
+  irPrintf("[OK] CAP STOP n=%lu ovf=0\n", (unsigned long)total);
+}
+
+bool portCapActive() {
+  return capOn;
+}
@@ -0,0 +1,58 @@
+// Porta do núcleo de comandos (hardware/lib/ir_core) para o emulador:
+// a saída da console vira uma fila de respostas entregue pelo bulk IN do
+// gadget, com atraso, fragmentação e falhas injetadas.
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+struct EmuFaults {
+  int latencyMs = 0;     // atraso fixo de cada resposta
+  int jitterMs = 0;      // + atraso uniforme em [0, jitter]
+  int frag = 64;         // maior pedaço por pacote do bulk IN (1..64)
+  int fragGapUs = 0;     // pausa entre pedaços da mesma resposta
+  int dropPct = 0;       // % de respostas descartadas (o driver vê timeout)
+  int errPct = 0;        // % de respostas trocadas por "[ERR] injetado"
+  int noisePct = 0;      // % de respostas precedidas por uma linha [DBG]
+  bool txTime = true;    // TX no canal 0 bloqueia pela duração do padrão
+  bool verbose = false;  // imprime comandos e respostas no stderr
+};
+
+extern EmuFaults emuFaults;
+
+// O núcleo não é reentrante: o laço dos comandos e o das macros o chamam
+// sob esta trava, como o loop() único do firmware.
+extern std::mutex emuCoreLock;
+
+// Bytes do bulk OUT. Ficam numa fila como na UART: o laço dos comandos os
+// entrega ao núcleo e, com o canal 0 ocupado, o próprio núcleo os lê
+// (portRead) para ver um ABORT no meio do TX.
+void emuInput(const uint8_t* data, size_t len);
+
+// Faz o papel do loop() do firmware para a console: irCoreFeed() com o
+// que chegou e a resposta agendada para o bulk IN.
+void emuCoreLoop();
+
+// Fecha a resposta do comando corrente e a agenda para o bulk IN,
+// aplicando latência, jitter e as falhas configuradas.
+void emuReplyCommit();
+
+// Próximo trecho para o bulk IN, já respeitando o atraso agendado.
+// Bloqueia até haver dados; retorna false depois de emuStop().
+bool emuReplyNext(std::string* out);
+
+// Descarta a saída gerada até aqui (ex.: o REC semeado antes do host)
+void emuReplyDiscard();
+
+void emuStop();
+
+// Faz o papel do loop() do firmware para o trabalho temporizado do
+// núcleo (passos das macros): irCorePoll() a cada milissegundo.
+void emuPollLoop();
+
+// Gerador da captura contínua: enquanto CAP START estiver ativa, enfileira
+// quadros binários 0xA5 <n> <u16...> com um NEC sintético a cada período.
+void emuCapLoop(int periodMs);
+
+int64_t emuNowUs();
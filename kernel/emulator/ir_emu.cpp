@@ -0,0 +1,364 @@
+// Emulador do conjunto CP2102 + ESP32 em userspace, para exercitar o
+// ir_remote.ko sem a placa.
+//
+// Usa o raw-gadget sobre o dummy_hcd: o host enxerga um dispositivo USB
+// 10C4:EA60 com uma interface vendor e dois endpoints bulk de 64 bytes,
+// responde às requisições vendor do ir_config_serial() (IFC_ENABLE,
+// SET_BAUDRATE) e fala o protocolo do firmware usando o próprio núcleo
+// de comandos (hardware/lib/ir_core). Latência, jitter, fragmentação e
+// falhas das respostas são configuráveis (emu_port.h).
+//
+//   modprobe dummy_hcd raw_gadget && rmmod cp210x   (o cp210x pegaria o VID/PID)
+//   ./ir_emu -l 5 -j 20 -f 7 -d 1 &
+//   insmod ../ir_remote.ko
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/usb/ch9.h>
+#include <linux/usb/raw_gadget.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+
+#include "emu_port.h"
+#include "ir_core.h"
+
+#define EMU_VENDOR_ID   0x10C4
+#define EMU_PRODUCT_ID  0xEA60
+#define EMU_MAXPACKET   64
+
+// Requisições vendor do CP210x usadas pelo driver
+#define CP210X_IFC_ENABLE    0x00
+#define CP210X_SET_BAUDRATE  0x1E
+
+#define EP0_MAX_DATA    256
+
+static int gadgetFd = -1;
+static int epIn = -1, epOut = -1;
+static uint8_t epInAddr = 0x81, epOutAddr = 0x02;
+static int capPeriodMs = 100;
+
+static const char* const STRINGS[] = {
+  nullptr,                                       // 0: idiomas
+  "Silicon Labs",
+  "CP2102 USB to UART Bridge Controller",
+  "0001",
+};
+
+// ====== Descritores ======
+static struct usb_device_descriptor devDesc;
+static uint8_t configDesc[USB_DT_CONFIG_SIZE + USB_DT_INTERFACE_SIZE + 2 * USB_DT_ENDPOINT_SIZE];
+
+static void buildDescriptors() {
+  devDesc.bLength = USB_DT_DEVICE_SIZE;
+  devDesc.bDescriptorType = USB_DT_DEVICE;
+  devDesc.bcdUSB = 0x0200;
+  devDesc.bDeviceClass = 0;
+  devDesc.bMaxPacketSize0 = EMU_MAXPACKET;
+  devDesc.idVendor = EMU_VENDOR_ID;
+  devDesc.idProduct = EMU_PRODUCT_ID;
+  devDesc.bcdDevice = 0x0100;
+  devDesc.iManufacturer = 1;
+  devDesc.iProduct = 2;
+  devDesc.iSerialNumber = 3;
+  devDesc.bNumConfigurations = 1;
+
+  struct usb_config_descriptor* c = (struct usb_config_descriptor*)configDesc;
+  c->bLength = USB_DT_CONFIG_SIZE;
+  c->bDescriptorType = USB_DT_CONFIG;
+  c->wTotalLength = sizeof(configDesc);
+  c->bNumInterfaces = 1;
+  c->bConfigurationValue = 1;
+  c->bmAttributes = USB_CONFIG_ATT_ONE;
+  c->bMaxPower = 50;                             // 100 mA
+
+  struct usb_interface_descriptor* i = (struct usb_interface_descriptor*)(configDesc + USB_DT_CONFIG_SIZE);
+  i->bLength = USB_DT_INTERFACE_SIZE;
+  i->bDescriptorType = USB_DT_INTERFACE;
+  i->bNumEndpoints = 2;
+  i->bInterfaceClass = USB_CLASS_VENDOR_SPEC;
+  i->iInterface = 2;
+
+  uint8_t* e = configDesc + USB_DT_CONFIG_SIZE + USB_DT_INTERFACE_SIZE;
+  for (int k = 0; k < 2; k++, e += USB_DT_ENDPOINT_SIZE) {
+    struct usb_endpoint_descriptor* ep = (struct usb_endpoint_descriptor*)e;
+    ep->bLength = USB_DT_ENDPOINT_SIZE;
+    ep->bDescriptorType = USB_DT_ENDPOINT;
+    ep->bEndpointAddress = k ? epOutAddr : epInAddr;
+    ep->bmAttributes = USB_ENDPOINT_XFER_BULK;
+    ep->wMaxPacketSize = EMU_MAXPACKET;
+  }
+}
+
+// Descritor de string em UTF-16LE (só ASCII aqui)
+static int stringDesc(uint8_t index, uint8_t* out) {
+  if (index == 0) {
+    out[0] = 4; out[1] = USB_DT_STRING; out[2] = 0x09; out[3] = 0x04;   // en-US
+    return 4;
+  }
+  if (index >= sizeof(STRINGS) / sizeof(STRINGS[0])) return -1;
+  int n = 2;
+  for (const char* p = STRINGS[index]; *p && n < EP0_MAX_DATA - 1; p++) {
+    out[n++] = (uint8_t)*p;
+    out[n++] = 0;
+  }
+  out[0] = (uint8_t)n;
+  out[1] = USB_DT_STRING;
+  return n;
+}
+
+// ====== raw-gadget ======
+// Os cabeçalhos do raw-gadget terminam em array flexível: o espaço dos
+// dados fica logo depois, no mesmo buffer alinhado
+template <typename Head, size_t N>
+struct RawBuf {
+  alignas(8) uint8_t bytes[sizeof(Head) + N];
+  Head* head() { return (Head*)bytes; }
+  uint8_t* data() { return bytes + sizeof(Head); }
+};
+
+struct EpIo : RawBuf<struct usb_raw_ep_io, EP0_MAX_DATA> {
+  struct usb_raw_ep_io* set(int ep, size_t len) {
+    head()->ep = ep;
+    head()->flags = 0;
+    head()->length = len;
+    return head();
+  }
+};
+
+typedef RawBuf<struct usb_raw_event, sizeof(struct usb_ctrlrequest)> CtrlEvent;
+
+static void die(const char* what) {
+  perror(what);
+  exit(1);
+}
+
+// Escolhe os endpoints bulk que o UDC oferece (no dummy_udc: ep1in/ep2out)
+static void pickEndpoints() {
+  struct usb_raw_eps_info info;
+  memset(&info, 0, sizeof(info));
+  int n = ioctl(gadgetFd, USB_RAW_IOCTL_EPS_INFO, &info);
+  if (n < 0) die("USB_RAW_IOCTL_EPS_INFO");
+  bool haveIn = false, haveOut = false;
+  for (int i = 0; i < n; i++) {
+    const struct usb_raw_ep_info& ep = info.eps[i];
+    if (!ep.caps.type_bulk || ep.addr == USB_RAW_EP_ADDR_ANY) continue;
+    if (!haveIn && ep.caps.dir_in && !ep.caps.dir_out) { epInAddr = USB_DIR_IN | ep.addr; haveIn = true; }
+    if (!haveOut && ep.caps.dir_out && !ep.caps.dir_in) { epOutAddr = ep.addr; haveOut = true; }
+  }
+}
+
+static void ep0Write(const void* data, int len) {
+  EpIo e;
+  memcpy(e.data(), data, len);
+  if (ioctl(gadgetFd, USB_RAW_IOCTL_EP0_WRITE, e.set(0, len)) < 0) perror("USB_RAW_IOCTL_EP0_WRITE");
+}
+
+// Fase de dados OUT (ou só o status, com len = 0)
+static int ep0Read(void* data, int len) {
+  EpIo e;
+  int ret = ioctl(gadgetFd, USB_RAW_IOCTL_EP0_READ, e.set(0, len));
+  if (ret < 0) { perror("USB_RAW_IOCTL_EP0_READ"); return ret; }
+  if (data && ret > 0) memcpy(data, e.data(), ret);
+  return ret;
+}
+
+static void ep0Stall() {
+  if (ioctl(gadgetFd, USB_RAW_IOCTL_EP0_STALL, 0) < 0) perror("USB_RAW_IOCTL_EP0_STALL");
+}
+
+// Comandos do host: cada pacote vai para a fila da console (emuCoreLoop
+// os entrega ao núcleo e agenda a resposta no bulk IN)
+static void bulkOutLoop() {
+  EpIo e;
+  for (;;) {
+    int n = ioctl(gadgetFd, USB_RAW_IOCTL_EP_READ, e.set(epOut, EMU_MAXPACKET));
+    if (n < 0) { perror("bulk OUT"); break; }
+    if (emuFaults.verbose) fprintf(stderr, "emu: > %.*s", n, (const char*)e.data());
+    emuInput(e.data(), n);
+  }
+  emuStop();
+}
+
+static void bulkInLoop() {
+  EpIo e;
+  std::string chunk;
+  while (emuReplyNext(&chunk)) {
+    memcpy(e.data(), chunk.data(), chunk.size());
+    if (ioctl(gadgetFd, USB_RAW_IOCTL_EP_WRITE, e.set(epIn, chunk.size())) < 0) { perror("bulk IN"); break; }
+  }
+}
+
+static void setConfiguration() {
+  if (epIn < 0) {
+    const uint8_t* e = configDesc + USB_DT_CONFIG_SIZE + USB_DT_INTERFACE_SIZE;
+    epIn = ioctl(gadgetFd, USB_RAW_IOCTL_EP_ENABLE, e);
+    epOut = ioctl(gadgetFd, USB_RAW_IOCTL_EP_ENABLE, e + USB_DT_ENDPOINT_SIZE);
+    if (epIn < 0 || epOut < 0) die("USB_RAW_IOCTL_EP_ENABLE");
+    std::thread(bulkOutLoop).detach();
+    std::thread(emuCoreLoop).detach();
+    std::thread(bulkInLoop).detach();
+    std::thread(emuCapLoop, capPeriodMs).detach();
+    std::thread(emuPollLoop).detach();
+  }
+  if (ioctl(gadgetFd, USB_RAW_IOCTL_VBUS_DRAW, 50) < 0) perror("USB_RAW_IOCTL_VBUS_DRAW");
+  if (ioctl(gadgetFd, USB_RAW_IOCTL_CONFIGURE, 0) < 0) die("USB_RAW_IOCTL_CONFIGURE");
+  fprintf(stderr, "emu: configurado (IN 0x%02x, OUT 0x%02x)\n", epInAddr, epOutAddr);
+}
+
+static void handleControl(const struct usb_ctrlrequest& c) {
+  uint8_t buf[EP0_MAX_DATA];
+  uint16_t wLength = c.wLength;
+  int len;
+
+  switch (c.bRequestType & USB_TYPE_MASK) {
+  case USB_TYPE_STANDARD:
+    if (c.bRequest == USB_REQ_GET_DESCRIPTOR) {
+      switch (c.wValue >> 8) {
+      case USB_DT_DEVICE:
+        ep0Write(&devDesc, std::min<int>(wLength, sizeof(devDesc)));
+        return;
+      case USB_DT_CONFIG:
+        ep0Write(configDesc, std::min<int>(wLength, sizeof(configDesc)));
+        return;
+      case USB_DT_STRING:
+        len = stringDesc(c.wValue & 0xFF, buf);
+        if (len < 0) break;
+        ep0Write(buf, std::min<int>(wLength, len));
+        return;
+      }
+      break;   // DEVICE_QUALIFIER etc.: só full speed, como o CP2102
+    }
+    if (c.bRequest == USB_REQ_SET_CONFIGURATION) {
+      setConfiguration();
+      ep0Read(nullptr, 0);
+      return;
+    }
+    if (c.bRequest == USB_REQ_SET_INTERFACE) {
+      ep0Read(nullptr, 0);
+      return;
+    }
+    if (c.bRequest == USB_REQ_GET_STATUS) {
+      buf[0] = 0; buf[1] = 0;
+      ep0Write(buf, std::min<int>(wLength, 2));
+      return;
+    }
+    break;
+
+  case USB_TYPE_VENDOR:
+    if (c.bRequestType & USB_DIR_IN) {
+      // Leituras de estado do CP210x (GET_LINE_CTL, GET_MDMSTS...): zeros
+      len = std::min<int>(wLength, sizeof(buf));
+      memset(buf, 0, len);
+      ep0Write(buf, len);
+      return;
+    }
+    len = ep0Read(buf, std::min<int>(wLength, sizeof(buf)));
+    if (c.bRequest == CP210X_IFC_ENABLE)
+      fprintf(stderr, "emu: IFC_ENABLE %u\n", c.wValue);
+    else if (c.bRequest == CP210X_SET_BAUDRATE && len == 4)
+      fprintf(stderr, "emu: SET_BAUDRATE %u\n", buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24);
+    else if (emuFaults.verbose)
+      fprintf(stderr, "emu: vendor 0x%02x ignorado\n", c.bRequest);
+    return;
+  }
+
+  if (emuFaults.verbose)
+    fprintf(stderr, "emu: stall em 0x%02x/0x%02x\n", c.bRequestType, c.bRequest);
+  ep0Stall();
+}
+
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "uso: %s [opcoes]\n"
+          "  -l ms    latencia de cada resposta (0)\n"
+          "  -j ms    jitter uniforme somado a latencia (0)\n"
+          "  -f n     maior pedaco por pacote do bulk IN, 1..64 (64)\n"
+          "  -g us    pausa entre pedacos da mesma resposta (0)\n"
+          "  -d pct   respostas descartadas (0)\n"
+          "  -e pct   respostas trocadas por [ERR] (0)\n"
+          "  -n pct   respostas precedidas por uma linha [DBG] (0)\n"
+          "  -T       TX responde na hora, sem esperar a duracao do padrao\n"
+          "  -c ms    periodo do NEC sintetico na captura continua (100)\n"
+          "  -u udc   driver do UDC (dummy_udc)\n"
+          "  -D dev   dispositivo do UDC (dummy_udc.0)\n"
+          "  -v       imprime comandos e respostas\n",
+          prog);
+  exit(2);
+}
+
+static int clampArg(const char* s, int lo, int hi) {
+  int v = atoi(s);
+  return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+int main(int argc, char** argv) {
+  const char* udcDriver = "dummy_udc";
+  const char* udcDevice = "dummy_udc.0";
+  int opt;
+
+  while ((opt = getopt(argc, argv, "l:j:f:g:d:e:n:Tc:u:D:v")) != -1) {
+    switch (opt) {
+    case 'l': emuFaults.latencyMs = clampArg(optarg, 0, 10000); break;
+    case 'j': emuFaults.jitterMs  = clampArg(optarg, 0, 10000); break;
+    case 'f': emuFaults.frag      = clampArg(optarg, 1, EMU_MAXPACKET); break;
+    case 'g': emuFaults.fragGapUs = clampArg(optarg, 0, 1000000); break;
+    case 'd': emuFaults.dropPct   = clampArg(optarg, 0, 100); break;
+    case 'e': emuFaults.errPct    = clampArg(optarg, 0, 100); break;
+    case 'n': emuFaults.noisePct  = clampArg(optarg, 0, 100); break;
+    case 'T': emuFaults.txTime = false; break;
+    case 'c': capPeriodMs = clampArg(optarg, 1, 10000); break;
+    case 'u': udcDriver = optarg; break;
+    case 'D': udcDevice = optarg; break;
+    case 'v': emuFaults.verbose = true; break;
+    default: usage(argv[0]);
+    }
+  }
+
+  // Um REC já armazenado, para o LAST_RECV responder desde o início
+  static const uint16_t seed[] = { 9000, 4500, 560, 560, 560, 1690, 560, 560, 560 };
+  irCoreRec(seed, sizeof(seed) / sizeof(seed[0]));
+  emuReplyDiscard();
+
+  gadgetFd = open("/dev/raw-gadget", O_RDWR);
+  if (gadgetFd < 0) die("/dev/raw-gadget");
+
+  struct usb_raw_init init;
+  memset(&init, 0, sizeof(init));
+  snprintf((char*)init.driver_name, UDC_NAME_LENGTH_MAX, "%s", udcDriver);
+  snprintf((char*)init.device_name, UDC_NAME_LENGTH_MAX, "%s", udcDevice);
+  init.speed = USB_SPEED_FULL;
+  if (ioctl(gadgetFd, USB_RAW_IOCTL_INIT, &init) < 0) die("USB_RAW_IOCTL_INIT");
+  if (ioctl(gadgetFd, USB_RAW_IOCTL_RUN, 0) < 0) die("USB_RAW_IOCTL_RUN");
+
+  pickEndpoints();
+  buildDescriptors();
+  signal(SIGPIPE, SIG_IGN);
+  fprintf(stderr, "emu: %04x:%04x em %s, latencia=%d+%d ms frag=%d drop=%d%% err=%d%% ruido=%d%%\n",
+          EMU_VENDOR_ID, EMU_PRODUCT_ID, udcDevice, emuFaults.latencyMs, emuFaults.jitterMs,
+          emuFaults.frag, emuFaults.dropPct, emuFaults.errPct, emuFaults.noisePct);
+
+  for (;;) {
+    CtrlEvent ev;
+    ev.head()->type = 0;
+    ev.head()->length = sizeof(struct usb_ctrlrequest);
+    if (ioctl(gadgetFd, USB_RAW_IOCTL_EVENT_FETCH, ev.head()) < 0) die("USB_RAW_IOCTL_EVENT_FETCH");
+
+    switch (ev.head()->type) {
+    case USB_RAW_EVENT_CONNECT:
+      fprintf(stderr, "emu: conectado\n");
+      break;
+    case USB_RAW_EVENT_CONTROL:
+      handleControl(*(const struct usb_ctrlrequest*)ev.data());
+      break;
+    default:
+      // Kernels novos também avisam reset/suspend/resume: nada a fazer
+      break;
+    }
+  }
+}
@@ -0,0 +1,234 @@
+// Teste de carga do ir_remote.ko pelas interfaces de usuário: várias
+// threads escrevem em /sys/kernel/infrared/transmit (e, opcionalmente,
+// disparam LAST_RECV em receive) pelo tempo pedido; no fim imprime
+// transmissões/s, percentis de latência por escrita e os erros por errno.
+// Com -c, mede uma sessão de captura lendo /dev/ir_capture. Com -I, parte
+// dos TX sai como interativa ("!") e a latência dela é medida à parte:
+// os de fundo cortados por ela aparecem como erro ECANCELED.
+//
+// Serve com a placa de verdade ou com o ir_emu (mesma pasta). As escritas
+// competem pelo ir_lock do driver, então a cauda mostra a contenção.
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <map>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#define SYSFS_DIR     "/sys/kernel/infrared"
+#define DEBUGFS_DIR   "/sys/kernel/debug/ir_remote"
+#define CAPTURE_DEV   "/dev/ir_capture"
+
+static const char* DEFAULT_PATTERN = "38000 9000,4500,560,560,560,1690,560,560,560,1690,560";
+
+struct Options {
+  int threads = 4;
+  int seconds = 10;
+  int recvPct = 0;            // % das operações que são LAST_RECV
+  bool ids = false;           // prefixo "@<hex> " em cada TX
+  int hiPct = 0;              // % dos TX que são interativos ("!")
+  std::string hiPattern;      // vazio = o mesmo do -p
+  int captureSec = 0;
+  std::string pattern = DEFAULT_PATTERN;
+};
+
+struct Result {
+  std::vector<uint32_t> txUs, rxUs, hiUs;     // latência de cada escrita OK
+  std::map<int, uint64_t> errors;             // errno -> contagem
+};
+
+static std::atomic<bool> running(true);
+
+static int64_t nowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Um write por comando, como a HAL faz; sysfs exige o '\n' no fim
+static int writeLine(int fd, const std::string& line) {
+  if (pwrite(fd, line.data(), line.size(), 0) == (ssize_t)line.size()) return 0;
+  return errno ? errno : EIO;
+}
+
+static void worker(const Options& o, int index, Result* r) {
+  int txFd = open(SYSFS_DIR "/transmit", O_WRONLY);
+  int rxFd = open(SYSFS_DIR "/receive", O_WRONLY);
+  if (txFd < 0 || rxFd < 0) {
+    int err = errno;
+    perror(SYSFS_DIR);
+    r->errors[err]++;
+    if (txFd >= 0) close(txFd);
+    if (rxFd >= 0) close(rxFd);
+    return;
+  }
+
+  uint64_t seq = 0;
+  unsigned int seed = (unsigned int)(index * 7919 + nowUs());
+  char prefix[32];
+  while (running) {
+    bool recv = o.recvPct > 0 && (int)(rand_r(&seed) % 100) < o.recvPct;
+    bool hi = !recv && o.hiPct > 0 && (int)(rand_r(&seed) % 100) < o.hiPct;
+    std::string line;
+    if (recv) {
+      line = "LAST_RECV\n";
+    } else {
+      prefix[0] = 0;
+      if (o.ids) snprintf(prefix, sizeof(prefix), "@%x%08llx ", index + 1, (unsigned long long)++seq);
+      line = std::string(hi ? "!" : "") + prefix + ((hi && !o.hiPattern.empty()) ? o.hiPattern : o.pattern) + "\n";
+    }
+
+    int64_t t0 = nowUs();
+    int err = writeLine(recv ? rxFd : txFd, line);
+    uint32_t us = (uint32_t)(nowUs() - t0);
+    if (err) r->errors[err]++;
+    else (recv ? r->rxUs : hi ? r->hiUs : r->txUs).push_back(us);
+  }
+  close(txFd);
+  close(rxFd);
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& v, double p) {
+  if (v.empty()) return 0;
+  size_t i = (size_t)(p / 100.0 * (v.size() - 1) + 0.5);
+  return v[std::min(i, v.size() - 1)];
+}
+
+static void report(const char* name, std::vector<uint32_t>& v, double secs) {
+  std::sort(v.begin(), v.end());
+  if (v.empty()) { printf("%-9s nenhuma escrita com sucesso\n", name); return; }
+  printf("%-9s n=%zu  %.1f/s  p50=%.2f p90=%.2f p99=%.2f p99.9=%.2f max=%.2f ms\n", name,
+         v.size(), v.size() / secs, percentile(v, 50) / 1000.0, percentile(v, 90) / 1000.0,
+         percentile(v, 99) / 1000.0, percentile(v, 99.9) / 1000.0, v.back() / 1000.0);
+}
+
+static void dumpFile(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return;
+  char line[512];
+  printf("--- %s\n", path);
+  while (fgets(line, sizeof(line), f)) fputs(line, stdout);
+  fclose(f);
+}
+
+static void resetDebugfs() {
+  int fd = open(DEBUGFS_DIR "/reset", O_WRONLY);
+  if (fd < 0) return;
+  if (write(fd, "1", 1) < 0) perror(DEBUGFS_DIR "/reset");
+  close(fd);
+}
+
+static int runTransmit(const Options& o) {
+  std::vector<Result> results(o.threads);
+  std::vector<std::thread> threads;
+
+  resetDebugfs();
+  int64_t t0 = nowUs();
+  for (int i = 0; i < o.threads; i++) threads.emplace_back(worker, std::cref(o), i, &results[i]);
+  std::this_thread::sleep_for(std::chrono::seconds(o.seconds));
+  running = false;
+  for (auto& t : threads) t.join();
+  double secs = (nowUs() - t0) / 1e6;
+
+  Result all;
+  for (auto& r : results) {
+    all.txUs.insert(all.txUs.end(), r.txUs.begin(), r.txUs.end());
+    all.rxUs.insert(all.rxUs.end(), r.rxUs.begin(), r.rxUs.end());
+    all.hiUs.insert(all.hiUs.end(), r.hiUs.begin(), r.hiUs.end());
+    for (auto& e : r.errors) all.errors[e.first] += e.second;
+  }
+
+  printf("%d thread(s), %.1f s, padrao \"%s\"%s\n", o.threads, secs, o.pattern.c_str(),
+         o.ids ? ", com id" : "");
+  report("transmit", all.txUs, secs);
+  if (o.recvPct > 0) report("receive", all.rxUs, secs);
+  if (o.hiPct > 0) report("interat.", all.hiUs, secs);
+  for (auto& e : all.errors) printf("erro %-8s %llu\n", strerror(e.first), (unsigned long long)e.second);
+
+  // Visão do driver (retentativas, first byte, timeouts), se o debugfs estiver montado
+  dumpFile(DEBUGFS_DIR "/stats");
+  return (all.txUs.empty() && all.hiUs.empty()) ? 1 : 0;
+}
+
+static int writeAttr(const char* path, const char* value) {
+  int fd = open(path, O_WRONLY);
+  if (fd < 0) { perror(path); return -1; }
+  int err = writeLine(fd, value);
+  close(fd);
+  if (err) { fprintf(stderr, "%s: %s\n", path, strerror(err)); return -1; }
+  return 0;
+}
+
+static int runCapture(const Options& o) {
+  if (writeAttr(SYSFS_DIR "/capture", "START\n")) return 1;
+
+  int fd = open(CAPTURE_DEV, O_RDONLY | O_NONBLOCK);
+  if (fd < 0) { perror(CAPTURE_DEV); writeAttr(SYSFS_DIR "/capture", "STOP\n"); return 1; }
+
+  int32_t buf[1024];
+  uint64_t samples = 0, reads = 0;
+  uint32_t maxGapUs = 0;
+  int64_t t0 = nowUs(), last = t0, end = t0 + (int64_t)o.captureSec * 1000000;
+  while (nowUs() < end) {
+    struct pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 100) <= 0 || !(p.revents & POLLIN)) continue;
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) break;
+    int64_t now = nowUs();
+    maxGapUs = std::max(maxGapUs, (uint32_t)(now - last));
+    last = now;
+    samples += n / sizeof(int32_t);
+    reads++;
+  }
+  close(fd);
+  writeAttr(SYSFS_DIR "/capture", "STOP\n");
+  double secs = (nowUs() - t0) / 1e6;
+
+  printf("captura  %.1f s  amostras=%llu (%.0f/s)  leituras=%llu  maior intervalo=%.1f ms\n", secs,
+         (unsigned long long)samples, samples / secs, (unsigned long long)reads, maxGapUs / 1000.0);
+  dumpFile(SYSFS_DIR "/capture");
+  return samples ? 0 : 1;
+}
+
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "uso: %s [opcoes]\n"
+          "  -t n     threads escrevendo em paralelo (4)\n"
+          "  -d s     duracao em segundos (10)\n"
+          "  -p str   padrao do TX (\"%s\")\n"
+          "  -r pct   %% das operacoes que sao LAST_RECV (0)\n"
+          "  -i       prefixa cada TX com um id de correlacao\n"
+          "  -I pct   %% dos TX que sao interativos (\"!\"), com latencia a parte (0)\n"
+          "  -P str   padrao dos TX interativos (o mesmo do -p)\n"
+          "  -c s     mede uma sessao de captura de s segundos em vez do TX\n",
+          prog, DEFAULT_PATTERN);
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:d:p:r:iI:P:c:")) != -1) {
+    switch (opt) {
+    case 't': o.threads = std::max(1, atoi(optarg)); break;
+    case 'd': o.seconds = std::max(1, atoi(optarg)); break;
+    case 'p': o.pattern = optarg; break;
+    case 'r': o.recvPct = std::min(100, std::max(0, atoi(optarg))); break;
+    case 'i': o.ids = true; break;
+    case 'I': o.hiPct = std::min(100, std::max(0, atoi(optarg))); break;
+    case 'P': o.hiPattern = optarg; break;
+    case 'c': o.captureSec = std::max(1, atoi(optarg)); break;
+    default: usage(argv[0]);
+    }
+  }
+  return o.captureSec ? runCapture(o) : runTransmit(o);
+}
@@ -11,6 +11,25 @@
 #include <linux/err.h>
 #include <linux/minmax.h>
 #include <linux/mutex.h> 
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/kfifo.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/pm_runtime.h>
+#include <linux/math64.h>
+#include <linux/crc-itu-t.h>
+#include <linux/uidgid.h>
+#include <linux/user_namespace.h>
+
+#define CREATE_TRACE_POINTS
+#include "ir_remote_trace.h"
 
 
 // DEFINIÇÕES E VARIÁVEIS GLOBAIS
@@ -23,10 +42,22 @@ MODULE_LICENSE("GPL");
 #define VENDOR_ID  0x10C4
 #define PRODUCT_ID 0xEA60
 
+// Sessão de captura contínua: quadros binários 0xA5 <n> <n x u16 LE>
+// vindos do firmware (bit15 = marca). n = 0 encerra a sessão.
+#define CAP_SYNC        0xA5
+#define CAP_FIFO_SIZE   4096    // amostras s32 (potência de 2)
+
+// /dev/ir_transmit: o mesmo comando do sysfs transmit sem o limite de uma
+// página, para os padrões em partes (4096 fatias de até 5 dígitos)
+#define IR_TX_DEV_MAX   32768
+
 // Protótipos
 static int  usb_probe(struct usb_interface *ifce, const struct usb_device_id *id);
 static void usb_disconnect(struct usb_interface *ifce);
-static int  usb_send_cmd_ir(char *full_command);
+static int  ir_suspend(struct usb_interface *intf, pm_message_t message);
+static int  ir_resume(struct usb_interface *intf);
+static int  ir_reset_resume(struct usb_interface *intf);
+static int  usb_send_cmd_ir(char *full_command, u64 id, bool hi);
 static ssize_t attr_show_transmit(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff);
 static ssize_t attr_store_transmit(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count);
 
@@ -34,11 +65,32 @@ static ssize_t attr_store_transmit(struct kobject *sys_obj, struct kobj_attribut
 static ssize_t attr_show_receive(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff);
 static ssize_t attr_store_receive(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count);
 
-static void cleanup_ir(char *buff);
+// Protótipos da sessão de captura contínua
+static ssize_t attr_show_capture(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff);
+static ssize_t attr_store_capture(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count);
+static int  cap_stop_session(void);
+static struct miscdevice cap_miscdev;
+static struct miscdevice tx_miscdev;
+
+// Protótipos das macros do firmware
+static ssize_t attr_show_macro(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff);
+static ssize_t attr_store_macro(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count);
+
+static ssize_t attr_show_channels(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff);
+static ssize_t attr_show_caps(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff);
+static ssize_t attr_show_clock(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff);
+static ssize_t attr_store_clock(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count);
+static void ir_query_caps(void);
+static void ir_config_fw_sleep(void);
+
+// Telemetria (usada pelo probe/disconnect antes da definição)
+static void ir_hist_add(u32 *hist, unsigned int buckets, s64 us);
+static const struct file_operations ir_stats_fops;
+static const struct file_operations ir_stats_reset_fops;
 
 // Variáveis de estado
-static char recv_line[MAX_RECV_LINE];
 static struct usb_device *ir_device;
+static struct usb_interface *ir_intf;
 static uint usb_in, usb_out;
 static char *usb_in_buffer, *usb_out_buffer;
 static int usb_max_size;
@@ -51,25 +103,179 @@ static char last_ir_command[MAX_RECV_LINE] = "Nenhum comando IR enviado ainda.";
 static char cached_recv_buffer[MAX_RECV_LINE] = "Nenhum dado lido ainda.\n";
 
 // Mutex para proteger acesso simultâneo (Transmit vs Receive)
-static struct mutex ir_lock;
+static DEFINE_MUTEX(ir_lock);
+
+// Reconexão rápida: num soluço do USB o estado do driver (sysfs, buffers,
+// capacidades, caches e telemetria) sobrevive por até reconnect_ms. Se o
+// mesmo dispositivo (número de série) voltar nesse prazo, só o USB é
+// religado e os comandos que falharam com ele ausente são repetidos.
+static unsigned int reconnect_ms = 2000;
+module_param(reconnect_ms, uint, 0644);
+MODULE_PARM_DESC(reconnect_ms, "Tempo (ms) que o estado espera o dispositivo voltar");
+
+#define IR_REPLAY_MAX   2       // repetições de um comando por reconexões seguidas
+
+static char ir_serial[64];                  // série do dispositivo dono do estado
+static bool ir_state_ready;                 // sysfs, /dev, debugfs e buffers criados
+static bool ir_misc_ready;                  // /dev/ir_capture registrado
+static bool ir_txdev_ready;                 // /dev/ir_transmit registrado
+static unsigned int ir_attach_gen;          // muda a cada probe (protegido por ir_lock)
+static ktime_t ir_gone_at;                  // instante do último disconnect
+static DECLARE_WAIT_QUEUE_HEAD(ir_attach_wait);
+static void ir_teardown_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(ir_teardown_work, ir_teardown_fn);
+
+// Economia de energia entre transmissões raras. O USB entra em autosuspend
+// depois de autosuspend_ms ocioso (< 0 deixa a política com o userspace);
+// com fw_sleep_ms > 0 o ESP32 entra em light-sleep depois desse tempo sem
+// comandos, e o driver manda uma linha vazia para acordá-lo antes do próximo.
+static int autosuspend_ms = 2000;
+module_param(autosuspend_ms, int, 0444);
+MODULE_PARM_DESC(autosuspend_ms, "Ociosidade (ms) antes do autosuspend do USB (< 0 desliga)");
+static unsigned int fw_sleep_ms;
+module_param(fw_sleep_ms, uint, 0444);
+MODULE_PARM_DESC(fw_sleep_ms, "Ociosidade (ms) antes do light-sleep do firmware (0 desliga)");
+
+// Dono dos nós de /sys/kernel/infrared. O diretório nasce a cada probe que
+// recria o estado e não tem uevent (kernel_kobj não pertence a um kset), então
+// nem o ueventd nem um chown no boot o alcançam: o driver aplica o dono aqui.
+// No Android, 1000/1000 (system), que é o usuário da HAL.
+static unsigned int sysfs_uid;
+module_param(sysfs_uid, uint, 0444);
+MODULE_PARM_DESC(sysfs_uid, "UID dono dos nós de /sys/kernel/infrared (0 = root)");
+static unsigned int sysfs_gid;
+module_param(sysfs_gid, uint, 0444);
+MODULE_PARM_DESC(sysfs_gid, "GID dono dos nós de /sys/kernel/infrared (0 = root)");
+
+#define IR_FW_WAKE_US   1500    // despertar do light-sleep do ESP32 (~1 ms) com folga
+
+static unsigned int ir_fw_sleep_ms;         // valor aceito pelo firmware (0 = não dorme)
+static ktime_t ir_last_io;                  // fim do último comando (protegido por ir_lock)
+
+// Id de correlação do comando em curso (0 = sem id), protegido por ir_lock.
+// Vem da HAL como prefixo "@<hex> " e segue até o firmware, que o devolve no [OK].
+static u64 ir_cmd_id;
+
+// Prioridade do transmit: "!" na frente da linha da HAL marca um TX
+// interativo (o botão do usuário). Ele passa à frente dos TX de fundo que
+// esperam o ir_lock e, se um deles estiver no ar, o driver manda um ABORT
+// fora de banda: o firmware corta o padrão na próxima fronteira de quadro
+// e o TX de fundo volta com -ECANCELED.
+static DEFINE_SPINLOCK(ir_prio_lock);
+static unsigned int ir_hi_waiting;          // TX interativos esperando o ir_lock
+static bool ir_bg_inflight;                 // TX de fundo com o ir_lock
+static bool ir_bg_aborted;                  // ABORT já enviado para ele
+static DECLARE_WAIT_QUEUE_HEAD(ir_prio_wait);
+
+// Relógio do firmware: o TX_AT leva um instante do esp_timer do ESP32. O
+// driver o estima a partir do ktime_get() (CLOCK_MONOTONIC, o mesmo do
+// SystemClock.uptimeNanos) trocando linhas SYNC, e refaz a estimativa se
+// ela tiver mais que sync_ms na hora de um TX agendado.
+static unsigned int sync_ms = 10000;
+module_param(sync_ms, uint, 0644);
+MODULE_PARM_DESC(sync_ms, "Idade máxima (ms) da sincronização do relógio antes de um TX agendado");
+
+#define IR_SYNC_SAMPLES     8           // SYNCs por sincronização (fica o de menor atraso)
+#define IR_SYNC_MAX_MS      3600000     // teto do sync_ms (mantém as contas em 64 bits)
+#define IR_DRIFT_MIN_NS     (1000LL * NSEC_PER_MSEC)   // base mínima para medir a deriva
+#define IR_DRIFT_MAX_PPB    500000      // 500 ppm: acima disso a medida é descartada
+#define IR_UART_BYTE_NS     86806       // 10 bits a 115200 baud (ir_config_serial)
+#define IR_TX_AT_MAX_NS     (10LL * NSEC_PER_SEC)      // IR_TX_AT_MAX_LEAD_US do firmware
+
+// Upload em partes (BEGIN/CHUNK/COMMIT) dos padrões que não cabem numa
+// linha do firmware; o transmit aceita então até uma página de comando
+#define IR_RAW_TICK_US      50          // RAW_TICK_US do firmware (RAW @<freq> <b,...>)
+#define IR_UPLOAD_RETRIES   2           // reenvios de um CHUNK que chegou corrompido
+
+// Protegido por ir_lock. Ponto de referência (host_ns <-> dev_us) da última
+// sincronização e a deriva do cristal do ESP32 em relação ao host.
+struct ir_clock {
+    bool valid;
+    s64 host_ns;
+    s64 dev_us;
+    s64 drift_ppb;          // quanto o relógio do firmware adianta por segundo do host
+    bool drift_valid;
+    s64 delay_us;           // atraso USB (ida + volta) da amostra escolhida
+};
+static struct ir_clock ir_clock;
+
+// Estado da sessão de captura: a thread é a única leitora do bulk IN
+// enquanto a sessão está ativa; /dev/ir_capture entrega as durações como
+// s32 (positivo = marca, negativo = espaço, em µs).
+static DEFINE_KFIFO(cap_fifo, s32, CAP_FIFO_SIZE);
+static DECLARE_WAIT_QUEUE_HEAD(cap_wait);
+static DEFINE_MUTEX(cap_read_lock);
+static struct task_struct *cap_thread;
+static bool cap_active;
+static bool cap_stream_ended;
+static unsigned long cap_samples, cap_dropped;
+static u8 cap_carry[MAX_RECV_LINE];         // resto do pacote do [OK] CAP START
+static int cap_carry_len;
+
+// Capacidades informadas pelo firmware (CAPS), lidas uma vez no probe
+struct ir_caps {
+    unsigned int fmin, fmax;        // faixa de portadora (Hz)
+    unsigned int slices;            // máximo de fatias por padrão
+    unsigned int maxus;             // duração máxima do padrão (µs)
+    unsigned int channels;          // canais de TX
+    unsigned int line, rec;         // buffers de linha e de REC (bytes)
+    unsigned int macros, steps;     // macros guardadas e passos por macro (0 = sem MACRO)
+    unsigned int upload;            // fatias de um padrão em partes (0 = sem UPLOAD)
+    char proto[96];
+};
+static struct ir_caps ir_caps = { .channels = 1 };
+
+// Telemetria exposta em /sys/kernel/debug/ir_remote/stats. Histogramas em
+// faixas de potência de 2 de µs (faixa i = [2^i, 2^(i+1)) µs).
+#define IR_HIST_BUCKETS   24      // última faixa: >= ~8 s
+#define IR_RETRY_BUCKETS  12      // última faixa: >= 11 leituras vazias
+struct ir_stats {
+    u64 cmds, ok, err, timeouts, usb_errors;
+    u64 retries;                            // leituras vazias antes da resposta
+    u64 bytes_out, bytes_in;
+    u64 reconnects, replays, expired;       // religações, comandos repetidos, estados descartados
+    u64 usb_wakes, fw_wakes;                // comandos que acordaram o USB / o firmware
+    u64 hi_tx, bg_yields;                   // TX interativos / vezes que um de fundo cedeu a vez
+    u64 aborts, preempted;                  // ABORTs enviados / TX de fundo cortados
+    u64 syncs, sync_errors, tx_at;          // sincronizações do relógio / falhas / TX agendados
+    u64 uploads, chunks, chunk_retries;     // padrões enviados em partes / CHUNKs / reenvios por CRC
+    u32 first_byte_us[IR_HIST_BUCKETS];     // envio -> primeiro byte da resposta
+    u32 ack_us[IR_HIST_BUCKETS];            // envio -> resposta reconhecida
+    u32 retry_hist[IR_RETRY_BUCKETS];
+    u32 reconnect_us[IR_HIST_BUCKETS];      // disconnect -> probe do mesmo dispositivo pronto
+    u32 wake_us[IR_HIST_BUCKETS];           // custo do despertar antes do primeiro comando
+    u32 hi_wait_us[IR_HIST_BUCKETS];        // TX interativo: write -> ir_lock
+    u32 hi_us[IR_HIST_BUCKETS];             // TX interativo: write -> [OK]
+    u32 sync_delay_us[IR_HIST_BUCKETS];     // atraso USB da amostra escolhida em cada SYNC
+    u32 tx_at_lead_us[IR_HIST_BUCKETS];     // folga do TX agendado quando o firmware o armou
+};
+static struct ir_stats ir_stats;
+static DEFINE_SPINLOCK(ir_stats_lock);
+static struct dentry *ir_debugfs;
 
 // Definição dos Arquivos Sysfs
 
 static struct kobj_attribute transmit_attribute = __ATTR(transmit, 0660, attr_show_transmit, attr_store_transmit);
 static struct kobj_attribute receive_attribute  = __ATTR(receive,  0660, attr_show_receive, attr_store_receive);
+static struct kobj_attribute capture_attribute  = __ATTR(capture,  0660, attr_show_capture, attr_store_capture);
+static struct kobj_attribute macro_attribute    = __ATTR(macro,    0660, attr_show_macro, attr_store_macro);
+static struct kobj_attribute channels_attribute = __ATTR(channels, 0444, attr_show_channels, NULL);
+static struct kobj_attribute caps_attribute     = __ATTR(caps,     0444, attr_show_caps, NULL);
+static struct kobj_attribute clock_attribute    = __ATTR(clock,    0660, attr_show_clock, attr_store_clock);
 
 static struct attribute      *attrs[]       = { 
     &transmit_attribute.attr, 
     &receive_attribute.attr,
+    &capture_attribute.attr,
+    &macro_attribute.attr,
+    &channels_attribute.attr,
+    &caps_attribute.attr,
+    &clock_attribute.attr,
     NULL 
 };
 static struct attribute_group attr_group    = { .attrs = attrs };
 static struct kobject        *sys_obj;
 
-static void cleanup_ir(char *buf) {
-    kfree(buf);
-}
-
 // Função para configurar os parâmetros seriais do CP2102 via Control-Messages
 static int ir_config_serial(struct usb_device *dev){
     int ret;
@@ -112,246 +318,1441 @@ static struct usb_driver ir_driver = {
     .name        = "ir_remote",
     .probe       = usb_probe,
     .disconnect  = usb_disconnect,
+    .suspend     = ir_suspend,
+    .resume      = ir_resume,
+    .reset_resume = ir_reset_resume,
     .id_table    = id_table,
+    .supports_autosuspend = 1,
 };
-module_usb_driver(ir_driver);
 
-static int usb_probe(struct usb_interface *interface, const struct usb_device_id *id) {
-    struct usb_endpoint_descriptor *usb_endpoint_in, *usb_endpoint_out;
+// Cria o estado que sobrevive às reconexões: buffers, /sys/kernel/infrared,
+// /dev/ir_capture e o debugfs. Chamar sem ir_lock.
+static int ir_state_create(void) {
     int ret;
 
-    printk(KERN_INFO "IR_REMOTE: Dispositivo conectado ...\n");
-    
-    sys_obj = kobject_create_and_add("infrared", kernel_kobj);
-    if (!sys_obj) return -ENOMEM;
+    usb_in_buffer = kzalloc(MAX_RECV_LINE, GFP_KERNEL);
+    usb_out_buffer = kzalloc(MAX_RECV_LINE, GFP_KERNEL);
+    if (!usb_in_buffer || !usb_out_buffer) {
+        ret = -ENOMEM;
+        goto err_free;
+    }
 
+    sys_obj = kobject_create_and_add("infrared", kernel_kobj);
+    if (!sys_obj) {
+        ret = -ENOMEM;
+        goto err_free;
+    }
     if (sysfs_create_group(sys_obj, &attr_group)) {
-        kobject_put(sys_obj);
-        return -ENOMEM;
+        ret = -ENOMEM;
+        goto err_kobj;
+    }
+    if (sysfs_uid || sysfs_gid) {
+        ret = sysfs_group_change_owner(sys_obj, &attr_group,
+                                       make_kuid(&init_user_ns, sysfs_uid),
+                                       make_kgid(&init_user_ns, sysfs_gid));
+        if (ret)
+            printk(KERN_ERR "IR_REMOTE: Falha ao passar o sysfs para %u:%u (código %d)\n",
+                   sysfs_uid, sysfs_gid, ret);
     }
 
-    ir_device = interface_to_usbdev(interface);
-    if (usb_find_common_endpoints(interface->cur_altsetting, &usb_endpoint_in, &usb_endpoint_out, NULL, NULL)) {
-        kobject_put(sys_obj);
+    // Cria /dev/ir_capture para as sessões de captura contínua
+    ret = misc_register(&cap_miscdev);
+    ir_misc_ready = !ret;
+    if (ret)
+        printk(KERN_ERR "IR_REMOTE: Falha ao criar /dev/ir_capture (código %d)\n", ret);
+
+    // Cria /dev/ir_transmit para os comandos maiores que uma página
+    ret = misc_register(&tx_miscdev);
+    ir_txdev_ready = !ret;
+    if (ret)
+        printk(KERN_ERR "IR_REMOTE: Falha ao criar /dev/ir_transmit (código %d)\n", ret);
+
+    // Telemetria: /sys/kernel/debug/ir_remote/{stats,reset}
+    ir_debugfs = debugfs_create_dir("ir_remote", NULL);
+    debugfs_create_file("stats", 0444, ir_debugfs, NULL, &ir_stats_fops);
+    debugfs_create_file("reset", 0200, ir_debugfs, NULL, &ir_stats_reset_fops);
+
+    ir_state_ready = true;
+    return 0;
+
+err_kobj:
+    kobject_put(sys_obj);
+    sys_obj = NULL;
+err_free:
+    kfree(usb_in_buffer);
+    kfree(usb_out_buffer);
+    usb_in_buffer = usb_out_buffer = NULL;
+    return ret;
+}
+
+// Desfaz ir_state_create(). Chamar sem ir_lock: remover o sysfs espera as
+// escritas em curso, que podem estar esperando o ir_lock ou a reconexão.
+static void ir_state_destroy(void) {
+    mutex_lock(&ir_lock);
+    ir_state_ready = false;
+    ir_serial[0] = '\0';
+    mutex_unlock(&ir_lock);
+    wake_up_all(&ir_attach_wait);
+
+    if (ir_misc_ready)
+        misc_deregister(&cap_miscdev);
+    ir_misc_ready = false;
+    if (ir_txdev_ready)
+        misc_deregister(&tx_miscdev);
+    ir_txdev_ready = false;
+    debugfs_remove_recursive(ir_debugfs);
+    ir_debugfs = NULL;
+    kobject_put(sys_obj);
+    sys_obj = NULL;
+    kfree(usb_in_buffer);
+    kfree(usb_out_buffer);
+    usb_in_buffer = usb_out_buffer = NULL;
+
+    // Outro dispositivo começa sem os caches deste
+    snprintf(last_ir_command, MAX_RECV_LINE, "Nenhum comando IR enviado ainda.");
+    snprintf(cached_recv_buffer, MAX_RECV_LINE, "Nenhum dado lido ainda.\n");
+}
+
+// O dispositivo não voltou dentro de reconnect_ms
+static void ir_teardown_fn(struct work_struct *work) {
+    printk(KERN_INFO "IR_REMOTE: Dispositivo não voltou em %u ms; estado descartado.\n", reconnect_ms);
+    spin_lock(&ir_stats_lock);
+    ir_stats.expired++;
+    spin_unlock(&ir_stats_lock);
+    ir_state_destroy();
+}
+
+static int __init ir_init(void) {
+    return usb_register(&ir_driver);
+}
+
+static void __exit ir_exit(void) {
+    usb_deregister(&ir_driver);
+    // O disconnect do deregister agendou o descarte: faz agora
+    cancel_delayed_work_sync(&ir_teardown_work);
+    if (ir_state_ready)
+        ir_state_destroy();
+}
+module_init(ir_init);
+module_exit(ir_exit);
+
+static int usb_probe(struct usb_interface *interface, const struct usb_device_id *id) {
+    struct usb_endpoint_descriptor *usb_endpoint_in, *usb_endpoint_out;
+    struct usb_device *dev = interface_to_usbdev(interface);
+    const char *serial = dev->serial ? dev->serial : "";
+    bool reattach;
+    s64 gone_us = 0;
+    int ret;
+
+    printk(KERN_INFO "IR_REMOTE: Dispositivo conectado (série '%s') ...\n", serial);
+
+    if (usb_find_common_endpoints(interface->cur_altsetting, &usb_endpoint_in, &usb_endpoint_out, NULL, NULL))
         return -ENODEV;
+
+    // Voltou a tempo: o descarte agendado no disconnect não acontece mais
+    cancel_delayed_work_sync(&ir_teardown_work);
+    if (ir_state_ready && strcmp(ir_serial, serial)) {
+        printk(KERN_INFO "IR_REMOTE: Outro dispositivo (antes '%s'); estado anterior descartado.\n", ir_serial);
+        ir_state_destroy();
+    }
+    reattach = ir_state_ready;
+    if (!reattach) {
+        ret = ir_state_create();
+        if (ret)
+            return ret;
     }
 
+    mutex_lock(&ir_lock);
+    ir_device = usb_get_dev(dev);
+    ir_intf = interface;
     usb_max_size = usb_endpoint_maxp(usb_endpoint_in);
     usb_in = usb_endpoint_in->bEndpointAddress;
     usb_out = usb_endpoint_out->bEndpointAddress;
 
-    usb_in_buffer = kmalloc(MAX_RECV_LINE, GFP_KERNEL);
-    usb_out_buffer = kmalloc(MAX_RECV_LINE, GFP_KERNEL);
-
-    if (!usb_in_buffer || !usb_out_buffer) {
-        if (sys_obj) kobject_put(sys_obj);
-        kfree(usb_in_buffer);
-        kfree(usb_out_buffer);
-        return -ENOMEM;
+    ret = ir_config_serial(ir_device);
+    if (ret) {
+        usb_put_dev(ir_device);
+        ir_device = NULL;
+        ir_intf = NULL;
+        mutex_unlock(&ir_lock);
+        if (reattach)
+            schedule_delayed_work(&ir_teardown_work, msecs_to_jiffies(reconnect_ms));
+        else
+            ir_state_destroy();
+        return ret;
     }
 
-    memset(usb_in_buffer, 0, MAX_RECV_LINE);
-    memset(usb_out_buffer, 0, MAX_RECV_LINE);
-
-    mutex_init(&ir_lock);
-
-    ret = ir_config_serial(ir_device);
-    if (ret){
-           kfree(usb_in_buffer);
-           kfree(usb_out_buffer);
-           return ret;
-       }
+    // O firmware pode ter ficado em light-sleep (módulo recarregado, reset
+    // do USB): o primeiro comando leva a linha de despertar
+    ir_fw_sleep_ms = 1;
+    ir_last_io = 0;
+
+    // O ESP32 pode ter reiniciado: o relógio é sincronizado de novo no
+    // próximo TX agendado (a deriva do mesmo cristal continua valendo)
+    ir_clock.valid = false;
+    if (!reattach)
+        ir_clock.drift_valid = false;
+
+    if (reattach) {
+        // Mesmo dispositivo: capacidades, caches e telemetria continuam valendo
+        gone_us = ktime_us_delta(ktime_get(), ir_gone_at);
+        spin_lock(&ir_stats_lock);
+        ir_stats.reconnects++;
+        ir_hist_add(ir_stats.reconnect_us, IR_HIST_BUCKETS, gone_us);
+        spin_unlock(&ir_stats_lock);
+    } else {
+        strscpy(ir_serial, serial, sizeof(ir_serial));
+        ir_query_caps();
+    }
+    // O ESP32 pode ter reiniciado junto com o USB: reenvia o SLEEP
+    ir_config_fw_sleep();
+    ir_attach_gen++;
+    mutex_unlock(&ir_lock);
+    wake_up_all(&ir_attach_wait);
+
+    if (autosuspend_ms >= 0) {
+        pm_runtime_set_autosuspend_delay(&dev->dev, autosuspend_ms);
+        usb_enable_autosuspend(dev);
+    }
 
+    if (reattach)
+        printk(KERN_INFO "IR_REMOTE: Religado em %lld us; estado preservado.\n", gone_us);
     return 0;
 }
 
 static void usb_disconnect(struct usb_interface *interface) {
     printk(KERN_INFO "IR_REMOTE: Dispositivo desconectado.\n");
-    if (sys_obj) kobject_put(sys_obj);
-    kfree(usb_in_buffer);
-    kfree(usb_out_buffer);
+
+    mutex_lock(&ir_lock);
+    // Sem dispositivo não há CAP STOP: só encerra a thread e acorda leitores
+    cap_stop_session();
+    usb_put_dev(ir_device);
+    ir_device = NULL;
+    ir_intf = NULL;
+    ir_gone_at = ktime_get();
+    mutex_unlock(&ir_lock);
+
+    // sysfs, /dev e caches ficam até reconnect_ms esperando o mesmo dispositivo
+    schedule_delayed_work(&ir_teardown_work, msecs_to_jiffies(reconnect_ms));
 }
 
+// Erros do USB de um dispositivo que sumiu no meio do comando
+static bool ir_gone_error(int ret) {
+    return ret == -ENODEV || ret == -ESHUTDOWN || ret == -EPROTO;
+}
 
-// ENVIO IR VIA USB 
-// Envia o comando IR completo (string) via USB
-static int usb_send_cmd_ir(char *full_command) {
+// Chamar sem ir_lock, com o resultado de um comando e a geração do probe
+// em que ele rodou. Se o dispositivo sumiu, espera ele voltar (até
+// reconnect_ms) e diz se o comando deve ser repetido.
+static bool ir_retry_after_reconnect(int ret, unsigned int gen, int *replays) {
+    long left;
+
+    if (!ir_gone_error(ret) || *replays >= IR_REPLAY_MAX)
+        return false;
+    left = wait_event_interruptible_timeout(ir_attach_wait,
+                                            READ_ONCE(ir_attach_gen) != gen || !READ_ONCE(ir_state_ready),
+                                            msecs_to_jiffies(reconnect_ms));
+    if (left <= 0 || READ_ONCE(ir_attach_gen) == gen || !READ_ONCE(ir_state_ready))
+        return false;
+
+    (*replays)++;
+    spin_lock(&ir_stats_lock);
+    ir_stats.replays++;
+    spin_unlock(&ir_stats_lock);
+    pr_debug("IR_REMOTE: Dispositivo religado; repetindo o comando.\n");
+    return true;
+}
+
+// PRIORIDADE DO TRANSMIT
+
+// Manda "ABORT\n" sem o ir_lock, enquanto o dono dele espera a resposta do
+// TX de fundo (e segura o dispositivo acordado). O [OK] ABORT que vem
+// depois do [ERR] do TX é ignorado pelo waiter do próximo comando.
+static void ir_send_abort(struct usb_device *dev, unsigned int ep_out) {
+    static const char line[] = "ABORT\n";
+    char *buf = kmemdup(line, sizeof(line) - 1, GFP_KERNEL);
     int ret, actual_size;
-    int attempts = 10;              // menos tentativas para evitar travar
-    int read_timeout_ms = 200;      // timeout mais curto (200ms)
-    char final_command[MAX_RECV_LINE] = {0};
-    char *expected_ok_prefix;
-    char *start_ptr, *newline_ptr;
-    
-    // 1. Aloca o buffer de resposta
-    char *full_response = kmalloc(MAX_RECV_LINE, GFP_KERNEL);
-    if (!full_response) 
-        return -ENOMEM; // Sai cedo, nada para limpar
 
-    memset(full_response, 0, MAX_RECV_LINE);
-    memset(recv_line, 0, MAX_RECV_LINE);
+    if (!buf)
+        return;
+    ret = usb_bulk_msg(dev, usb_sndbulkpipe(dev, ep_out), buf, sizeof(line) - 1, &actual_size, 200);
+    kfree(buf);
+    if (ret) {
+        printk(KERN_WARNING "IR_REMOTE: Falha ao enviar ABORT (código %d).\n", ret);
+        return;
+    }
+    spin_lock(&ir_stats_lock);
+    ir_stats.aborts++;
+    spin_unlock(&ir_stats_lock);
+    pr_debug("IR_REMOTE: ABORT enviado para o TX de fundo.\n");
+}
 
-    // Monta o comando
-    if (strncmp(full_command, "NEC ", 4) == 0) {
-        snprintf(final_command, MAX_RECV_LINE, "NEC %s\n", full_command);
-        expected_ok_prefix = "[OK] NEC";
-    } else {
-        snprintf(final_command, MAX_RECV_LINE, "TX %s\n", full_command);
-        expected_ok_prefix = "[OK] TX";
+// Pega o ir_lock pela fila do transmit. O interativo só espera o comando
+// em curso (cortado, se for um TX de fundo); o de fundo cede a vez enquanto
+// houver interativo esperando. Retorna 0 com o ir_lock, ou -ERESTARTSYS.
+static int ir_tx_lock(bool hi) {
+    struct usb_device *dev = NULL;
+    unsigned int ep_out = 0;
+    ktime_t t0 = ktime_get();
+    bool last;
+
+    if (!hi) {
+        for (;;) {
+            if (wait_event_interruptible(ir_prio_wait, !READ_ONCE(ir_hi_waiting)))
+                return -ERESTARTSYS;
+            mutex_lock(&ir_lock);
+            spin_lock(&ir_prio_lock);
+            if (!ir_hi_waiting) {
+                ir_bg_inflight = true;
+                ir_bg_aborted = false;
+                spin_unlock(&ir_prio_lock);
+                return 0;
+            }
+            spin_unlock(&ir_prio_lock);
+            mutex_unlock(&ir_lock);
+            spin_lock(&ir_stats_lock);
+            ir_stats.bg_yields++;
+            spin_unlock(&ir_stats_lock);
+        }
     }
 
-    strncpy(usb_out_buffer, final_command, MAX_RECV_LINE);
-    printk(KERN_INFO "IR_REMOTE: Enviando comando: '%s'\n", usb_out_buffer);
+    // Com o TX de fundo no ar, o dono do ir_lock segura o ir_device
+    spin_lock(&ir_prio_lock);
+    ir_hi_waiting++;
+    if (ir_bg_inflight && !ir_bg_aborted && ir_device && strstr(ir_caps.proto, "ABORT")) {
+        ir_bg_aborted = true;
+        dev = usb_get_dev(ir_device);
+        ep_out = usb_out;
+    }
+    spin_unlock(&ir_prio_lock);
+    if (dev) {
+        ir_send_abort(dev, ep_out);
+        usb_put_dev(dev);
+    }
 
-    // Envia comando para o ESP32 via USB
-    ret = usb_bulk_msg(ir_device, usb_sndbulkpipe(ir_device, usb_out),
-                       usb_out_buffer, strlen(usb_out_buffer), &actual_size, 1000);
-    if (ret) {
-        printk(KERN_ERR "IR_REMOTE: Falha ao enviar comando! Código %d\n", ret);
-        cleanup_ir(full_response);
+    mutex_lock(&ir_lock);
+    spin_lock(&ir_prio_lock);
+    last = !--ir_hi_waiting;
+    spin_unlock(&ir_prio_lock);
+    if (last)
+        wake_up_all(&ir_prio_wait);
+
+    spin_lock(&ir_stats_lock);
+    ir_stats.hi_tx++;
+    ir_hist_add(ir_stats.hi_wait_us, IR_HIST_BUCKETS, ktime_us_delta(ktime_get(), t0));
+    spin_unlock(&ir_stats_lock);
+    return 0;
+}
+
+static void ir_tx_unlock(bool hi) {
+    if (!hi) {
+        spin_lock(&ir_prio_lock);
+        ir_bg_inflight = false;
+        spin_unlock(&ir_prio_lock);
+    }
+    mutex_unlock(&ir_lock);
+}
+
+// ENERGIA (autosuspend do USB + light-sleep do firmware)
+// Uma sessão de captura segura só o autosuspend (pela referência do
+// autopm). A suspensão do sistema encerra a sessão, e o leitor de
+// /dev/ir_capture vê o fim do stream, em vez de travar o autosleep.
+static int ir_suspend(struct usb_interface *intf, pm_message_t message) {
+    if (cap_active) {
+        if (PMSG_IS_AUTO(message))
+            return -EBUSY;
+        mutex_lock(&ir_lock);
+        if (cap_active) {
+            printk(KERN_INFO "IR_REMOTE: Suspensão do sistema; encerrando a captura.\n");
+            cap_stop_session();
+        }
+        mutex_unlock(&ir_lock);
+    }
+    pr_debug("IR_REMOTE: Suspenso (%s).\n", PMSG_IS_AUTO(message) ? "autosuspend" : "sistema");
+    return 0;
+}
+
+static int ir_resume(struct usb_interface *intf) {
+    return 0;
+}
+
+// O CP2102 perdeu a configuração da serial no reset
+static int ir_reset_resume(struct usb_interface *intf) {
+    return ir_config_serial(interface_to_usbdev(intf));
+}
+
+// Chamar com ir_lock, antes de enviar um comando. Retoma o USB se estiver
+// em autosuspend e, se o firmware pode ter dormido, manda uma linha vazia
+// (o byte que acorda a UART do ESP32 se perde) e espera ele acordar.
+// O custo vai para o histograma wake_us.
+static int ir_pm_get(void) {
+    bool usb_asleep = pm_runtime_status_suspended(&ir_device->dev);
+    bool fw_asleep = ir_fw_sleep_ms && ktime_ms_delta(ktime_get(), ir_last_io) >= ir_fw_sleep_ms;
+    ktime_t t0 = ktime_get();
+    int ret, actual_size;
+    s64 us;
+
+    ret = usb_autopm_get_interface(ir_intf);
+    if (ret)
         return ret;
+
+    if (fw_asleep) {
+        usb_out_buffer[0] = '\n';
+        ret = usb_bulk_msg(ir_device, usb_sndbulkpipe(ir_device, usb_out),
+                           usb_out_buffer, 1, &actual_size, 1000);
+        if (ret) {
+            usb_autopm_put_interface(ir_intf);
+            return ret;
+        }
+        usleep_range(IR_FW_WAKE_US, IR_FW_WAKE_US + 500);
     }
-    // Pequena pausa para o ESP32 processar
-    msleep(50);
-    printk(KERN_INFO "DEBUG: Iniciando leitura USB (%d tentativas, timeout=%dms)...", attempts, read_timeout_ms);
-    // Loop de leitura com tempo reduzido
+
+    if (usb_asleep || fw_asleep) {
+        us = ktime_us_delta(ktime_get(), t0);
+        spin_lock(&ir_stats_lock);
+        ir_stats.usb_wakes += usb_asleep;
+        ir_stats.fw_wakes += fw_asleep;
+        ir_hist_add(ir_stats.wake_us, IR_HIST_BUCKETS, us);
+        spin_unlock(&ir_stats_lock);
+        pr_debug("IR_REMOTE: Despertar em %lld us (usb=%d fw=%d)\n", us, usb_asleep, fw_asleep);
+    }
+    return 0;
+}
+
+static void ir_pm_put(void) {
+    ir_last_io = ktime_get();
+    usb_autopm_put_interface(ir_intf);
+}
+
+// TELEMETRIA (tracepoints + debugfs)
+
+static void ir_hist_add(u32 *hist, unsigned int buckets, s64 us) {
+    unsigned int b = (us > 0) ? ilog2((u64)us) : 0;
+    hist[min(b, buckets - 1)]++;
+}
+
+static void ir_stats_bytes(unsigned int out, unsigned int in) {
+    spin_lock(&ir_stats_lock);
+    ir_stats.bytes_out += out;
+    ir_stats.bytes_in += in;
+    spin_unlock(&ir_stats_lock);
+}
+
+static void ir_stats_first_byte(s64 us) {
+    spin_lock(&ir_stats_lock);
+    ir_hist_add(ir_stats.first_byte_us, IR_HIST_BUCKETS, us);
+    spin_unlock(&ir_stats_lock);
+}
+
+// result segue o retorno de usb_cmd_wait_reply: 1 = [OK], -EIO = [ERR],
+// 0 = timeout, outro negativo = erro USB
+static void ir_stats_finish(int result, s64 us, int retries) {
+    spin_lock(&ir_stats_lock);
+    ir_stats.cmds++;
+    ir_stats.retries += retries;
+    ir_stats.retry_hist[min(retries, IR_RETRY_BUCKETS - 1)]++;
+    if (result > 0)
+        ir_stats.ok++;
+    else if (result == -EIO)
+        ir_stats.err++;
+    else if (result == 0)
+        ir_stats.timeouts++;
+    else
+        ir_stats.usb_errors++;
+    if (result > 0 || result == -EIO)
+        ir_hist_add(ir_stats.ack_us, IR_HIST_BUCKETS, us);
+    spin_unlock(&ir_stats_lock);
+}
+
+static void ir_seq_hist(struct seq_file *m, const char *name, const u32 *hist, unsigned int buckets) {
+    unsigned int i;
+
+    seq_printf(m, "%s:", name);
+    for (i = 0; i < buckets; i++)
+        if (hist[i])
+            seq_printf(m, " %llu:%u", i ? 1ULL << i : 0ULL, hist[i]);
+    seq_putc(m, '\n');
+}
+
+static int ir_stats_show(struct seq_file *m, void *unused) {
+    struct ir_stats snap;
+    unsigned int i;
+
+    spin_lock(&ir_stats_lock);
+    snap = ir_stats;
+    spin_unlock(&ir_stats_lock);
+
+    seq_printf(m, "cmds=%llu ok=%llu err=%llu timeouts=%llu usb_errors=%llu retries=%llu\n",
+               snap.cmds, snap.ok, snap.err, snap.timeouts, snap.usb_errors, snap.retries);
+    seq_printf(m, "bytes_out=%llu bytes_in=%llu\n", snap.bytes_out, snap.bytes_in);
+    seq_printf(m, "reconnects=%llu replays=%llu expired=%llu\n",
+               snap.reconnects, snap.replays, snap.expired);
+    seq_printf(m, "usb_wakes=%llu fw_wakes=%llu\n", snap.usb_wakes, snap.fw_wakes);
+    seq_printf(m, "hi_tx=%llu bg_yields=%llu aborts=%llu preempted=%llu\n",
+               snap.hi_tx, snap.bg_yields, snap.aborts, snap.preempted);
+    seq_printf(m, "syncs=%llu sync_errors=%llu tx_at=%llu\n",
+               snap.syncs, snap.sync_errors, snap.tx_at);
+    seq_printf(m, "uploads=%llu chunks=%llu chunk_retries=%llu\n",
+               snap.uploads, snap.chunks, snap.chunk_retries);
+    // "<limite inferior em µs>:<contagem>", só faixas não vazias
+    ir_seq_hist(m, "first_byte_us", snap.first_byte_us, IR_HIST_BUCKETS);
+    ir_seq_hist(m, "ack_us", snap.ack_us, IR_HIST_BUCKETS);
+    ir_seq_hist(m, "reconnect_us", snap.reconnect_us, IR_HIST_BUCKETS);
+    ir_seq_hist(m, "wake_us", snap.wake_us, IR_HIST_BUCKETS);
+    ir_seq_hist(m, "hi_wait_us", snap.hi_wait_us, IR_HIST_BUCKETS);
+    ir_seq_hist(m, "hi_us", snap.hi_us, IR_HIST_BUCKETS);
+    ir_seq_hist(m, "sync_delay_us", snap.sync_delay_us, IR_HIST_BUCKETS);
+    ir_seq_hist(m, "tx_at_lead_us", snap.tx_at_lead_us, IR_HIST_BUCKETS);
+    seq_puts(m, "retries_per_cmd:");
+    for (i = 0; i < IR_RETRY_BUCKETS; i++)
+        if (snap.retry_hist[i])
+            seq_printf(m, " %u:%u", i, snap.retry_hist[i]);
+    seq_putc(m, '\n');
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ir_stats);
+
+// Qualquer escrita em /sys/kernel/debug/ir_remote/reset zera a telemetria
+static ssize_t ir_stats_reset_write(struct file *file, const char __user *buf, size_t len, loff_t *off) {
+    spin_lock(&ir_stats_lock);
+    memset(&ir_stats, 0, sizeof(ir_stats));
+    spin_unlock(&ir_stats_lock);
+    return len;
+}
+
+static const struct file_operations ir_stats_reset_fops = {
+    .owner = THIS_MODULE,
+    .write = ir_stats_reset_write,
+    .llseek = noop_llseek,
+};
+
+
+// O firmware devolve "... id=<hex> rx=<us> done=<us>" no [OK] de um comando
+// com id: publica os carimbos do relógio dele para alinhar com o do kernel.
+static void ir_trace_device_ts(const char *reply) {
+    const char *p = strstr(reply, " id=");
+    unsigned long long id, rx_us, done_us;
+
+    if (!p || sscanf(p, " id=%llx rx=%llu done=%llu", &id, &rx_us, &done_us) != 3)
+        return;
+    if (id != ir_cmd_id)
+        pr_debug("IR_REMOTE: [OK] com id %llx, esperado %llx\n", id, ir_cmd_id);
+    trace_ir_remote_device_ts(id, rx_us, done_us);
+}
+
+
+// RESPOSTAS DO FIRMWARE
+// As respostas chegam em pedaços de até usb_max_size bytes. O framer monta
+// as linhas num buffer fixo, lendo cada byte uma única vez, e entrega cada
+// linha completa ao waiter do comando em curso (um por vez, sob ir_lock).
+
+struct ir_framer {
+    char line[MAX_RECV_LINE];
+    unsigned int len;
+    bool complete;      // line tem uma linha entregue; a próxima começa do zero
+    bool overflow;      // linha maior que o buffer: descartada até o '\n'
+    int tail, tail_end; // usb_in_buffer[tail, tail_end): o que veio depois da linha entregue
+};
+static struct ir_framer ir_framer;
+
+// O que encerra o comando em curso
+struct ir_waiter {
+    const char *ok_prefix;      // NULL: espera a linha "REC " do LAST_RECV
+    char *reply;                // recebe a linha que encerrou (pode ser NULL)
+    size_t reply_len;
+};
+
+static void ir_framer_reset(struct ir_framer *f) {
+    f->len = 0;
+    f->complete = false;
+    f->overflow = false;
+    f->tail = f->tail_end = 0;
+}
+
+// Consome buf a partir de *pos até completar uma linha. Retorna true com a
+// linha (sem "\r\n") em f->line; *pos fica logo após o '\n'.
+static bool ir_framer_next(struct ir_framer *f, const char *buf, int len, int *pos) {
+    while (*pos < len) {
+        const char *start = buf + *pos;
+        const char *nl = memchr(start, '\n', len - *pos);
+        unsigned int seg = nl ? nl - start : len - *pos;
+        unsigned int room;
+
+        if (f->complete)
+            ir_framer_reset(f);
+        room = sizeof(f->line) - 1 - f->len;
+        if (seg > room)
+            f->overflow = true;
+        memcpy(f->line + f->len, start, min(seg, room));
+        f->len += min(seg, room);
+        *pos += seg + (nl ? 1 : 0);
+        if (!nl)
+            return false;
+
+        if (f->len && f->line[f->len - 1] == '\r')
+            f->len--;
+        f->line[f->len] = '\0';
+        f->complete = true;
+        if (f->overflow) {
+            printk(KERN_WARNING "IR_REMOTE: Linha de resposta maior que %d bytes, descartada.\n",
+                   MAX_RECV_LINE - 1);
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+// 1 se a linha encerra o comando com sucesso, -EIO se é um [ERR] e 0 se
+// não é para este waiter ([DBG], [OK] atrasado de outro comando, etc.).
+// O prefixo precisa terminar a palavra: "[OK] TX" não casa "[OK] TXC".
+static int ir_waiter_match(const struct ir_waiter *w, const char *line) {
+    size_t n;
+
+    if (!strncmp(line, "[ERR]", 5))
+        return -EIO;
+    if (!w->ok_prefix)
+        return strncmp(line, "REC ", 4) ? 0 : 1;
+    n = strlen(w->ok_prefix);
+    if (!strncmp(line, w->ok_prefix, n) && (line[n] == ' ' || line[n] == '\0'))
+        return 1;
+    return 0;
+}
+
+// Lê o bulk IN até o waiter receber sua linha. Retorna 1, -EIO (como
+// ir_waiter_match), 0 em timeout ou o código negativo do USB.
+static int ir_wait_reply(struct ir_waiter *w, int attempts, int read_timeout_ms,
+                         ktime_t t0, int *retries) {
+    int ret, actual_size, pos;
+    bool first_byte = false;
+
+    ir_framer_reset(&ir_framer);
+    pr_debug("IR_REMOTE: Iniciando leitura USB (%d tentativas, timeout=%dms)\n", attempts, read_timeout_ms);
     while (attempts-- > 0) {
         ret = usb_bulk_msg(ir_device, usb_rcvbulkpipe(ir_device, usb_in),
                            usb_in_buffer, usb_max_size, &actual_size, read_timeout_ms);
 
-        if (ret == -ETIMEDOUT || actual_size == 0) {
+        if (ret == -ETIMEDOUT || (!ret && actual_size == 0)) {
+            (*retries)++;
             msleep(10); // evita travar CPU
             continue;
         } else if (ret) {
             printk(KERN_ERR "IR_REMOTE: Erro de leitura USB (%d). Código: %d\n", attempts, ret);
-            cleanup_ir(full_response); 
+            trace_ir_remote_error("bulk_in", ret);
+            return ret;
+        }
+
+        if (!first_byte) {
+            s64 us = ktime_us_delta(ktime_get(), t0);
+            first_byte = true;
+            trace_ir_remote_first_byte(actual_size, *retries, us);
+            ir_stats_first_byte(us);
+        }
+        ir_stats_bytes(0, actual_size);
+        pr_debug("IR_REMOTE: Recebido [%d bytes]: '%.*s'\n", actual_size, actual_size, usb_in_buffer);
+
+        pos = 0;
+        while (ir_framer_next(&ir_framer, usb_in_buffer, actual_size, &pos)) {
+            ret = ir_waiter_match(w, ir_framer.line);
+            if (!ret) {
+                pr_debug("IR_REMOTE: Linha ignorada: '%s'\n", ir_framer.line);
+                continue;
+            }
+            if (w->reply)
+                snprintf(w->reply, w->reply_len, "%s", ir_framer.line);
+            // O resto do pacote já pode ser do comando seguinte (quadros do CAP START)
+            ir_framer.tail = pos;
+            ir_framer.tail_end = actual_size;
+            trace_ir_remote_ack(ir_cmd_id, ir_framer.line, ret > 0, ktime_us_delta(ktime_get(), t0));
             return ret;
         }
+    }
+    return 0;
+}
 
-        usb_in_buffer[actual_size] = '\0';
-        strncat(full_response, usb_in_buffer, MAX_RECV_LINE - strlen(full_response) - 1);
-        printk(KERN_INFO "DEBUG: Recebido [%d bytes]: '%s'\n", actual_size, usb_in_buffer);
 
-        // Procura por [OK] ou [ERR]
-        start_ptr = strstr(full_response, expected_ok_prefix);
-        if (!start_ptr)
-            start_ptr = strstr(full_response, "[ERR]");
+// ENVIO IR VIA USB 
+// Envia uma linha de comando já formatada (terminada em '\n') e aguarda a
+// resposta que começa com expected_ok_prefix ou com "[ERR]". Se reply não
+// for NULL, copia a linha de resposta para ela. settle_ms é a pausa antes
+// da primeira leitura e attempts o número de leituras de 200 ms.
+// Retorna 1 em sucesso, -EIO se o firmware respondeu [ERR], 0 em timeout
+// ou o código negativo do USB.
+static int __usb_cmd_wait_reply(const char *line, const char *expected_ok_prefix,
+                                char *reply, size_t reply_len,
+                                unsigned int settle_ms, int attempts) {
+    struct ir_waiter w = { .ok_prefix = expected_ok_prefix, .reply = reply, .reply_len = reply_len };
+    int ret, actual_size;
+    int retries = 0;
+    ktime_t t0;
 
-        if (start_ptr) {
-            newline_ptr = strchr(start_ptr, '\n');
-            if (newline_ptr)
-                *newline_ptr = '\0';
+    // Desconectado: o chamador decide se espera a reconexão
+    if (!ir_device)
+        return -ENODEV;
+    ret = ir_pm_get();
+    if (ret)
+        return ret;
 
-            printk(KERN_INFO "IR_REMOTE: Resposta recebida: '%s'\n", start_ptr);
+    strscpy(usb_out_buffer, line, MAX_RECV_LINE);
+    pr_debug("IR_REMOTE: Enviando comando: '%s'\n", usb_out_buffer);
 
-            if (!strncmp(start_ptr, expected_ok_prefix, strlen(expected_ok_prefix))) {
-                printk(KERN_INFO "IR_REMOTE: Comando executado com sucesso.\n");
-                snprintf(last_ir_command, MAX_RECV_LINE, "%s", full_command);
-                ret = 1;
-                cleanup_ir(full_response);
-                return ret;
-            } else {
-                printk(KERN_ERR "IR_REMOTE: Firmware retornou erro: %s\n", start_ptr);
-                ret = -EIO;
-                cleanup_ir(full_response);
-                return ret;
-            }
+    // Envia comando para o ESP32 via USB
+    trace_ir_remote_submit(ir_cmd_id, usb_out_buffer, strlen(usb_out_buffer));
+    t0 = ktime_get();
+    ret = usb_bulk_msg(ir_device, usb_sndbulkpipe(ir_device, usb_out),
+                       usb_out_buffer, strlen(usb_out_buffer), &actual_size, 1000);
+    trace_ir_remote_bulk_out_done(ret, actual_size, ktime_us_delta(ktime_get(), t0));
+    if (ret) {
+        printk(KERN_ERR "IR_REMOTE: Falha ao enviar comando! Código %d\n", ret);
+        trace_ir_remote_error("bulk_out", ret);
+        ir_stats_finish(ret, 0, 0);
+        goto out;
+    }
+    ir_stats_bytes(actual_size, 0);
+    // Pequena pausa para o ESP32 processar
+    if (settle_ms)
+        msleep(settle_ms);
+
+    // timeout curto (200ms) por leitura para evitar travar
+    ret = ir_wait_reply(&w, attempts, 200, t0, &retries);
+    if (ret > 0) {
+        pr_debug("IR_REMOTE: Comando executado com sucesso.\n");
+        if (ir_cmd_id)
+            ir_trace_device_ts(ir_framer.line);
+    } else if (ret == -EIO) {
+        printk(KERN_ERR "IR_REMOTE: Firmware retornou erro: %s\n", ir_framer.line);
+    } else if (ret == 0) {
+        printk(KERN_WARNING "IR_REMOTE: Nenhuma resposta recebida (timeout após várias tentativas).\n");
+        trace_ir_remote_timeout(ir_cmd_id, line, retries, ktime_us_delta(ktime_get(), t0));
+    }
+    ir_stats_finish(ret, ktime_us_delta(ktime_get(), t0), retries);
+out:
+    ir_pm_put();
+    return ret;
+}
+
+static int usb_cmd_wait_reply(const char *line, const char *expected_ok_prefix,
+                              char *reply, size_t reply_len) {
+    return __usb_cmd_wait_reply(line, expected_ok_prefix, reply, reply_len, 50, 10);
+}
+
+// RELÓGIO DO FIRMWARE (SYNC / TX_AT)
+
+// Chamar com ir_lock. Troca IR_SYNC_SAMPLES linhas SYNC e fica com a de
+// menor atraso USB como novo ponto de referência. O tempo dos bytes na UART
+// sai de cada lado: o firmware carimba o rx depois do '\n' do SYNC e o tx
+// antes do primeiro byte da resposta. Dois pontos a pelo menos
+// IR_DRIFT_MIN_NS um do outro dão a deriva (média móvel de 1/4).
+static int ir_clock_sync(void) {
+    char reply[64];
+    struct ir_waiter w = { .ok_prefix = "[OK] SYNC", .reply = reply, .reply_len = sizeof(reply) };
+    s64 best = S64_MAX, host_ns = 0, dev_us = 0;
+    long long rx, tx;
+    int i, ret, actual_size, retries;
+    ktime_t t0;
+
+    if (!ir_device)
+        return -ENODEV;
+    ret = ir_pm_get();
+    if (ret)
+        return ret;
+
+    for (i = 0; i < IR_SYNC_SAMPLES; i++) {
+        s64 up, down, delay;
+
+        retries = 0;
+        strscpy(usb_out_buffer, "SYNC\n", MAX_RECV_LINE);
+        t0 = ktime_get();
+        ret = usb_bulk_msg(ir_device, usb_sndbulkpipe(ir_device, usb_out),
+                           usb_out_buffer, 5, &actual_size, 1000);
+        if (ret) {
+            ir_stats_finish(ret, 0, 0);
+            break;
+        }
+        ir_stats_bytes(actual_size, 0);
+        ret = ir_wait_reply(&w, 5, 50, t0, &retries);
+        down = ktime_to_ns(ktime_get());
+        ir_stats_finish(ret, div_s64(down - ktime_to_ns(t0), NSEC_PER_USEC), retries);
+        if (ret < 0 && ret != -EIO)
+            break;
+        if (ret <= 0 || sscanf(reply, "[OK] SYNC rx=%lld tx=%lld", &rx, &tx) != 2)
+            continue;
+
+        up = ktime_to_ns(t0) + 5 * IR_UART_BYTE_NS;
+        down -= (strlen(reply) + 1) * IR_UART_BYTE_NS;
+        delay = (down - up) - (tx - rx) * NSEC_PER_USEC;
+        if (delay < best) {
+            best = delay;
+            host_ns = up + (down - up) / 2;
+            dev_us = rx + (tx - rx) / 2;
         }
     }
+    ir_pm_put();
+
+    if (best == S64_MAX) {
+        spin_lock(&ir_stats_lock);
+        ir_stats.sync_errors++;
+        spin_unlock(&ir_stats_lock);
+        printk(KERN_WARNING "IR_REMOTE: SYNC sem resposta válida (código %d).\n", ret);
+        return (ret < 0 && ret != -EIO) ? ret : -ETIMEDOUT;
+    }
+
+    // Um erro acima de IR_DRIFT_MAX_PPB é reset do ESP32, não deriva
+    if (ir_clock.valid) {
+        s64 span = host_ns - ir_clock.host_ns;
+        s64 err = (dev_us - ir_clock.dev_us) * NSEC_PER_USEC - span;
 
-    printk(KERN_WARNING "IR_REMOTE: Nenhuma resposta recebida (timeout após várias tentativas).\n");
-    cleanup_ir(full_response);
+        if (span >= IR_DRIFT_MIN_NS && span <= (s64)IR_SYNC_MAX_MS * NSEC_PER_MSEC &&
+            abs(err) <= div_s64(span * IR_DRIFT_MAX_PPB, NSEC_PER_SEC)) {
+            s64 ppb = div64_s64(err * NSEC_PER_SEC, span);
+
+            ir_clock.drift_ppb = ir_clock.drift_valid ? (3 * ir_clock.drift_ppb + ppb) / 4 : ppb;
+            ir_clock.drift_valid = true;
+        }
+    }
+    ir_clock.valid = true;
+    ir_clock.host_ns = host_ns;
+    ir_clock.dev_us = dev_us;
+    ir_clock.delay_us = div_s64(best, NSEC_PER_USEC);
+
+    spin_lock(&ir_stats_lock);
+    ir_stats.syncs++;
+    ir_hist_add(ir_stats.sync_delay_us, IR_HIST_BUCKETS, ir_clock.delay_us);
+    spin_unlock(&ir_stats_lock);
+    trace_ir_remote_clock_sync(dev_us - div_s64(host_ns, NSEC_PER_USEC), ir_clock.delay_us,
+                               ir_clock.drift_valid ? ir_clock.drift_ppb : 0);
+    pr_debug("IR_REMOTE: Relógio sincronizado (atraso %lld us, deriva %lld ppb).\n",
+             ir_clock.delay_us, ir_clock.drift_ppb);
     return 0;
 }
 
+// Chamar com ir_lock. Converte "AT <ns> <ch> <freq> <us,...>" (ns do
+// ktime_get) em "TX_AT <µs do firmware> <ch> <freq> <us,...>", refazendo
+// a sincronização se ela tiver mais que sync_ms.
+static int ir_format_tx_at(char *out, size_t len, const char *cmd) {
+    unsigned int max_ms = min(sync_ms, (unsigned int)IR_SYNC_MAX_MS);
+    long long at_ns;
+    s64 now, d;
+    int off = 0, ret;
 
-// Função Específica para buscar dados (Receive) com lógica de Acumulação
-static int usb_request_last_recv(void) {
+    if (sscanf(cmd, "AT %lld %n", &at_ns, &off) != 1 || !off)
+        return -EINVAL;
+    now = ktime_to_ns(ktime_get());
+    if (at_ns <= now)
+        return -ETIME;
+    if (at_ns - now > IR_TX_AT_MAX_NS)
+        return -ERANGE;
+
+    if (!ir_clock.valid || now - ir_clock.host_ns >= (s64)max_ms * NSEC_PER_MSEC) {
+        ret = ir_clock_sync();
+        if (ret)
+            return ret;
+    }
+
+    d = at_ns - ir_clock.host_ns;
+    if (ir_clock.drift_valid)
+        d += div_s64(d * ir_clock.drift_ppb, NSEC_PER_SEC);
+    snprintf(out, len, "TX_AT %lld %s\n", ir_clock.dev_us + div_s64(d, NSEC_PER_USEC), cmd + off);
+    return 0;
+}
+
+// UPLOAD EM PARTES (BEGIN / CHUNK / COMMIT)
+
+// Padrão de um comando de transmit, decodificado para o upload
+struct ir_upload {
+    unsigned int ch;
+    char carrier[24];       // "<freqHz>[:duty]", repassado como está
+    __le16 *us;             // fatias em µs, na ordem de bytes do CRC do firmware
+    unsigned int n;
+    u32 total_us;
+};
+
+// Bytes de uma linha que o firmware aceita, com o '\0'
+static unsigned int ir_line_room(void) {
+    return min_t(unsigned int, ir_caps.line, MAX_RECV_LINE);
+}
+
+// Só padrões (TX, TXC, RAW @ ou "<freqHz> <us,...>") vão em partes, e só
+// quando a linha não cabe no firmware ou passa das fatias de uma linha.
+// prefix_len é o que vai na frente ("@<id> !").
+static bool ir_upload_needed(const char *cmd, int prefix_len) {
+    unsigned int slices = 1;
+    const char *p;
+
+    if (!ir_caps.upload || !strncmp(cmd, "NEC ", 4) || !strncmp(cmd, "AT ", 3))
+        return false;
+    // +5: "TX " na frente, '\n' e '\0'
+    if (strlen(cmd) + prefix_len + 5 > ir_line_room())
+        return true;
+    for (p = cmd; (p = strchr(p, ',')); p++)
+        slices++;
+    return slices > ir_caps.slices;
+}
+
+// Decodifica o padrão de cmd em up (up->us é alocado aqui). -EINVAL se o
+// padrão for inválido ou passar dos limites do upload.
+static int ir_upload_parse(const char *cmd, struct ir_upload *up) {
+    unsigned int mult = 1, max = U16_MAX, i = 0, v;
+    const char *sp;
+    char *copy, *p, *tok;
+    int off = 0, ret = -EINVAL;
+
+    up->ch = 0;
+    if (!strncmp(cmd, "TXC ", 4)) {
+        if (sscanf(cmd + 4, "%u %n", &up->ch, &off) != 1 || !off)
+            return -EINVAL;
+        cmd += 4 + off;
+    } else if (!strncmp(cmd, "RAW @", 5)) {
+        cmd += 5;
+        mult = IR_RAW_TICK_US;
+        max = 255;
+    } else if (!strncmp(cmd, "TX ", 3)) {
+        cmd += 3;
+    }
+
+    sp = strchr(cmd, ' ');
+    if (!sp || sp == cmd || sp - cmd >= sizeof(up->carrier))
+        return -EINVAL;
+    memcpy(up->carrier, cmd, sp - cmd);
+    up->carrier[sp - cmd] = '\0';
+
+    copy = kstrdup(sp + 1, GFP_KERNEL);
+    if (!copy)
+        return -ENOMEM;
+    up->n = 1;
+    for (p = copy; (p = strchr(p, ',')); p++)
+        up->n++;
+    if (up->n > ir_caps.upload)
+        goto out;
+    up->us = kmalloc_array(up->n, sizeof(*up->us), GFP_KERNEL);
+    if (!up->us) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    up->total_us = 0;
+    p = copy;
+    while ((tok = strsep(&p, ","))) {
+        if (kstrtouint(tok, 10, &v) || v == 0 || v > max)
+            goto out;
+        up->us[i++] = cpu_to_le16(v * mult);
+        up->total_us += v * mult;
+    }
+    if (up->total_us <= ir_caps.maxus)
+        ret = 0;
+out:
+    kfree(copy);
+    if (ret) {
+        kfree(up->us);
+        up->us = NULL;
+    }
+    return ret;
+}
+
+// Chamar com ir_lock. Manda o padrão de cmd em partes: BEGIN com o canal,
+// a portadora e o total; CHUNKs do tamanho da linha do firmware, cada um
+// com o offset e o CRC das suas fatias (um CRC recusado é reenviado); e o
+// COMMIT com o CRC do padrão inteiro. Só o COMMIT transmite, e é ele que
+// leva o "@<id> ". O "!" vai no BEGIN (o ABORT não descarta a montagem de
+// um TX interativo) e no COMMIT. As linhas vão sem a pausa de 50 ms: o
+// firmware responde cada uma assim que ela chega.
+// Retorna como usb_cmd_wait_reply, com a linha que encerrou em reply.
+static int ir_send_upload(const char *cmd, u64 id, bool hi, char *reply, size_t reply_len) {
+    const char *bang = (hi && strstr(ir_caps.proto, "ABORT")) ? "!" : "";
+    unsigned int room = ir_line_room() - 1;
+    struct ir_upload up = {};
+    unsigned int off, k, i, len, tries;
+    char *line;
+    int ret, n = 0;
+
+    ret = ir_upload_parse(cmd, &up);
+    if (ret) {
+        printk(KERN_ERR "IR_REMOTE: Padrao invalido para o upload em partes (max. %u fatias, %u us).\n",
+               ir_caps.upload, ir_caps.maxus);
+        return ret;
+    }
+    line = kmalloc(MAX_RECV_LINE, GFP_KERNEL);
+    if (!line) {
+        kfree(up.us);
+        return -ENOMEM;
+    }
+
+    snprintf(line, MAX_RECV_LINE, "%sBEGIN %u %s %u %u\n", bang, up.ch, up.carrier, up.n, up.total_us);
+    ret = __usb_cmd_wait_reply(line, "[OK] BEGIN", reply, reply_len, 0, 10);
+
+    for (off = 0; ret > 0 && off < up.n; off += k) {
+        // Quantas fatias cabem depois de "CHUNK <off> <crc> ", com o '\n'
+        len = snprintf(NULL, 0, "CHUNK %u ffff ", off) + 1;
+        for (k = 0; off + k < up.n && k < ir_caps.slices; k++) {
+            unsigned int w = snprintf(NULL, 0, "%u", le16_to_cpu(up.us[off + k])) + (k ? 1 : 0);
+
+            if (len + w > room)
+                break;
+            len += w;
+        }
+
+        len = scnprintf(line, MAX_RECV_LINE, "CHUNK %u %04x ", off,
+                        crc_itu_t(0xffff, (const u8 *)&up.us[off], k * sizeof(*up.us)));
+        for (i = 0; i < k; i++)
+            len += scnprintf(line + len, MAX_RECV_LINE - len, i ? ",%u" : "%u",
+                             le16_to_cpu(up.us[off + i]));
+        scnprintf(line + len, MAX_RECV_LINE - len, "\n");
+
+        for (tries = 0; ; tries++) {
+            ret = __usb_cmd_wait_reply(line, "[OK] CHUNK", reply, reply_len, 0, 10);
+            if (ret != -EIO || strncmp(reply, "[ERR] CHUNK crc", 15) || tries >= IR_UPLOAD_RETRIES)
+                break;
+            spin_lock(&ir_stats_lock);
+            ir_stats.chunk_retries++;
+            spin_unlock(&ir_stats_lock);
+        }
+        spin_lock(&ir_stats_lock);
+        ir_stats.chunks++;
+        spin_unlock(&ir_stats_lock);
+    }
+
+    if (ret > 0) {
+        if (id)
+            n = snprintf(line, MAX_RECV_LINE, "@%llx ", id);
+        snprintf(line + n, MAX_RECV_LINE - n, "%sCOMMIT %04x\n", bang,
+                 crc_itu_t(0xffff, (const u8 *)up.us, up.n * sizeof(*up.us)));
+        // No canal 0 o [OK] só vem no fim da transmissão (até maxus)
+        ir_cmd_id = id;
+        ret = __usb_cmd_wait_reply(line, "[OK] COMMIT", reply, reply_len, 0,
+                                   10 + DIV_ROUND_UP(up.total_us, 200 * USEC_PER_MSEC));
+        ir_cmd_id = 0;
+        if (ret > 0) {
+            spin_lock(&ir_stats_lock);
+            ir_stats.uploads++;
+            spin_unlock(&ir_stats_lock);
+        }
+    }
+
+    kfree(line);
+    kfree(up.us);
+    return ret;
+}
+
+// Envia o comando IR completo (string) via USB. Com id != 0 a linha vai
+// prefixada por "@<hex> " para o firmware ecoar o id no [OK]; com hi, o
+// comando leva o "!" (não é cortado e interrompe a macro do firmware).
+// Retorna como usb_cmd_wait_reply, ou -ECANCELED se um ABORT cortou o TX.
+// O TX agendado ("AT ...") volta com -ETIME se o instante já passou quando
+// chegou ao firmware e com o erro da sincronização se ela falhar. Um padrão
+// que não cabe numa linha do firmware vai em partes (ir_send_upload).
+static int usb_send_cmd_ir(char *full_command, u64 id, bool hi) {
+    int ret, n = 0;
+    char final_command[MAX_RECV_LINE] = {0};
+    char reply[64] = "";
+    char *expected_ok_prefix;
+
+    if (id)
+        n = snprintf(final_command, MAX_RECV_LINE, "@%llx ", id);
+    if (hi && strstr(ir_caps.proto, "ABORT"))
+        n += snprintf(final_command + n, MAX_RECV_LINE - n, "!");
+
+    if (ir_upload_needed(full_command, n)) {
+        expected_ok_prefix = "[OK] COMMIT";
+        ret = ir_send_upload(full_command, id, hi, reply, sizeof(reply));
+        goto sent;
+    }
+    // Só padrões vão em partes: o resto precisa caber numa linha
+    if (strlen(full_command) + n + 5 > MAX_RECV_LINE) {
+        printk(KERN_ERR "IR_REMOTE: Comando IR muito longo. Max: %d\n", MAX_RECV_LINE - 4);
+        return -EINVAL;
+    }
+
+    // Monta o comando
+    if (strncmp(full_command, "NEC ", 4) == 0) {
+        // full_command já vem como "NEC <HEX8>"
+        snprintf(final_command + n, MAX_RECV_LINE - n, "%s\n", full_command);
+        expected_ok_prefix = "[OK] NEC";
+    } else if (strncmp(full_command, "TXC ", 4) == 0) {
+        snprintf(final_command + n, MAX_RECV_LINE - n, "%s\n", full_command);
+        expected_ok_prefix = "[OK] TXC";
+    } else if (strncmp(full_command, "RAW ", 4) == 0) {
+        // Forma compacta da HAL: RAW @<freqHz> <b,b,...>
+        snprintf(final_command + n, MAX_RECV_LINE - n, "%s\n", full_command);
+        expected_ok_prefix = "[OK] RAW";
+    } else if (strncmp(full_command, "AT ", 3) == 0) {
+        ret = ir_format_tx_at(final_command + n, MAX_RECV_LINE - n, full_command);
+        if (ret)
+            return ret;
+        expected_ok_prefix = "[OK] TX_AT";
+    } else {
+        snprintf(final_command + n, MAX_RECV_LINE - n, "TX %s\n", full_command);
+        expected_ok_prefix = "[OK] TX";
+    }
+
+    ir_cmd_id = id;
+    ret = usb_cmd_wait_reply(final_command, expected_ok_prefix, reply, sizeof(reply));
+    ir_cmd_id = 0;
+sent:
+    if (ret > 0)
+        snprintf(last_ir_command, MAX_RECV_LINE, "%s", full_command);
+    if (ret == -EIO && !strncmp(reply, "[ERR] abortado", 14)) {
+        spin_lock(&ir_stats_lock);
+        ir_stats.preempted++;
+        spin_unlock(&ir_stats_lock);
+        ret = -ECANCELED;
+    }
+    if (!strncmp(expected_ok_prefix, "[OK] TX_AT", 10)) {
+        const char *p = strstr(reply, " lead=");
+        long long lead;
+
+        if (ret > 0 && p && sscanf(p, " lead=%lld", &lead) == 1) {
+            spin_lock(&ir_stats_lock);
+            ir_stats.tx_at++;
+            ir_hist_add(ir_stats.tx_at_lead_us, IR_HIST_BUCKETS, lead);
+            spin_unlock(&ir_stats_lock);
+        } else if (ret == -EIO && !strncmp(reply, "[ERR] TX_AT", 11)) {
+            // Atrasado ou longe demais: o firmware pode ter reiniciado o relógio
+            ir_clock.valid = false;
+            if (strstr(reply, "atrasado"))
+                ret = -ETIME;
+        }
+    }
+    return ret;
+}
+
+
+// Função Específica para buscar dados (Receive): a linha "REC ..." pode
+// vir depois de [DBG] e do "[OK] REC armazenado"; o framer descarta essas.
+static int ir_fetch_last_recv(void) {
+    struct ir_waiter w = { .ok_prefix = NULL, .reply = cached_recv_buffer,
+                           .reply_len = MAX_RECV_LINE };
     int ret, actual_size;
-    int attempts = 20; 
-    char *line_start;
-    char *line_end;
-    
-    // Buffer temporário para ler TUDO
-    char *raw_buffer = kmalloc(MAX_RECV_LINE, GFP_KERNEL);
-    if (!raw_buffer) return -ENOMEM;
+    int retries = 0;
+    ktime_t t0;
 
     // 1. Envia o comando
-    memset(usb_out_buffer, 0, MAX_RECV_LINE);
     snprintf(usb_out_buffer, MAX_RECV_LINE, "LAST_RECV\n"); 
 
-    printk(KERN_INFO "IR_REMOTE: Enviando trigger LAST_RECV...\n");
+    pr_debug("IR_REMOTE: Enviando trigger LAST_RECV...\n");
 
+    trace_ir_remote_submit(0, usb_out_buffer, strlen(usb_out_buffer));
+    t0 = ktime_get();
     ret = usb_bulk_msg(ir_device, usb_sndbulkpipe(ir_device, usb_out),
                        usb_out_buffer, strlen(usb_out_buffer), &actual_size, 1000);
+    trace_ir_remote_bulk_out_done(ret, actual_size, ktime_us_delta(ktime_get(), t0));
     if (ret) {
-        kfree(raw_buffer);
+        trace_ir_remote_error("bulk_out", ret);
+        ir_stats_finish(ret, 0, 0);
         return ret;
     }
+    ir_stats_bytes(actual_size, 0);
 
-    // 2. Limpa buffers
-    memset(raw_buffer, 0, MAX_RECV_LINE);
+    // 2. Limpa o cache
     memset(cached_recv_buffer, 0, MAX_RECV_LINE); 
 
     // 3. Loop de Leitura
-    while (attempts-- > 0) {
-        memset(usb_in_buffer, 0, MAX_RECV_LINE);
-        
-        ret = usb_bulk_msg(ir_device, usb_rcvbulkpipe(ir_device, usb_in),
-                           usb_in_buffer, usb_max_size, &actual_size, 100);
+    ret = ir_wait_reply(&w, 20, 100, t0, &retries);
+    ir_stats_finish(ret, ktime_us_delta(ktime_get(), t0), retries);
+    if (ret > 0) {
+        pr_debug("IR_REMOTE: Resposta recebida: '%s'\n", cached_recv_buffer);
+        return 0; // Sucesso Total
+    }
+    if (ret == -EIO) {
+        printk(KERN_ERR "IR_REMOTE: Firmware retornou erro: %s\n", cached_recv_buffer);
+        memset(cached_recv_buffer, 0, MAX_RECV_LINE);
+        return ret;
+    }
+    if (ret < 0)
+        return ret;
 
-        if (ret == -ETIMEDOUT || actual_size == 0) {
-            msleep(10); 
-            continue;
-        } else if (ret) {
-            kfree(raw_buffer);
-            return ret;
-        }
+    printk(KERN_WARNING "IR_REMOTE: Timeout. Assinatura 'REC ' não encontrada.\n");
+    trace_ir_remote_timeout(0, "LAST_RECV", retries, ktime_us_delta(ktime_get(), t0));
+    return -ETIMEDOUT;
+}
+
+static int usb_request_last_recv(void) {
+    int ret;
 
-        usb_in_buffer[actual_size] = '\0';
+    // Desconectado: o chamador decide se espera a reconexão
+    if (!ir_device)
+        return -ENODEV;
+    ret = ir_pm_get();
+    if (ret)
+        return ret;
+    ret = ir_fetch_last_recv();
+    ir_pm_put();
+    return ret;
+}
 
-        if (strlen(raw_buffer) + actual_size >= MAX_RECV_LINE) {
-             printk(KERN_ERR "IR_REMOTE: Overflow no raw_buffer!\n");
-             break; 
-        }
 
-        strncat(raw_buffer, usb_in_buffer, MAX_RECV_LINE - strlen(raw_buffer) - 1);
-        
-        // Varre o buffer linha por linha procurando uma que comece com "REC "
-        line_start = raw_buffer;
-        while (line_start && *line_start) {
-            // Procura o fim desta linha
-            line_end = strchr(line_start, '\n');
-            
-            // Se achou um \n, analisar essa linha
-            if (line_end) {
-                // Verifica se a linha começa com "REC " (4 caracteres)
-                // Isso ignora "[DBG]" e "[OK] REC..."
-                if (strncmp(line_start, "REC ", 4) == 0) {
-                    // ACHAMOS! Corta a string no \n
-                    *line_end = '\0'; 
-                    // Copia para o buffer final
-                    strncpy(cached_recv_buffer, line_start, MAX_RECV_LINE);
-                    printk(KERN_INFO "IR_REMOTE: Resposta recebida: '%s'\n", cached_recv_buffer);
-                    kfree(raw_buffer);
-                    return 0; // Sucesso Total
-                }
-                // Se não for essa linha, avança para a próxima (pula o \n)
-                line_start = line_end + 1;
+// Consulta as capacidades do firmware (CAPS) uma única vez, no probe.
+// Firmware antigo responde [ERR] ao comando desconhecido: mantém os
+// valores padrão (canal único, limites do IRremote).
+static void ir_query_caps(void) {
+    char reply[256];
+    const char *p;
+
+    ir_caps = (struct ir_caps) {
+        .fmin = 1000, .fmax = 255000, .slices = 256, .maxus = 2000000,
+        .channels = 1, .line = 512, .rec = 512, .proto = "NEC,TX",
+    };
+
+    if (usb_cmd_wait_reply("CAPS\n", "[OK] CAPS", reply, sizeof(reply)) > 0) {
+        // Chaves ausentes mantêm o padrão; a ordem não importa
+        if ((p = strstr(reply, "fmin=")))   sscanf(p, "fmin=%u", &ir_caps.fmin);
+        if ((p = strstr(reply, "fmax=")))   sscanf(p, "fmax=%u", &ir_caps.fmax);
+        if ((p = strstr(reply, "slices="))) sscanf(p, "slices=%u", &ir_caps.slices);
+        if ((p = strstr(reply, "maxus=")))  sscanf(p, "maxus=%u", &ir_caps.maxus);
+        if ((p = strstr(reply, "ch=")))     sscanf(p, "ch=%u", &ir_caps.channels);
+        if ((p = strstr(reply, "line=")))   sscanf(p, "line=%u", &ir_caps.line);
+        if ((p = strstr(reply, "rec=")))    sscanf(p, "rec=%u", &ir_caps.rec);
+        if ((p = strstr(reply, "proto=")))  sscanf(p, "proto=%95s", ir_caps.proto);
+        if ((p = strstr(reply, "macros="))) sscanf(p, "macros=%u", &ir_caps.macros);
+        if ((p = strstr(reply, "steps=")))  sscanf(p, "steps=%u", &ir_caps.steps);
+        if ((p = strstr(reply, "upload="))) sscanf(p, "upload=%u", &ir_caps.upload);
+    }
+    if (!strstr(ir_caps.proto, "UPLOAD"))
+        ir_caps.upload = 0;
+    if (ir_caps.channels == 0)
+        ir_caps.channels = 1;
+
+    printk(KERN_INFO "IR_REMOTE: CAPS f=%u-%u Hz, %u fatias, %u us, %u canal(is), proto=%s\n",
+           ir_caps.fmin, ir_caps.fmax, ir_caps.slices, ir_caps.maxus, ir_caps.channels, ir_caps.proto);
+}
+
+// Chamar com ir_lock. Aplica fw_sleep_ms no firmware (0 desliga o
+// light-sleep); firmware sem SLEEP no CAPS nunca dorme. Se o firmware
+// recusar, o driver continua mandando a linha de despertar por garantia.
+static void ir_config_fw_sleep(void) {
+    char line[32];
+
+    if (!strstr(ir_caps.proto, "SLEEP")) {
+        ir_fw_sleep_ms = 0;
+        return;
+    }
+    snprintf(line, sizeof(line), "SLEEP %u\n", fw_sleep_ms);
+    if (usb_cmd_wait_reply(line, "[OK] SLEEP", NULL, 0) > 0)
+        ir_fw_sleep_ms = fw_sleep_ms;
+    else
+        printk(KERN_WARNING "IR_REMOTE: Firmware recusou SLEEP %u.\n", fw_sleep_ms);
+}
+
+
+// SESSÃO DE CAPTURA CONTÍNUA
+
+// Entrega uma duração ao kfifo; descarta (e conta) se o leitor não acompanhar
+static void cap_push(s32 value) {
+    if (!kfifo_put(&cap_fifo, value))
+        cap_dropped++;
+    else
+        cap_samples++;
+}
+
+// Decodificador dos quadros binários; o estado atravessa os pacotes
+struct cap_decoder {
+    enum { CAP_WAIT_SYNC, CAP_COUNT, CAP_LO, CAP_HI } state;
+    int remaining;
+    u16 entry;
+    s32 pending;        // entradas consecutivas do mesmo nível, somadas
+};
+
+static void cap_decode(struct cap_decoder *d, const u8 *buf, int len) {
+    int i;
+
+    for (i = 0; i < len && !cap_stream_ended; i++) {
+        u8 b = buf[i];
+
+        switch (d->state) {
+        case CAP_WAIT_SYNC:
+            // Linhas ASCII ([OK] CAP START etc.) nunca contêm 0xA5
+            if (b == CAP_SYNC)
+                d->state = CAP_COUNT;
+            break;
+        case CAP_COUNT:
+            d->remaining = b;
+            if (d->remaining == 0)
+                cap_stream_ended = true;
+            else
+                d->state = CAP_LO;
+            break;
+        case CAP_LO:
+            d->entry = b;
+            d->state = CAP_HI;
+            break;
+        case CAP_HI: {
+            s32 us;
+
+            d->entry |= (u16)b << 8;
+            us = d->entry & 0x7FFF;
+            if (!(d->entry & 0x8000))
+                us = -us;
+
+            if (d->pending && ((d->pending > 0) == (us > 0))) {
+                d->pending += us;
             } else {
-                // Se não tem \n, a linha está incompleta. 
-                // Sai do loop interno e deixa o 'while(attempts)' ler mais dados do USB.
-                break; 
+                if (d->pending)
+                    cap_push(d->pending);
+                d->pending = us;
             }
+            d->state = (--d->remaining > 0) ? CAP_LO : CAP_WAIT_SYNC;
+            break;
+        }
+        }
+    }
+}
+
+// Thread leitora do bulk IN durante a sessão. Começa pelos bytes que vieram
+// junto com o [OK] CAP START (cap_carry) e publica as durações no kfifo.
+static int cap_thread_fn(void *data) {
+    struct cap_decoder d = { .state = CAP_WAIT_SYNC };
+    int ret, actual_size;
+
+    cap_decode(&d, cap_carry, cap_carry_len);
+    wake_up_interruptible(&cap_wait);
+
+    while (!kthread_should_stop() && !cap_stream_ended) {
+        ret = usb_bulk_msg(ir_device, usb_rcvbulkpipe(ir_device, usb_in),
+                           usb_in_buffer, usb_max_size, &actual_size, 100);
+        if (ret == -ETIMEDOUT || actual_size == 0)
+            continue;
+        if (ret) {
+            printk(KERN_ERR "IR_REMOTE: Erro de leitura na captura (código %d)\n", ret);
+            break;
         }
+
+        cap_decode(&d, usb_in_buffer, actual_size);
+        wake_up_interruptible(&cap_wait);
     }
 
-    printk(KERN_WARNING "IR_REMOTE: Timeout. Assinatura 'REC ' não encontrada.\n");
-    // printk(KERN_INFO "IR_REMOTE: Buffer bruto: %s\n", raw_buffer); // Descomente se precisar debugar
-    kfree(raw_buffer);
-    return -ETIMEDOUT;
+    if (d.pending)
+        cap_push(d.pending);
+    cap_stream_ended = true;
+    wake_up_interruptible(&cap_wait);
+
+    // kthread_stop() precisa encontrar a thread viva
+    while (!kthread_should_stop()) {
+        set_current_state(TASK_INTERRUPTIBLE);
+        if (!kthread_should_stop())
+            schedule();
+        __set_current_state(TASK_RUNNING);
+    }
+    return 0;
 }
 
+// O firmware já confirmou o CAP START, mas a sessão não subiu: sem isso ele
+// continuaria mandando quadros para ninguém. O framer ignora os binários.
+static void cap_abort_start(void) {
+    if (usb_cmd_wait_reply("CAP STOP\n", "[OK] CAP STOP", NULL, 0) <= 0)
+        printk(KERN_WARNING "IR_REMOTE: CAP STOP não confirmado após falha no início da captura.\n");
+}
+
+// Chamar com ir_lock
+static int cap_start_session(void) {
+    int ret;
+
+    if (cap_active)
+        return -EBUSY;
+
+    kfifo_reset(&cap_fifo);
+    cap_samples = 0;
+    cap_dropped = 0;
+    cap_stream_ended = false;
+
+    ret = usb_cmd_wait_reply("CAP START\n", "[OK] CAP START", NULL, 0);
+    if (ret <= 0)
+        return ret ? ret : -ETIMEDOUT;
+    // Os primeiros quadros (flush a cada 20 ms) podem ter vindo no mesmo
+    // pacote do [OK], durante os 50 ms de pausa antes da leitura
+    cap_carry_len = ir_framer.tail_end - ir_framer.tail;
+    memcpy(cap_carry, usb_in_buffer + ir_framer.tail, cap_carry_len);
+
+    // O bulk IN fica com a thread: sem autosuspend até o CAP STOP
+    ret = usb_autopm_get_interface(ir_intf);
+    if (ret) {
+        cap_abort_start();
+        return ret;
+    }
+    cap_thread = kthread_run(cap_thread_fn, NULL, "ir_capture");
+    if (IS_ERR(cap_thread)) {
+        ret = PTR_ERR(cap_thread);
+        cap_thread = NULL;
+        usb_autopm_put_interface(ir_intf);
+        cap_abort_start();
+        return ret;
+    }
+    cap_active = true;
+    return 0;
+}
+
+// Chamar com ir_lock (ou no disconnect, quando o dispositivo já sumiu)
+static int cap_stop_session(void) {
+    int actual_size;
+
+    if (!cap_active)
+        return 0;
+
+    // O bulk OUT é independente: a thread continua lendo até o quadro final
+    snprintf(usb_out_buffer, MAX_RECV_LINE, "CAP STOP\n");
+    if (!usb_bulk_msg(ir_device, usb_sndbulkpipe(ir_device, usb_out),
+                      usb_out_buffer, strlen(usb_out_buffer), &actual_size, 1000))
+        wait_event_timeout(cap_wait, cap_stream_ended, msecs_to_jiffies(1000));
+
+    kthread_stop(cap_thread);
+    cap_thread = NULL;
+    cap_active = false;
+    ir_pm_put();
+    wake_up_interruptible(&cap_wait);
+
+    printk(KERN_INFO "IR_REMOTE: Captura encerrada (%lu amostras, %lu descartadas)\n",
+           cap_samples, cap_dropped);
+    return 0;
+}
+
+static ssize_t cap_read(struct file *file, char __user *buf, size_t len, loff_t *off) {
+    unsigned int copied;
+    int ret;
+
+    if (len < sizeof(s32))
+        return -EINVAL;
+
+    if (kfifo_is_empty(&cap_fifo)) {
+        if (!cap_active)
+            return 0; // fim da sessão
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(cap_wait, !kfifo_is_empty(&cap_fifo) || !cap_active);
+        if (ret)
+            return ret;
+    }
+
+    if (mutex_lock_interruptible(&cap_read_lock))
+        return -ERESTARTSYS;
+    ret = kfifo_to_user(&cap_fifo, buf, len - (len % sizeof(s32)), &copied);
+    mutex_unlock(&cap_read_lock);
+
+    return ret ? ret : copied;
+}
+
+static __poll_t cap_poll(struct file *file, poll_table *wait) {
+    __poll_t mask = 0;
+
+    poll_wait(file, &cap_wait, wait);
+    if (!kfifo_is_empty(&cap_fifo))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    else if (!cap_active)
+        mask |= EPOLLHUP;
+    return mask;
+}
+
+static const struct file_operations cap_fops = {
+    .owner  = THIS_MODULE,
+    .read   = cap_read,
+    .poll   = cap_poll,
+    .llseek = noop_llseek,
+};
+
+static struct miscdevice cap_miscdev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name  = "ir_capture",
+    .fops  = &cap_fops,
+    .mode  = 0660,
+};
+
 
 // INTERFACE SYSFS (LEITURA/ESCRITA)
 
@@ -360,34 +1761,41 @@ static ssize_t attr_show_transmit(struct kobject *sys_obj, struct kobj_attribute
     return sprintf(buff, "Último TX enviado: %s\n", last_ir_command);
 }
 
-// Executado quando o arquivo /sys/kernel/infrared/transmit é escrito
-static ssize_t attr_store_transmit(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count) {
+// Trata o comando já sem o '\n' (command é modificado); count é o que
+// volta para a HAL em sucesso
+static ssize_t ir_store_transmit(char *command, size_t count) {
     int ret;
-    // 1. TRATAMENTO DO BUFFER E VALIDAÇÃO DE PROTOCOLO ('\n')
-    char command[MAX_RECV_LINE];
-    size_t data_len = count; // data_len inicial é o tamanho total
     char full_ir_command[MAX_RECV_LINE];
     char *command_payload;
-
-    // O ÚLTIMO CARACTERE DEVE SER '\n' 
-    if (data_len == 0 || buff[data_len - 1] != '\n') {
-        printk(KERN_ERR "IR_REMOTE: Erro de protocolo! A HAL DEVE encerrar o comando com '\\n'.\n");
-        return -EINVAL; // Retorna Erro de Argumento Inválido
+    u64 id = 0;
+    unsigned int gen;
+    int replays = 0;
+    bool hi = false;
+    ktime_t t0 = ktime_get();
+
+    pr_debug("IR_REMOTE: Recebido da HAL: '%s'\n", command);
+
+    // Prefixo opcional "!": TX interativo (veja ir_tx_lock)
+    if (command[0] == '!') {
+        hi = true;
+        memmove(command, command + 1, strlen(command));
     }
-    // Se a validação passou, removemos o '\n' para não enviá-lo para o ESP32
-    data_len--; // Desconsidera o '\n'
 
-    // Garantia de que a string cabe no buffer local
-    if (data_len >= MAX_RECV_LINE - 4) { // -4 para "TX " e '\0'
-        printk(KERN_ERR "IR_REMOTE: Comando IR muito longo. Max: %d\n", MAX_RECV_LINE - 4);
-        return -EINVAL;
+    // Prefixo opcional "@<hex> ": id de correlação do ConsumerIrManager
+    if (command[0] == '@') {
+        char *sp = strchr(command, ' ');
+        if (!sp) {
+            printk(KERN_ERR "IR_REMOTE: Id de correlacao sem comando.\n");
+            return -EINVAL;
+        }
+        *sp = '\0';
+        if (kstrtou64(command + 1, 16, &id)) {
+            printk(KERN_ERR "IR_REMOTE: Id de correlacao invalido: '%s'\n", command + 1);
+            return -EINVAL;
+        }
+        memmove(command, sp + 1, strlen(sp + 1) + 1);
     }
 
-    // 1. Copia o conteúdo da HAL (buff) para a variável local (command)
-    strncpy(command, buff, data_len);
-    command[data_len] = '\0';
-    printk(KERN_INFO "IR_REMOTE: Recebido da HAL: '%s'", command); // Removi o '\n' do log
-
     if (strncmp(command, "NEC ", 4) == 0) {
         // Encontramos o prefixo NEC!
         char *hex_data = command + 4; // Aponta para o dado hexadecimal
@@ -395,11 +1803,36 @@ static ssize_t attr_store_transmit(struct kobject *sys_obj, struct kobj_attribut
         if (strlen(hex_data) == 8) {
             // O ESP32 espera: NEC <HEX8>\n
             snprintf(full_ir_command, MAX_RECV_LINE, "NEC %s", hex_data);
-            printk(KERN_INFO "IR_REMOTE: Protocolo NEC detectado. Comando final: '%s'", full_ir_command);
+            pr_debug("IR_REMOTE: Protocolo NEC detectado. Comando final: '%s'\n", full_ir_command);
         } else {
             printk(KERN_ERR "IR_REMOTE: Protocolo NEC invalido. Esperado: NEC <HEX8> (8 digitos).\n");
             return -EINVAL;
         }
+    } else if (strncmp(command, "TXC ", 4) == 0) {
+        // Canal explícito: TXC <ch> <freqHz> <us,...> (repassado como está)
+        unsigned int ch;
+        if (sscanf(command + 4, "%u", &ch) != 1 || ch >= ir_caps.channels) {
+            printk(KERN_ERR "IR_REMOTE: Canal invalido em TXC. Canais disponiveis: %u\n", ir_caps.channels);
+            return -EINVAL;
+        }
+        snprintf(full_ir_command, MAX_RECV_LINE, "%s", command);
+    } else if (strncmp(command, "RAW @", 5) == 0) {
+        // Padrão quantizado pela HAL em passos de 50 us (repassado como está)
+        snprintf(full_ir_command, MAX_RECV_LINE, "%s", command);
+    } else if (strncmp(command, "AT ", 3) == 0) {
+        // TX agendado: AT <ns do CLOCK_MONOTONIC> <ch> <freqHz> <us,...>;
+        // o instante é convertido para o relógio do firmware no envio
+        long long at_ns;
+        unsigned int ch;
+        if (!strstr(ir_caps.proto, "TX_AT")) {
+            printk(KERN_ERR "IR_REMOTE: Firmware sem TX_AT.\n");
+            return -EOPNOTSUPP;
+        }
+        if (sscanf(command + 3, "%lld %u", &at_ns, &ch) != 2 || ch >= ir_caps.channels) {
+            printk(KERN_ERR "IR_REMOTE: TX agendado invalido. Esperado: AT <ns> <ch> <freqHz> <us,...>\n");
+            return -EINVAL;
+        }
+        snprintf(full_ir_command, MAX_RECV_LINE, "%s", command);
     } else if (strncmp(command, "TX ", 3) == 0 || (command[0] >= '0' && command[0] <= '9')) {
         // Assume que é um comando RAW (TX <dados> ou <dados>) se não for NEC
         // O firmware original espera "TX <dados>", então formatamos para isso se for apenas raw data
@@ -431,22 +1864,112 @@ static ssize_t attr_store_transmit(struct kobject *sys_obj, struct kobj_attribut
         command_payload = command;
     }
 
-    
-    mutex_lock(&ir_lock); 
-    ret = usb_send_cmd_ir(command_payload); // Chamada da função com o comando
-    mutex_unlock(&ir_lock); 
+    // Se o dispositivo cair no meio, o comando é repetido quando ele voltar.
+    // Um TX cujo [OK] se perdeu na queda pode sair duas vezes.
+    do {
+        ret = ir_tx_lock(hi);
+        if (ret)
+            return ret;
+        if (cap_active) {
+            // O bulk IN pertence à thread de captura até o CAP STOP
+            ir_tx_unlock(hi);
+            return -EBUSY;
+        }
+        gen = ir_attach_gen;
+        ret = usb_send_cmd_ir(command_payload, id, hi); // Chamada da função com o comando
+        ir_tx_unlock(hi);
+    } while (ir_retry_after_reconnect(ret, gen, &replays));
 
     // 3. RETORNO E PERSISTÊNCIA:
     if (ret > 0) { // Se o retorno for sucesso (ret == 1)
         // Persiste o comando para que attr_show possa exibi-lo
         snprintf(last_ir_command, MAX_RECV_LINE, "%s", command);
+        if (hi) {
+            spin_lock(&ir_stats_lock);
+            ir_hist_add(ir_stats.hi_us, IR_HIST_BUCKETS, ktime_us_delta(ktime_get(), t0));
+            spin_unlock(&ir_stats_lock);
+        }
         return count; // Retorna o 'count' original (incluindo o '\n' que foi aceito)
+    } else if (ret == -ECANCELED) {
+        // Cortado por um TX interativo; quem mandou decide se repete
+        pr_debug("IR_REMOTE: TX de fundo cortado por um TX interativo.\n");
+        return -ECANCELED;
+    } else if (ret == -ETIME || ret == -ERANGE || ret == -EINVAL) {
+        // TX agendado fora da janela do firmware
+        pr_debug("IR_REMOTE: TX agendado recusado (%d).\n", ret);
+        return ret;
     } else {
         printk(KERN_ALERT "IR_REMOTE: Falha na transmissao. Retorno: %d\n", ret);
         return -EIO; // Retorna erro de I/O para o userspace
     }
 }
 
+// Uma escrita em transmit (sysfs ou /dev/ir_transmit): um comando inteiro,
+// terminado em '\n'
+static ssize_t ir_transmit_line(const char *buff, size_t count) {
+    // 1. TRATAMENTO DO BUFFER E VALIDAÇÃO DE PROTOCOLO ('\n')
+    size_t data_len = count; // data_len inicial é o tamanho total
+    char *command;
+    ssize_t ret;
+
+    // O ÚLTIMO CARACTERE DEVE SER '\n' 
+    if (data_len == 0 || buff[data_len - 1] != '\n') {
+        printk(KERN_ERR "IR_REMOTE: Erro de protocolo! A HAL DEVE encerrar o comando com '\\n'.\n");
+        return -EINVAL; // Retorna Erro de Argumento Inválido
+    }
+    // Se a validação passou, removemos o '\n' para não enviá-lo para o ESP32
+    data_len--; // Desconsidera o '\n'
+
+    // Garantia de que a string cabe numa linha do firmware. Com UPLOAD, um
+    // padrão maior vai em partes e o limite é o tamanho da escrita.
+    if (data_len >= MAX_RECV_LINE - 4 && !ir_caps.upload) { // -4 para "TX " e '\0'
+        printk(KERN_ERR "IR_REMOTE: Comando IR muito longo. Max: %d\n", MAX_RECV_LINE - 4);
+        return -EINVAL;
+    }
+
+    // 1. Copia o conteúdo da HAL (buff) para o comando
+    command = kmemdup_nul(buff, data_len, GFP_KERNEL);
+    if (!command)
+        return -ENOMEM;
+    ret = ir_store_transmit(command, count);
+    kfree(command);
+    return ret;
+}
+
+// Executado quando o arquivo /sys/kernel/infrared/transmit é escrito
+static ssize_t attr_store_transmit(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count) {
+    return ir_transmit_line(buff, count);
+}
+
+// /dev/ir_transmit: cada write() é um comando inteiro, de até IR_TX_DEV_MAX
+// bytes. A HAL usa quando o comando não cabe na página do sysfs.
+static ssize_t tx_dev_write(struct file *file, const char __user *buf, size_t len, loff_t *off) {
+    char *buff;
+    ssize_t ret;
+
+    if (len > IR_TX_DEV_MAX)
+        return -E2BIG;
+    buff = vmemdup_user(buf, len);
+    if (IS_ERR(buff))
+        return PTR_ERR(buff);
+    ret = ir_transmit_line(buff, len);
+    kvfree(buff);
+    return ret;
+}
+
+static const struct file_operations tx_fops = {
+    .owner  = THIS_MODULE,
+    .write  = tx_dev_write,
+    .llseek = noop_llseek,
+};
+
+static struct miscdevice tx_miscdev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name  = "ir_transmit",
+    .fops  = &tx_fops,
+    .mode  = 0660,
+};
+
 // --- RECEIVE (Show) ---
 static ssize_t attr_show_receive(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff) {
     // Retorna o último comando recebido
@@ -455,7 +1978,8 @@ static ssize_t attr_show_receive(struct kobject *sys_obj, struct kobj_attribute
 
 // Executado quando o arquivo /sys/kernel/infrared/receive é escrito (TRIGGER PARA ATUALIZAR LEITURA)
 static ssize_t attr_store_receive(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count) {
-    int ret;
+    int ret, replays = 0;
+    unsigned int gen;
     // 1. TRATAMENTO DO BUFFER E VALIDAÇÃO DE PROTOCOLO ('\n')
     char command[MAX_RECV_LINE];
     size_t data_len = count; // data_len inicial é o tamanho total
@@ -478,7 +2002,7 @@ static ssize_t attr_store_receive(struct kobject *sys_obj, struct kobj_attribute
     // 1. Copia o conteúdo da HAL (buff) para a variável local (command)
     strncpy(command, buff, data_len);
     command[data_len] = '\0';
-    printk(KERN_INFO "IR_REMOTE: Recebido da HAL (Receive Trigger): '%s'", command);
+    pr_debug("IR_REMOTE: Recebido da HAL (Receive Trigger): '%s'\n", command);
 
     if (strncmp(command, "LAST_RECV", 9) != 0) {
         printk(KERN_ERR "IR_REMOTE: Comando inválido para receive. Esperado: 'LAST_RECV'. Recebido: '%s'\n", command);
@@ -486,10 +2010,16 @@ static ssize_t attr_store_receive(struct kobject *sys_obj, struct kobj_attribute
     }
 
     // 2. Busca o último sinal recebido pelo Firmware
-  
-    mutex_lock(&ir_lock); 
-    ret = usb_request_last_recv();
-    mutex_unlock(&ir_lock); 
+    do {
+        mutex_lock(&ir_lock);
+        if (cap_active) {
+            mutex_unlock(&ir_lock);
+            return -EBUSY;
+        }
+        gen = ir_attach_gen;
+        ret = usb_request_last_recv();
+        mutex_unlock(&ir_lock);
+    } while (ir_retry_after_reconnect(ret, gen, &replays));
 
     // 3. RETORNO:
     if (ret == 0) { // Se o retorno for sucesso (0)
@@ -501,3 +2031,177 @@ static ssize_t attr_store_receive(struct kobject *sys_obj, struct kobj_attribute
     }
 
 }
+
+// --- MACRO (Show) ---
+// Estado da execução no firmware, sem o "[OK] MACRO STATUS ":
+// "run=<nome|-> step=i/n last=<nome|-> result=<done|cancel|error|-> us=<µs> late=<µs>"
+static ssize_t attr_show_macro(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff) {
+    static const char prefix[] = "[OK] MACRO STATUS";
+    char reply[MAX_RECV_LINE];
+    unsigned int gen;
+    int ret, replays = 0;
+
+    do {
+        mutex_lock(&ir_lock);
+        gen = ir_attach_gen;
+        if (cap_active)
+            ret = -EBUSY;
+        else
+            ret = usb_cmd_wait_reply("MACRO STATUS\n", prefix, reply, sizeof(reply));
+        mutex_unlock(&ir_lock);
+    } while (ir_retry_after_reconnect(ret, gen, &replays));
+
+    if (ret <= 0)
+        return ret ? ret : -ETIMEDOUT;
+    return sprintf(buff, "%s\n", skip_spaces(reply + sizeof(prefix) - 1));
+}
+
+// Executado quando /sys/kernel/infrared/macro é escrito:
+// NEW <nome> | ADD <nome> <passo> | RUN <nome> | CANCEL | DEL <nome>
+// O driver só confere o verbo; nome e passo são validados pelo firmware.
+static ssize_t attr_store_macro(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count) {
+    static const char * const verbs[] = { "NEW", "ADD", "RUN", "CANCEL", "DEL" };
+    char line[MAX_RECV_LINE], prefix[24];
+    const char *verb = NULL;
+    unsigned int gen;
+    size_t len;
+    int i, ret, replays = 0;
+
+    if (count == 0 || buff[count - 1] != '\n') {
+        printk(KERN_ERR "IR_REMOTE: Erro de protocolo (Macro)! A HAL DEVE encerrar o comando com '\\n'.\n");
+        return -EINVAL;
+    }
+    // "MACRO " + linha (já com o '\n') precisa caber no buffer de saída
+    if (count + 6 >= MAX_RECV_LINE)
+        return -EINVAL;
+
+    for (i = 0; i < ARRAY_SIZE(verbs); i++) {
+        len = strlen(verbs[i]);
+        if (!strncmp(buff, verbs[i], len) && (buff[len] == ' ' || buff[len] == '\n')) {
+            verb = verbs[i];
+            break;
+        }
+    }
+    if (!verb) {
+        printk(KERN_ERR "IR_REMOTE: Comando inválido para macro: '%.*s'\n", (int)count - 1, buff);
+        return -EINVAL;
+    }
+
+    snprintf(line, sizeof(line), "MACRO %.*s", (int)count, buff);
+    snprintf(prefix, sizeof(prefix), "[OK] MACRO %s", verb);
+
+    do {
+        mutex_lock(&ir_lock);
+        gen = ir_attach_gen;
+        if (cap_active)
+            ret = -EBUSY;
+        else
+            ret = usb_cmd_wait_reply(line, prefix, NULL, 0);
+        mutex_unlock(&ir_lock);
+    } while (ir_retry_after_reconnect(ret, gen, &replays));
+
+    if (ret > 0)
+        return count;
+    printk(KERN_ALERT "IR_REMOTE: Falha no comando MACRO %s. Retorno: %d\n", verb, ret);
+    return ret ? -EIO : -ETIMEDOUT;
+}
+
+// --- CHANNELS (Show) ---
+static ssize_t attr_show_channels(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff) {
+    return sprintf(buff, "%u\n", ir_caps.channels);
+}
+
+// --- CAPS (Show) ---
+// Mesmo formato "chave=valor" do firmware: a HAL lê uma vez e cacheia
+// Com UPLOAD, slices e line são os do transmit (padrão em partes); os do
+// firmware ficam em ir_caps para o envio. Sem /dev/ir_transmit, o comando
+// é limitado à página do sysfs, e slices é o que cabe nela.
+static ssize_t attr_show_caps(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff) {
+    unsigned int slices = ir_caps.slices;
+    // Sem UPLOAD o limite é o do envio numa linha (MAX_RECV_LINE), não o do firmware
+    unsigned int line = ir_line_room();
+
+    if (ir_caps.upload) {
+        line = ir_txdev_ready ? IR_TX_DEV_MAX : PAGE_SIZE;
+        // Pior caso: 5 dígitos e a vírgula por fatia, mais o cabeçalho
+        slices = max(ir_caps.slices, min(ir_caps.upload, (line - 64) / 6));
+    }
+
+    return sprintf(buff, "fmin=%u fmax=%u slices=%u maxus=%u ch=%u proto=%s line=%u rec=%u macros=%u steps=%u"
+                   " upload=%u\n",
+                   ir_caps.fmin, ir_caps.fmax, slices, ir_caps.maxus,
+                   ir_caps.channels, ir_caps.proto, line, ir_caps.rec,
+                   ir_caps.macros, ir_caps.steps, ir_caps.upload);
+}
+
+// --- CLOCK (Show) ---
+// Última sincronização com o relógio do firmware (offset = firmware - host)
+static ssize_t attr_show_clock(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff) {
+    struct ir_clock c;
+    s64 now = ktime_to_ns(ktime_get());
+
+    mutex_lock(&ir_lock);
+    c = ir_clock;
+    mutex_unlock(&ir_lock);
+
+    if (!c.valid)
+        return sprintf(buff, "valid=0 drift_ppb=%lld\n", c.drift_valid ? c.drift_ppb : 0);
+    return sprintf(buff, "valid=1 offset_us=%lld drift_ppb=%lld delay_us=%lld age_ms=%lld\n",
+                   c.dev_us - div_s64(c.host_ns, NSEC_PER_USEC), c.drift_valid ? c.drift_ppb : 0,
+                   c.delay_us, div_s64(now - c.host_ns, NSEC_PER_MSEC));
+}
+
+// Executado quando /sys/kernel/infrared/clock é escrito: "SYNC" sincroniza agora
+static ssize_t attr_store_clock(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count) {
+    unsigned int gen;
+    int ret, replays = 0;
+
+    if (count != 5 || strncmp(buff, "SYNC\n", 5))
+        return -EINVAL;
+    if (!strstr(ir_caps.proto, "SYNC"))
+        return -EOPNOTSUPP;
+
+    do {
+        mutex_lock(&ir_lock);
+        gen = ir_attach_gen;
+        ret = cap_active ? -EBUSY : ir_clock_sync();
+        mutex_unlock(&ir_lock);
+    } while (ir_retry_after_reconnect(ret, gen, &replays));
+
+    return ret ? ret : count;
+}
+
+// --- CAPTURE (Show) ---
+static ssize_t attr_show_capture(struct kobject *sys_obj, struct kobj_attribute *attr, char *buff) {
+    return sprintf(buff, "%s amostras=%lu descartadas=%lu\n",
+                   cap_active ? "ativa" : "inativa", cap_samples, cap_dropped);
+}
+
+// Executado quando /sys/kernel/infrared/capture é escrito: START ou STOP
+static ssize_t attr_store_capture(struct kobject *sys_obj, struct kobj_attribute *attr, const char *buff, size_t count) {
+    unsigned int gen;
+    int ret, replays = 0;
+
+    if (count == 0 || buff[count - 1] != '\n') {
+        printk(KERN_ERR "IR_REMOTE: Erro de protocolo (Capture)! A HAL DEVE encerrar o comando com '\\n'.\n");
+        return -EINVAL;
+    }
+
+    do {
+        mutex_lock(&ir_lock);
+        gen = ir_attach_gen;
+        if (count == 6 && !strncmp(buff, "START", 5))
+            ret = cap_start_session();
+        else if (count == 5 && !strncmp(buff, "STOP", 4))
+            ret = cap_stop_session();
+        else
+            ret = -EINVAL;
+        mutex_unlock(&ir_lock);
+    } while (ir_retry_after_reconnect(ret, gen, &replays));
+
+    if (ret) {
+        printk(KERN_ALERT "IR_REMOTE: Falha no controle da captura. Retorno: %d\n", ret);
+        return ret;
+    }
+    return count;
+}
@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+// Tracepoints do driver ir_remote (/sys/kernel/tracing/events/ir_remote/).
+// Marcam cada etapa de um comando: envio, fim do bulk OUT, primeiro byte
+// da resposta, resposta reconhecida, timeout e erro. O id é o de correlação
+// gerado pelo ConsumerIrManager (0 = comando sem id).
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ir_remote
+
+#if !defined(_IR_REMOTE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _IR_REMOTE_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(ir_remote_submit,
+    TP_PROTO(u64 id, const char *cmd, size_t len),
+    TP_ARGS(id, cmd, len),
+    TP_STRUCT__entry(
+        __field(u64, id)
+        __string(cmd, cmd)
+        __field(size_t, len)
+    ),
+    TP_fast_assign(
+        __entry->id = id;
+        __assign_str(cmd, cmd);
+        __entry->len = len;
+    ),
+    TP_printk("id=%llx len=%zu cmd=%s", __entry->id, __entry->len, __get_str(cmd))
+);
+
+TRACE_EVENT(ir_remote_bulk_out_done,
+    TP_PROTO(int ret, int actual, s64 us),
+    TP_ARGS(ret, actual, us),
+    TP_STRUCT__entry(
+        __field(int, ret)
+        __field(int, actual)
+        __field(s64, us)
+    ),
+    TP_fast_assign(
+        __entry->ret = ret;
+        __entry->actual = actual;
+        __entry->us = us;
+    ),
+    TP_printk("ret=%d bytes=%d us=%lld", __entry->ret, __entry->actual, __entry->us)
+);
+
+TRACE_EVENT(ir_remote_first_byte,
+    TP_PROTO(int actual, int retries, s64 us),
+    TP_ARGS(actual, retries, us),
+    TP_STRUCT__entry(
+        __field(int, actual)
+        __field(int, retries)
+        __field(s64, us)
+    ),
+    TP_fast_assign(
+        __entry->actual = actual;
+        __entry->retries = retries;
+        __entry->us = us;
+    ),
+    TP_printk("bytes=%d retries=%d us=%lld", __entry->actual, __entry->retries, __entry->us)
+);
+
+TRACE_EVENT(ir_remote_ack,
+    TP_PROTO(u64 id, const char *reply, bool ok, s64 us),
+    TP_ARGS(id, reply, ok, us),
+    TP_STRUCT__entry(
+        __field(u64, id)
+        __string(reply, reply)
+        __field(bool, ok)
+        __field(s64, us)
+    ),
+    TP_fast_assign(
+        __entry->id = id;
+        __assign_str(reply, reply);
+        __entry->ok = ok;
+        __entry->us = us;
+    ),
+    TP_printk("id=%llx ok=%d us=%lld reply=%s", __entry->id, __entry->ok, __entry->us,
+              __get_str(reply))
+);
+
+// Carimbos do relógio do firmware (µs desde o boot do ESP32) devolvidos no [OK]
+TRACE_EVENT(ir_remote_device_ts,
+    TP_PROTO(u64 id, u64 rx_us, u64 done_us),
+    TP_ARGS(id, rx_us, done_us),
+    TP_STRUCT__entry(
+        __field(u64, id)
+        __field(u64, rx_us)
+        __field(u64, done_us)
+    ),
+    TP_fast_assign(
+        __entry->id = id;
+        __entry->rx_us = rx_us;
+        __entry->done_us = done_us;
+    ),
+    TP_printk("id=%llx rx=%llu done=%llu exec_us=%llu", __entry->id, __entry->rx_us,
+              __entry->done_us, __entry->done_us - __entry->rx_us)
+);
+
+// Nova referência do relógio do firmware (SYNC): offset = firmware - host
+TRACE_EVENT(ir_remote_clock_sync,
+    TP_PROTO(s64 offset_us, s64 delay_us, s64 drift_ppb),
+    TP_ARGS(offset_us, delay_us, drift_ppb),
+    TP_STRUCT__entry(
+        __field(s64, offset_us)
+        __field(s64, delay_us)
+        __field(s64, drift_ppb)
+    ),
+    TP_fast_assign(
+        __entry->offset_us = offset_us;
+        __entry->delay_us = delay_us;
+        __entry->drift_ppb = drift_ppb;
+    ),
+    TP_printk("offset_us=%lld delay_us=%lld drift_ppb=%lld", __entry->offset_us,
+              __entry->delay_us, __entry->drift_ppb)
+);
+
+TRACE_EVENT(ir_remote_timeout,
+    TP_PROTO(u64 id, const char *cmd, int retries, s64 us),
+    TP_ARGS(id, cmd, retries, us),
+    TP_STRUCT__entry(
+        __field(u64, id)
+        __string(cmd, cmd)
+        __field(int, retries)
+        __field(s64, us)
+    ),
+    TP_fast_assign(
+        __entry->id = id;
+        __assign_str(cmd, cmd);
+        __entry->retries = retries;
+        __entry->us = us;
+    ),
+    TP_printk("id=%llx retries=%d us=%lld cmd=%s", __entry->id, __entry->retries, __entry->us,
+              __get_str(cmd))
+);
+
+TRACE_EVENT(ir_remote_error,
+    TP_PROTO(const char *stage, int ret),
+    TP_ARGS(stage, ret),
+    TP_STRUCT__entry(
+        __string(stage, stage)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __assign_str(stage, stage);
+        __entry->ret = ret;
+    ),
+    TP_printk("stage=%s ret=%d", __get_str(stage), __entry->ret)
+);
+
+#endif /* _IR_REMOTE_TRACE_H */
+
+// Esta parte fica fora da proteção de inclusão múltipla
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ir_remote_trace
+#include <trace/define_trace.h>